@@ -27,15 +27,22 @@
 
 #define SYNC_DEBUG 0
 
+#ifndef SIM
 extern "C" {
 	#include <com32.h>
 }
+#else
+#include <arpa/inet.h>
+#endif
 
 #include "version.h"
 #include "bootloader.h"
 #include "library/base.h"
 #include "library/access.h"
 #include "library/utils.h"
+#include "library/trace.h"
+#include "library/profile.h"
+#include "library/sched.h"
 #include "platform/acpi.h"
 #include "platform/options.h"
 #include "platform/os.h"
@@ -47,6 +54,12 @@ extern "C" {
 #include "platform/trampoline.h"
 #include "platform/devices.h"
 #include "platform/pcialloc.h"
+#include "platform/bench.h"
+#include "platform/stress.h"
+#include "platform/dramplan.h"
+#include "platform/hmat.h"
+#include "platform/slit.h"
+#include "platform/pptt.h"
 #include "opteron/msrs.h"
 #include "numachip2/numachip.h"
 #include "numachip2/router.h"
@@ -61,6 +74,8 @@ ACPI *acpi;
 IPMI *ipmi;
 Router *router;
 char *asm_relocated;
+static struct profile_cluster *profile; // on the master
+static bool cores_setup; // application cores have their global APIC IDs
 
 uint64_t dram_top;
 unsigned nnodes;
@@ -77,35 +92,65 @@ bool check(void)
 
 static void scan(void)
 {
-	dram_top = 0;
-
-	// setup local DRAM windows
-	foreach_node(node) {
-		// trim nodes that are over sized and not according to granularity
-		(*node)->trim_dram_maps();
+	struct dram_plan plan;
+	plan.map_granule = 1ULL << 27;
+	plan.align = 2ULL << 30; // avoid holes with less alignment for the kernel
+	plan.att_granule = 1ULL << Numachip2::SIU_ATT_SHIFT;
+	plan.hole_base = Opteron::HT_BASE;
+	plan.hole_limit = Opteron::HT_LIMIT;
 
-		// if node DRAM range overlaps HT decode range, move up
-		if ((dram_top < Opteron::HT_LIMIT) && ((dram_top + (*node)->dram_size) > Opteron::HT_BASE)) {
-			dram_top = Opteron::HT_LIMIT;
+	struct dram_plan_server *servers = (struct dram_plan_server *)zalloc(nnodes * sizeof(*servers));
 
-			// move previous node's DRAM end to the HT decode range end, so cycles above the DRAM size are aborted, rather than hanging
-			(*(node-1))->dram_end = Opteron::HT_LIMIT - 1;
+	foreach_node(node) {
+		struct dram_plan_server *server = &servers[node - nodes];
+		server->nbs = (*node)->nopterons;
+		server->limit = options->memlimit;
+
+		for (unsigned i = 0; i < server->nbs; i++) {
+			const Opteron *nb = (*node)->opterons[i];
+			server->detected[i] = nb->dram_size;
+			// slaves' holes are disabled, so only the master's hoists
+			server->hole += dram_hoisted(nb->read32(Opteron::DRAM_HOLE), nb->dram_base, nb->dram_base + nb->dram_size - 1);
 		}
+	}
 
-		(*node)->dram_base = dram_top;
+	plan_dram(&plan, servers, nnodes);
+	dram_top = plan.top;
 
-		for (Opteron *const *nb = &(*node)->opterons[0]; nb < &(*node)->opterons[(*node)->nopterons]; nb++) {
-			(*nb)->dram_base = dram_top;
-			dram_top += (*nb)->dram_size;
+	// setup local DRAM windows
+	foreach_node(node) {
+		const struct dram_plan_server *server = &servers[node - nodes];
+
+		for (unsigned i = 0; i < server->nbs; i++) {
+			(*node)->opterons[i]->dram_base = server->nb_base[i];
+			(*node)->opterons[i]->dram_size = server->nb_size[i];
 		}
 
-		dram_top = roundup(dram_top, 1ULL << Numachip2::SIU_ATT_SHIFT);
-		(*node)->dram_end = dram_top - 1;
+		(*node)->dram_base = server->base;
+		(*node)->dram_size = server->size;
+		// cycles above the DRAM size up to the next server are aborted, rather than hanging
+		(*node)->dram_end = server->end;
 
-		if (options->debug.maps)
-			printf("%s dram_base=0x%" PRIx64 " dram_size=0x%" PRIx64 " dram_end=0x%" PRIx64 "\n",
-				pr_node((*node)->config->id), (*node)->dram_base, (*node)->dram_size, (*node)->dram_end);
+		debugf(maps, "%s dram_base=0x%" PRIx64 " dram_size=0x%" PRIx64 " dram_end=0x%" PRIx64 " lost %" PRIu64 "MB map, %" PRIu64 "MB align, %" PRIu64 "MB limit\n",
+			pr_node((*node)->config->id), (*node)->dram_base, (*node)->dram_size, (*node)->dram_end,
+			server->lost_map >> 20, server->lost_align >> 20, server->lost_limit >> 20);
 	}
+
+	free(servers);
+
+	if (plan.lost_map || plan.lost_align || plan.lost_limit)
+		printf("DRAM layout has %" PRIu64 "GB usable, losing %" PRIu64 "MB to map granularity, %" PRIu64 "MB to alignment and %" PRIu64 "MB to limits\n",
+		  plan.usable >> 30, plan.lost_map >> 20, plan.lost_align >> 20, plan.lost_limit >> 20);
+}
+
+// on any core
+static int dram_att_work(void *arg)
+{
+	Node *node = (Node *)arg;
+
+	foreach_node(dnode)
+		node->numachip->dramatt.fill((*dnode)->dram_base, (*dnode)->dram_end, (*dnode)->config->id);
+	return 0;
 }
 
 static void add(const Node &node)
@@ -210,8 +255,7 @@ static void setup_gsm(void)
 			// We must probe first to find NumaChip HT node (it might be different from others)
 			ht_t ht = Numachip2::probe(config->nodes[n].id);
 			if (ht) {
-				if (options->debug.maps)
-					printf("\n%s: DRAM ATT 0x%012" PRIx64 ":0x%012" PRIx64 " to %s", pr_node(config->nodes[n].id), base, limit, pr_node((*node)->config->id));
+				debugf(maps, "\n%s: DRAM ATT 0x%012" PRIx64 ":0x%012" PRIx64 " to %s", pr_node(config->nodes[n].id), base, limit, pr_node((*node)->config->id));
 
 				// FIXME: use observer instance
 				xassert(limit > base);
@@ -292,6 +336,8 @@ static void setup_info(void)
 		infop->neigh_ht = nodes[n]->neigh_ht;
 		infop->neigh_link = nodes[n]->neigh_link;
 		infop->linkmask = nodes[n]->numachip->linkmask;
+		infop->bench = options->bench > 0;
+		infop->profile = (uintptr_t)profile >> 16;
 		strncpy(infop->firmware, VER, sizeof(infop->firmware));
 #ifdef DEBUG
 		printf("Firmware %s, self %03x, partition %u, master %03x, "
@@ -341,10 +387,13 @@ static void remap(void)
 		for (Opteron *const *nb = &local_node->opterons[0]; nb < &local_node->opterons[local_node->nopterons]; nb++)
 			(*nb)->drammap.set(range, nodes[1]->opterons[0]->dram_base, dram_top - 1, local_node->numachip->ht);
 
-	// 5. setup DRAM ATT routing
+	// 5. setup DRAM ATT routing, each server's table in parallel
+	lib::work_pool *pool = lib::work_new();
 	foreach_node(node)
-		foreach_node(dnode)
-			(*node)->numachip->dramatt.range((*dnode)->dram_base, (*dnode)->dram_end, (*dnode)->config->id);
+		lib::work_add(pool, (*node)->config->id, "DRAM ATT", dram_att_work, *node);
+	if (work_run(pool))
+		fatal("DRAM ATT programming failed");
+	lib::work_free(pool);
 
 	// 6. set top of memory
 	lib::wrmsr(MSR_TOPMEM2, dram_top);
@@ -357,32 +406,34 @@ static void remap(void)
 		add(**node);
 
 	// trim e820 map to first node, as DRAM top may have been trimmed
-	struct e820entry *top = e820->position(nodes[0]->dram_end);
-	top->length = nodes[0]->dram_end + 1 - top->base;
+	const uint64_t end = nodes[0]->dram_base + nodes[0]->dram_size;
+	struct e820entry *top = e820->position(end - 1);
+	top->length = end - top->base;
 
 	// 8. update e820 map
 	foreach_node(node) {
 		for (Opteron *const *nb = &(*node)->opterons[0]; nb < &(*node)->opterons[(*node)->nopterons]; nb++) {
 			// master always first in array
 			if (node != &nodes[0])
-				e820->add((*nb)->dram_base, (*nb)->dram_size, E820::RAM);
+				e820->queue((*nb)->dram_base, (*nb)->dram_size, E820::RAM);
 
 			if (options->tracing/* && node == &nodes[0] && nb == &(*node)->opterons[0]*/) {
 				(*nb)->trace_base = (*nb)->dram_base + (*nb)->dram_size - options->tracing;
 				(*nb)->trace_limit = (*nb)->trace_base + options->tracing - 1;
 
-				e820->add((*nb)->trace_base, (*nb)->trace_limit - (*nb)->trace_base + 1, E820::RESERVED);
+				e820->queue((*nb)->trace_base, (*nb)->trace_limit - (*nb)->trace_base + 1, E820::RESERVED);
 			}
 		}
 	}
 
 	// workaround BIOS bug which can corrupt higher area of memory due to incomplete SMM address mask
-	e820->add(0x1003ff00000, 1 << 20, E820::RESERVED);
-	e820->add(0x2003ff00000, 1 << 20, E820::RESERVED);
+	e820->queue(0x1003ff00000, 1 << 20, E820::RESERVED);
+	e820->queue(0x2003ff00000, 1 << 20, E820::RESERVED);
 
 	// FIXME: reserve 8MB at top of DRAM to prevent igb tx queue hangs
 	uint64_t len = 8ULL << 20;
-	e820->add(dram_top - len, len, E820::RESERVED);
+	e820->queue(dram_top - len, len, E820::RESERVED);
+	e820->commit();
 }
 
 static void enable_coherency(void)
@@ -466,6 +517,87 @@ static void boot_core(const uint32_t apicid, const uint32_t vector)
 	local_node->numachip->apic_icr_write(APIC_DM_STARTUP | (start_eip >> 12), apicid);
 }
 
+// run queued items on application cores and the BSP; before core setup, only the local server's cores are reachable
+// application cores to start on a server; with strict affinity, no more than its items
+static unsigned work_cores(const struct lib::work_pool *pool, Node *const *node, const unsigned budget)
+{
+	const unsigned cores = (*node)->napics - (node == &nodes[0]); // excluding BSC
+	return min(min(cores, budget), pool->strict ? lib::work_queued(pool, (*node)->config->id) : ~0U);
+}
+
+// run queued items on application cores and the BSP; before core setup, only the local server's cores are reachable
+unsigned work_run(struct lib::work_pool *pool)
+{
+	xassert(!lib::task_running()); // cores can't switch the BSP's tasks
+	xassert(cores_setup || !pool->strict);
+
+	// access debugging and tracing are left to the BSP
+	unsigned ncores = 0, budget = 0;
+	if (!options->debug.access && !lib::trace)
+		budget = min((unsigned)options->workers, pool->items);
+
+	if (cores_setup) {
+		foreach_node(node)
+			ncores += work_cores(pool, node, budget - ncores);
+	} else
+		ncores = min(acpi->napics - 1, budget);
+
+	uint8_t *stacks = NULL;
+	if (ncores) {
+		stacks = (uint8_t *)zalloc(ncores * WORK_STACK);
+		*REL32(work_gdt_base) = (uint32_t)(uintptr_t)REL32(work_gdt);
+		*REL32(work_jump) = (uint32_t)(uintptr_t)REL32(work32);
+		*REL32(work_fn) = (uint32_t)(uintptr_t)lib::work_entry;
+		*REL32(work_arg) = (uint32_t)(uintptr_t)pool;
+		*REL32(work_stacks) = (uint32_t)(uintptr_t)stacks;
+		*REL32(work_slot) = 0;
+		*REL32(work_msrs) = !cores_setup;
+		trampoline_sem_init(ncores);
+
+		if (cores_setup) {
+			unsigned started = 0;
+			foreach_node(node) {
+				const unsigned first = node == &nodes[0], count = work_cores(pool, node, ncores - started);
+				for (unsigned n = first; n < first + count; n++)
+					boot_core((*node)->apics[n], VECTOR_WORK);
+				started += count;
+			}
+		} else {
+			for (unsigned n = 1; n <= ncores; n++)
+				boot_core_host(acpi->apics[n], VECTOR_WORK);
+		}
+	}
+
+	lib::work_loop(pool, local_node->config->id);
+
+	// fail if cores stop making progress
+	uint32_t done = pool->done;
+	uint64_t limit = lib::rdtscll() + (uint64_t)1e6 * Opteron::tsc_mhz;
+	while (trampoline_sem_getvalue()) {
+		if (pool->done != done) {
+			done = pool->done;
+			limit = lib::rdtscll() + (uint64_t)1e6 * Opteron::tsc_mhz;
+		}
+
+		if (lib::rdtscll() > limit)
+			fatal("%u cores did not finish work items", trampoline_sem_getvalue());
+		cpu_relax();
+	}
+
+	free(stacks);
+	debugf(cores, "%u work items on %u cores and the BSP\n", pool->items, ncores);
+
+	// strict items on servers given no cores
+	if (pool->done != pool->items) {
+		error("%u work items had no cores on their server", pool->items - pool->done);
+		return pool->errors + pool->items - pool->done;
+	}
+
+	if (pool->errors)
+		error("%u work items failed, first %s with %d", pool->errors, pool->failed->name, pool->error);
+	return pool->errors;
+}
+
 static void caches_global(const bool enable)
 {
 	if (enable)
@@ -584,6 +716,7 @@ static void setup_cores(void)
 	}
 	printf("\n");
 	lib::critical_leave();
+	cores_setup = 1;
 }
 
 static void test_prepare(void)
@@ -691,9 +824,135 @@ static void test_cores(void)
 	printf("\n");
 }
 
+// proximity domains, in SRAT order: each server's northbridges
+static unsigned domains(void)
+{
+	unsigned n = 0;
+	foreach_node(node)
+		n += (*node)->nopterons;
+	return n;
+}
+
+// distance between northbridges within a server, from the BIOS SLIT if any, else local or remote
+static uint8_t bios_distance(const uint8_t *odist, const unsigned nopterons, const unsigned from, const unsigned to)
+{
+	if (odist)
+		return odist[from + to * nopterons];
+
+	return from == to ? 10 : 20;
+}
+
+// SLIT distances between domains: the BIOS SLIT within a server, else fabric hops and the BIOS distance from the egress NumaChip
+static void localities(uint8_t *dist)
+{
+	const acpi_sdt *oslit = acpi->find_sdt("SLIT");
+	const uint8_t *odist = NULL;
+	if (oslit) {
+		odist = (const uint8_t *)&(oslit->data[8]);
+		xassert(odist[0] <= 13);
+	}
+
+	foreach_node(snode) {
+		for (Opteron **snb = &(*snode)->opterons[0]; snb < &(*snode)->opterons[(*snode)->nopterons]; snb++) {
+			foreach_node(dnode) {
+				for (Opteron **dnb = &(*dnode)->opterons[0]; dnb < &(*dnode)->opterons[(*dnode)->nopterons]; dnb++) {
+					const unsigned soffset = snb - (*snode)->opterons;
+					const unsigned doffset = dnb - (*dnode)->opterons;
+
+					if (*snode == *dnode) {
+						if (*snb == *dnb)
+							*dist = 10;
+						else
+							*dist = bios_distance(odist, (*snode)->nopterons, soffset, doffset);
+					} else {
+						xassert(router->dist[snode - nodes][dnode - nodes]);
+						*dist = 70 + (router->dist[snode - nodes][dnode - nodes] + router->dist[dnode - nodes][snode - nodes]) * 10;
+
+						// add latency from egress Numachip NUMA node
+						*dist += bios_distance(odist, (*snode)->nopterons, (*snode)->neigh_ht, doffset);
+					}
+					dist++;
+				}
+			}
+		}
+	}
+}
+
+// cache geometry and sharing from the BSP, as every core is the same; returns the number of caches
+static unsigned caches_cpuid(struct pptt_cache *caches, const unsigned max, unsigned *dies_per_package, unsigned *cores_per_unit)
+{
+	uint32_t regs[4];
+	lib::cpuid(0x80000000, 0, regs);
+	const uint32_t extended = regs[0];
+	lib::cpuid(0x80000001, 0, regs);
+	unsigned n = 0;
+
+	if (extended >= 0x8000001e && (regs[2] & (1 << 22))) {
+		lib::cpuid(0x8000001e, 0, regs);
+		*cores_per_unit = ((regs[1] >> 8) & 3) + 1;
+		*dies_per_package = ((regs[2] >> 8) & 7) + 1;
+
+		// a leaf per cache until the null type
+		for (uint32_t leaf = 0; n < max; leaf++) {
+			lib::cpuid(0x8000001d, leaf, regs);
+			const unsigned type = regs[0] & 0x1f;
+			if (!type)
+				break;
+
+			struct pptt_cache *cache = &caches[n++];
+			const unsigned sharing = ((regs[0] >> 14) & 0xfff) + 1;
+			cache->level = (regs[0] >> 5) & 7;
+			cache->attributes = PPTT_READ_WRITE | PPTT_WRITE_BACK | (type == 1 ? PPTT_DATA : type == 2 ? PPTT_INSTRUCTION : PPTT_UNIFIED);
+			cache->line = (regs[1] & 0xfff) + 1;
+			cache->ways = (regs[1] >> 22) + 1;
+			cache->size = cache->ways * (((regs[1] >> 12) & 0x3ff) + 1) * cache->line * (regs[2] + 1);
+			if (regs[0] & (1 << 9))
+				cache->ways = cache->size / cache->line;
+
+			// the L1I shared by a compute unit is listed by its cores
+			cache->scope = sharing == 1 || cache->level == 1 ? PPTT_CORE : sharing <= *cores_per_unit ? PPTT_UNIT : PPTT_DIE;
+		}
+
+		return n;
+	}
+
+	// Fam10h: L1s and L2 private to each core, L3 shared by the die
+	static const uint8_t assoc[16] = {0, 1, 2, 0, 4, 0, 8, 0, 16, 0, 32, 48, 64, 96, 128, 0xff};
+	*cores_per_unit = *dies_per_package = 1;
+	lib::cpuid(0x80000005, 0, regs);
+	for (unsigned i = 2; i < 4 && n < max; i++) {
+		struct pptt_cache *cache = &caches[n++];
+		cache->scope = PPTT_CORE;
+		cache->level = 1;
+		cache->attributes = PPTT_READ_WRITE | PPTT_WRITE_BACK | (i == 2 ? PPTT_DATA : PPTT_INSTRUCTION);
+		cache->size = (regs[i] >> 24) << 10;
+		cache->line = regs[i] & 0xff;
+		cache->ways = ((regs[i] >> 16) & 0xff) == 0xff ? cache->size / cache->line : (regs[i] >> 16) & 0xff;
+	}
+
+	lib::cpuid(0x80000006, 0, regs);
+	for (unsigned i = 2; i < 4 && n < max; i++) {
+		const unsigned ways = assoc[(regs[i] >> 12) & 0xf];
+		if (!ways)
+			continue;
+
+		struct pptt_cache *cache = &caches[n++];
+		cache->scope = i == 2 ? PPTT_CORE : PPTT_DIE;
+		cache->level = i;
+		cache->attributes = PPTT_READ_WRITE | PPTT_WRITE_BACK | PPTT_UNIFIED;
+		cache->size = i == 2 ? (regs[i] >> 16) << 10 : (regs[i] >> 18) << 19;
+		cache->line = regs[i] & 0xff;
+		cache->ways = ways == 0xff ? cache->size / cache->line : ways;
+	}
+
+	return n;
+}
+
 static void acpi_tables(void)
 {
-	AcpiTable mcfg("MCFG", 1);
+	// table payloads until copied into the ACPI area
+	lib::Arena arena;
+	AcpiTable mcfg("MCFG", 1, arena);
 
 	// MCFG 'reserved field'
 	const uint64_t reserved = 0;
@@ -713,7 +972,7 @@ static void acpi_tables(void)
 
 	// cores
 	const acpi_sdt *oapic = acpi->find_sdt("APIC");
-	AcpiTable apic("APIC", 3);
+	AcpiTable apic("APIC", 3, arena);
 	apic.append((const char *)&oapic->data[0], 4); // Local Interrupt Controller Address
 	apic.append((const char *)&oapic->data[4], 4); // Flags
 
@@ -730,7 +989,7 @@ static void acpi_tables(void)
 				ent.reserved = 0;
 				ent.x2apic_id = (*node)->apics[n + m];
 				ent.flags = 1;
-				ent.acpi_uid = 0;
+				ent.acpi_uid = ent.x2apic_id; // unique, as the PPTT refers to cores by it
 				apic.append((const char *)&ent, sizeof(ent));
 			}
 
@@ -751,7 +1010,7 @@ static void acpi_tables(void)
 	}
 
 	// core to node mapping
-	AcpiTable srat("SRAT", 3);
+	AcpiTable srat("SRAT", 3, arena);
 
 	uint32_t reserved1 = 1;
 	srat.append((const char *)&reserved1, sizeof(reserved1));
@@ -759,6 +1018,7 @@ static void acpi_tables(void)
 	srat.append((const char *)&reserved2, sizeof(reserved2));
 
 	uint32_t domain = 0;
+	uint32_t *pxm = (uint32_t *)arena.alloc(nnodes * sizeof(*pxm));
 
 	struct acpi_mem_affinity ment;
 	memset(&ment, 0, sizeof(ment));
@@ -786,6 +1046,12 @@ static void acpi_tables(void)
 	foreach_node(node) {
 		unsigned n = 0;
 
+		// the server's domains follow in northbridge order
+		ht_t hts[sizeof((*node)->opterons) / sizeof((*node)->opterons[0])];
+		for (unsigned i = 0; i < (*node)->nopterons; i++)
+			hts[i] = (*node)->opterons[i]->ht;
+		pxm[node - nodes] = domain + ioh_northbridge(hts, (*node)->nopterons, (*node)->opterons[0]->ioh_ht);
+
 		for (Opteron **nb = &(*node)->opterons[0]; nb < &(*node)->opterons[(*node)->nopterons]; nb++) {
 			ment.proximity = domain;
 			ment.base =(*nb)->dram_base;
@@ -819,60 +1085,62 @@ static void acpi_tables(void)
 		}
 	}
 
-	const acpi_sdt *oslit = acpi->find_sdt("SLIT");
-	uint8_t *odist = NULL;
-	if (oslit) {
-		odist = (uint8_t *)&(oslit->data[8]);
-		xassert(odist[0] <= 13);
-	}
-
-	AcpiTable slit("SLIT", 1);
+	AcpiTable slit("SLIT", 1, arena);
+	const unsigned n = domains();
+	uint8_t *dist = (uint8_t *)arena.alloc(n * n, 1);
+	localities(dist);
 
 	// number of localities
-	const unsigned n_offset = slit.reserve(8);
+	const uint64_t localities = n;
+	slit.append((const char *)&localities, sizeof(localities));
+	slit.append((const char *)dist, n * n);
 
 	if (options->debug.acpi) {
 		printf("Topology distances:\n   ");
-		foreach_node(snode)
-			for (Opteron **snb = &(*snode)->opterons[0]; snb < &(*snode)->opterons[(*snode)->nopterons]; snb++)
-				printf(" %3u", (snode - nodes) * (*snode)->nopterons + (snb - (*snode)->opterons));
+		for (unsigned d = 0; d < n; d++)
+			printf(" %3u", d);
 		printf("\n");
-	}
 
-	foreach_node(snode) {
-		for (Opteron **snb = &(*snode)->opterons[0]; snb < &(*snode)->opterons[(*snode)->nopterons]; snb++) {
-			if (options->debug.acpi)
-				printf("%3u", (snode - nodes) * (*snode)->nopterons + (snb - (*snode)->opterons));
+		for (unsigned s = 0; s < n; s++) {
+			printf("%3u", s);
+			for (unsigned d = 0; d < n; d++)
+				printf(" %3u", dist[s * n + d]);
+			printf("\n");
+		}
+	}
 
-			foreach_node(dnode) {
-				for (Opteron **dnb = &(*dnode)->opterons[0]; dnb < &(*dnode)->opterons[(*dnode)->nopterons]; dnb++) {
-					const unsigned soffset = snb - (*snode)->opterons;
-					const unsigned doffset = dnb - (*dnode)->opterons;
-					uint8_t dist;
+	// cores, compute units, dies, packages and servers with their caches
+	unsigned ncores = 0;
+	foreach_node(node)
+		ncores += (*node)->cores;
 
-					if (*snode == *dnode) {
-						if (*snb == *dnb)
-							dist = 10;
-						else
-							dist = odist[soffset + doffset * (*snode)->nopterons];
-					} else {
-						xassert(router->dist[snode - nodes][dnode - nodes]);
-						dist = 70 + (router->dist[snode - nodes][dnode - nodes] + router->dist[dnode - nodes][snode - nodes]) * 10;
+	unsigned *dies = (unsigned *)arena.alloc(nnodes * sizeof(*dies));
+	unsigned *cores = (unsigned *)arena.alloc(n * sizeof(*cores));
+	uint32_t *uids = (uint32_t *)arena.alloc(ncores * sizeof(*uids));
+	uint64_t *ncache = (uint64_t *)arena.alloc(nnodes * sizeof(*ncache));
+	struct pptt_cache caches[8];
+	struct pptt_info topology = {nnodes, dies, cores, uids, 1, 1, 0, caches, ncache};
+	topology.ncaches = caches_cpuid(caches, sizeof(caches) / sizeof(caches[0]), &topology.dies_per_package, &topology.cores_per_unit);
 
-						// add latency from egress Numachip NUMA node
-						dist += odist[(*snode)->neigh_ht + doffset * (*snode)->nopterons];
-					}
+	unsigned die = 0, core = 0;
+	foreach_node(node) {
+		dies[node - nodes] = (*node)->nopterons;
+		ncache[node - nodes] = nnodes > 1 ? (*node)->numachip->ncache_size() : 0;
 
-					if (options->debug.acpi)
-						printf(" %3u", dist);
-					slit.append((const char *)&dist, sizeof(dist));
-				}
-			}
-			if (options->debug.acpi)
-				printf("\n");
-			slit.increment64(n_offset);
+		unsigned m = 0;
+		for (Opteron **nb = &(*node)->opterons[0]; nb < &(*node)->opterons[(*node)->nopterons]; nb++) {
+			cores[die++] = (*nb)->cores;
+			for (unsigned c = 0; c < (*nb)->cores; c++)
+				uids[core++] = (*node)->apics[m++];
 		}
 	}
+	xassert(core == ncores);
+
+	AcpiTable pptt("PPTT", 2, arena);
+	const unsigned len = pptt_payload(NULL, &topology, sizeof(struct acpi_sdt));
+	pptt_payload(&pptt.payload[pptt.reserve(len)], &topology, sizeof(struct acpi_sdt));
+	debugf(acpi, "PPTT with %u CPU caches, %u dies per package and %u cores per compute unit\n",
+	  topology.ncaches, topology.dies_per_package, topology.cores_per_unit);
 
 	// ensure BIOS-provided DSDT uses ACPI revision 2, to 64-bit intergers are accepted
 	acpi_sdt *dsdt = acpi->find_sdt("DSDT");
@@ -882,20 +1150,111 @@ static void acpi_tables(void)
 	}
 
 	uint32_t extra_len;
-	const char *extra = remote_aml(&extra_len);
-	AcpiTable ssdt("SSDT", 2);
+	char *extra = remote_aml(&extra_len, pxm);
+	AcpiTable ssdt("SSDT", 2, arena);
 	ssdt.append(extra, extra_len);
+	free(extra);
 
-	acpi->allocate((sizeof(struct acpi_sdt) + 64) * 5 + mcfg.used + apic.used + srat.used + slit.used + ssdt.used);
+	// the HMAT is added once the fabric may have been measured
+	acpi->allocate((sizeof(struct acpi_sdt) + 64) * 7 + mcfg.used + apic.used + srat.used + slit.used + pptt.used + ssdt.used + hmat_size(n));
 	acpi->replace(mcfg);
 	acpi->replace(apic);
 	acpi->replace(srat);
 	acpi->replace(slit);
+	if (acpi->find_sdt("PPTT"))
+		acpi->replace(pptt);
+	else
+		acpi->add(pptt);
 	if (options->remote_io)
 		acpi->add(ssdt);
 	acpi->check();
 }
 
+// SLIT distances between servers from probed latency, in place of the hop model; keeps the hop model on timeout
+static void acpi_slit(void)
+{
+	lib::Arena arena;
+	const unsigned n = domains();
+	uint32_t *latency = (uint32_t *)arena.alloc(nnodes * nnodes * sizeof(*latency));
+	unsigned *server = (unsigned *)arena.alloc(n * sizeof(*server));
+
+	unsigned d = 0;
+	foreach_node(node)
+		for (unsigned nb = 0; nb < (*node)->nopterons; nb++)
+			server[d++] = node - nodes;
+
+	acpi_sdt *slit = acpi->find_sdt("SLIT");
+	xassert(slit && *(const uint64_t *)slit->data == n);
+	uint8_t *dist = (uint8_t *)&slit->data[8];
+
+	printf("Probing fabric latency for the SLIT\n");
+	if (!bench_latency(latency, options->slit_timeout) || !slit_measured(dist, n, server, latency, nnodes)) {
+		warning("Latency probe incomplete; SLIT keeps hop-count distances");
+		return;
+	}
+
+	slit->checksum = 0;
+	slit->checksum = ACPI::checksum((const char *)slit, slit->len);
+
+	if (options->debug.acpi) {
+		printf("Measured distances:\n");
+		for (unsigned s = 0; s < n; s++) {
+			printf("%3u", s);
+			for (unsigned t = 0; t < n; t++)
+				printf(" %3u", dist[s * n + t]);
+			printf("\n");
+		}
+	}
+}
+
+// latency and bandwidth between every pair of domains, measured if the fabric was, and the nCaches holding remote memory
+static void acpi_hmat(void)
+{
+	lib::Arena arena;
+	const unsigned n = domains();
+	uint32_t *latency = (uint32_t *)arena.alloc(n * n * sizeof(*latency));
+	uint32_t *read = (uint32_t *)arena.alloc(n * n * sizeof(*read));
+	uint32_t *write = (uint32_t *)arena.alloc(n * n * sizeof(*write));
+	uint64_t *ncache = (uint64_t *)arena.alloc(n * sizeof(*ncache));
+	unsigned *server = (unsigned *)arena.alloc(n * sizeof(*server));
+
+	// the SLIT installed by acpi_tables(), as the BIOS SLIT it was built from is replaced
+	const acpi_sdt *slit = acpi->find_sdt("SLIT");
+	xassert(slit && *(const uint64_t *)slit->data == n);
+	const uint8_t *dist = (const uint8_t *)&slit->data[8];
+
+	// other servers cache a domain's memory in their own nCache, so the smallest of theirs is assured
+	unsigned d = 0;
+	foreach_node(node) {
+		uint64_t size = 0;
+		foreach_node(other) {
+			if (other == node)
+				continue;
+			const uint64_t theirs = (*other)->numachip->ncache_size();
+			size = size ? min(size, theirs) : theirs;
+		}
+
+		for (unsigned nb = 0; nb < (*node)->nopterons; nb++, d++) {
+			server[d] = node - nodes;
+			ncache[d] = size;
+		}
+	}
+
+	if (bench)
+		hmat_measured(latency, read, write, dist, server, n, bench);
+	else
+		hmat_model(latency, read, write, dist, n);
+
+	struct hmat_info info = {n, latency, read, write, ncache};
+	AcpiTable hmat("HMAT", 2, arena);
+	const unsigned len = hmat_payload(NULL, &info);
+	hmat_payload(&hmat.payload[hmat.reserve(len)], &info);
+	debugf(acpi, "HMAT from %s with %u domains\n", bench ? "measurements" : "hop model", n);
+
+	acpi->add(hmat);
+	acpi->check();
+}
+
 static void clear_dram(void)
 {
 	printf("Clearing DRAM");
@@ -927,8 +1286,12 @@ static void clear_dram(void)
 
 static void monitor()
 {
-	uint64_t stats[MAX_NODE];
-	uint8_t coretemp[MAX_NODE];
+	// sized for the actual node count, as MAX_NODE-sized arrays would crowd the stack
+	uint64_t *stats = (uint64_t *)zalloc(config->nnodes * sizeof(*stats));
+	uint8_t *coretemp = (uint8_t *)zalloc(config->nnodes * sizeof(*coretemp));
+	uint8_t *ncache = (uint8_t *)zalloc(config->nnodes * sizeof(*ncache));
+	uint8_t (*busy)[Numachip2::PE_UNITS] = (uint8_t (*)[Numachip2::PE_UNITS])zalloc(config->nnodes * sizeof(*busy));
+	xassert(stats && coretemp && ncache && busy);
 
 	while (1) {
 		for (unsigned i = 0; i < 12; i++) {
@@ -953,6 +1316,19 @@ static void monitor()
 			stats[n] = Numachip2::read32(config->nodes[n].id, local_node->numachip->ht, Numachip2::PIU_UTIL)
 				| ((uint64_t)Numachip2::read32(config->nodes[n].id, local_node->numachip->ht, Numachip2::PIU_UTIL+4) << 32);
 			coretemp[n] = (Numachip2::read32(config->nodes[n].id, local_node->numachip->ht, Numachip2::IMG_PROP_TEMP) & 0xff) - 128;
+			ncache[n] = 1 << ((Numachip2::read32(config->nodes[n].id, local_node->numachip->ht, Numachip2::NCACHE_CTRL) >> 3) & 3);
+
+			// protocol engine contexts in use sample outstanding transactions, for comparing nCache policies
+			for (unsigned pe = 0; pe < Numachip2::PE_UNITS; pe++) {
+				const uint32_t ctrl = Numachip2::read32(config->nodes[n].id, local_node->numachip->ht, Numachip2::PE_CTRL + pe * Numachip2::PE_OFFSET);
+				busy[n][pe] = 0;
+
+				for (unsigned c = 0; c < Numachip2::PE_CNTXTS; c++) {
+					Numachip2::write32(config->nodes[n].id, local_node->numachip->ht, Numachip2::PE_CTRL + pe * Numachip2::PE_OFFSET, (ctrl & ~(0xf << 20)) | (c << 20));
+					busy[n][pe] += ((Numachip2::read32(config->nodes[n].id, local_node->numachip->ht, Numachip2::PE_CNTXT_STATUS + pe * Numachip2::PE_OFFSET) >> 10) & 7) != 0;
+				}
+				Numachip2::write32(config->nodes[n].id, local_node->numachip->ht, Numachip2::PE_CTRL + pe * Numachip2::PE_OFFSET, ctrl);
+			}
 			printf(" %03u", config->nodes[n].id);
 		}
 
@@ -989,6 +1365,20 @@ static void monitor()
 			if (!config->partitions[config->nodes[n].partition].monitor)
 				printf(" %3llu", (stats[n] >> 40) & 0xff);
 
+		printf("\nnCache/G");
+		for (unsigned n = 0; n < config->nnodes; n++)
+			if (!config->partitions[config->nodes[n].partition].monitor)
+				printf(" %3u", ncache[n]);
+
+		printf("\nRPE ctx ");
+		for (unsigned n = 0; n < config->nnodes; n++)
+			if (!config->partitions[config->nodes[n].partition].monitor)
+				printf(" %3u", busy[n][0]);
+
+		printf("\nLPE ctx ");
+		for (unsigned n = 0; n < config->nnodes; n++)
+			if (!config->partitions[config->nodes[n].partition].monitor)
+				printf(" %3u", busy[n][1]);
 		printf("\ncoretemp");
 		for (unsigned n = 0; n < config->nnodes; n++)
 			if (!config->partitions[config->nodes[n].partition].monitor)
@@ -1027,6 +1417,15 @@ static void finished(const char *label)
 {
 	check();
 
+	lib::phase_end();
+	lib::profile_summary();
+	if (profile) {
+		struct profile_table table;
+		lib::profile_snapshot(&table, config->local_node->id);
+		lib::profile_merge(profile, config->local_node - config->nodes, &table);
+		lib::profile_timeline(profile, "sync");
+	}
+
 	if (options->boot_wait)
 		lib::wait_key("Press enter to boot");
 
@@ -1107,7 +1506,7 @@ static void wait_status(void)
 #define ENUM_DEF(state) state,
 #define ENUM_NAMES(state) #state,
 #define UDP_SIG 0xdeafcafa
-#define UDP_MAXLEN 256
+#define UDP_MAXLEN 1024
 
 enum node_state { NODE_SYNC_STATES(ENUM_DEF) };
 
@@ -1126,24 +1525,24 @@ static bool handle_command(const enum node_state cstate, enum node_state *rstate
 {
 	switch (cstate) {
 		case CMD_RESET_FABRIC:
-			lib::udelay(500000);
+			lib::task_udelay(500000);
 			local_node->numachip->fabric_reset();
 			*rstate = RSP_RESET_OK;
 			return 1;
 		case CMD_TRAIN_PHYS:
-			lib::udelay(500000);
+			lib::task_udelay(500000);
 			if (local_node->numachip->fabric_train())
 				*rstate = RSP_PHY_TRAINED;
 			else
 				*rstate = RSP_PHY_NOT_TRAINED;
 			return 1;
 		case CMD_SETUP_ROUTING:
-			lib::udelay(500000);
+			lib::task_udelay(500000);
 			local_node->numachip->fabric_routing();
 			*rstate = RSP_ROUTING_OK;
 			return 1;
 		case CMD_LOAD_FABRIC:
-			lib::udelay(500000);
+			lib::task_udelay(500000);
 			*rstate = RSP_FABRIC_READY;
 			printf("Early fabric validation");
 
@@ -1158,7 +1557,7 @@ static bool handle_command(const enum node_state cstate, enum node_state *rstate
 			printf("\n");
 			return 1;
 		case CMD_CHECK_FABRIC:
-			lib::udelay(500000);
+			lib::task_udelay(500000);
 			*rstate = local_node->check() ? RSP_FABRIC_NOT_OK : RSP_FABRIC_OK;
 			printf("Fabric %s\n", *rstate == RSP_FABRIC_OK ? "validates" : "failed validation");
 			return 1;
@@ -1202,7 +1601,7 @@ static void wait_for_slaves(void)
 		if (++count >= backoff) {
 			os->udp_write(&cmd, sizeof(cmd), 0xffffffff);
 
-			lib::udelay(100 * backoff);
+			lib::task_udelay(100 * backoff);
 			last_stat += backoff;
 
 			if (backoff < 32)
@@ -1254,6 +1653,11 @@ static void wait_for_slaves(void)
 #endif
 			for (unsigned n = 0; n < config->nnodes; n++) {
 				if (memcmp(&config->nodes[n].mac, rsp->mac, 6) == 0) {
+					// slaves append their phase table
+					const struct profile_table *table = (const struct profile_table *)(rsp + 1);
+					if (profile && len >= sizeof(*rsp) + sizeof(*table) && table->magic == PROFILE_MAGIC && table->tsc_mhz)
+						lib::profile_merge(profile, n, table);
+
 					if ((rsp->state == waitfor) && (rsp->tid == cmd.tid)) {
 						config->nodes[n].seen = 1;
 					} else if (rsp->state == RSP_PHY_NOT_TRAINED) {
@@ -1339,7 +1743,11 @@ static void wait_for_slaves(void)
 
 static void wait_for_master(void)
 {
-	struct state_bcast rsp, cmd;
+	struct {
+		struct state_bcast rsp;
+		struct profile_table profile;
+	} __attribute__ ((packed)) reply;
+	struct state_bcast &rsp = reply.rsp, cmd;
 	int count, backoff;
 	int go_ahead = 0;
 	uint32_t last_cmd = ~0;
@@ -1365,8 +1773,9 @@ static void wait_for_master(void)
 				last_state = rsp.state;
 			} else
 				printf(".");
-			os->udp_write(&rsp, sizeof(rsp), 0xffffffff);
-			lib::udelay(100 * backoff);
+			lib::profile_snapshot(&reply.profile, config->local_node->id);
+			os->udp_write(&reply, sizeof(reply), 0xffffffff);
+			lib::task_udelay(100 * backoff);
 
 			if (backoff < 32)
 				backoff = backoff * 2;
@@ -1429,9 +1838,50 @@ static void test_map(void)
 	printf("\n");
 }
 #endif
+static void dram_task(void)
+{
+	local_node->numachip->dram_init_start();
+}
+
+static void late_init_task(void)
+{
+	// initialize SPI, NODEID etc
+	local_node->numachip->late_init();
+
+	// add global MCFG maps
+	for (Opteron *const *nb = &local_node->opterons[0]; nb < &local_node->opterons[local_node->nopterons]; nb++)
+		(*nb)->mmiomap->set(8, Numachip2::MCFG_BASE, Numachip2::MCFG_LIM, local_node->numachip->ht, 0);
+
+	// reserve HT decode and MCFG address range so Linux accepts it
+	e820->queue(Opteron::HT_BASE, Opteron::HT_LIMIT - Opteron::HT_BASE, E820::RESERVED);
+	e820->queue(Numachip2::MCFG_BASE, Numachip2::MCFG_LIM - Numachip2::MCFG_BASE + 1, E820::RESERVED);
+	e820->commit();
+
+	// setup local MCFG access
+	const uint64_t mcfg = Numachip2::MCFG_BASE | ((uint64_t)config->local_node->id << 28) | 0x21;
+	lib::wrmsr(MSR_MCFG, mcfg);
+	push_msr(MSR_MCFG, mcfg);
+
+	if (options->tracing)
+		setup_gsm_early();
+}
+
+static void sync_task(void)
+{
+	if (config->nnodes > 1) {
+		// Use first node in config as "builder", to synchronize all slaves/observers
+		if (config->local_node == &config->nodes[0])
+			wait_for_slaves();
+		else
+			wait_for_master();
+	}
+}
+
 int main(const int argc, char *const argv[])
 {
 	os = new OS(); // needed first for console access
+	lib::log_start(LOG_SIZE);
+	lib::phase_begin("startup");
 
 	printf(CLEAR BANNER "NumaConnect2 system unification " VER " at 20%02d-%02d-%02d %02d:%02d:%02d" COL_DEFAULT "\n",
 	  lib::rtc_read(RTC_YEAR), lib::rtc_read(RTC_MONTH), lib::rtc_read(RTC_DAY),
@@ -1444,6 +1894,18 @@ int main(const int argc, char *const argv[])
 
 	options = new Options(argc, argv); // needed before first PCI access
 	e820 = new E820();
+	if (lib::log_ring)
+		e820->add((uintptr_t)lib::log_ring, LOG_SIZE, E820::RESERVED);
+
+	if (options->access_trace) {
+		lib::trace_start(options->access_trace);
+		if (lib::trace) {
+			e820->add((uintptr_t)lib::trace, options->access_trace, E820::RESERVED);
+			printf("Tracing config-space accesses to 0x%x\n", (uint32_t)(uintptr_t)lib::trace);
+		} else
+			warning("No memory for a %uMB access trace", (uint32_t)(options->access_trace >> 20));
+	}
+
 	Opteron::prepare();
 	acpi = new ACPI();
 	router = new Router();
@@ -1469,6 +1931,13 @@ int main(const int argc, char *const argv[])
 
 	local_node = new Node(config->local_node, (sci_t)config->master->id);
 
+	// the master collects every server's phases during synchronisation
+	if (config->local_node == &config->nodes[0]) {
+		profile = lib::profile_cluster(config->nnodes);
+		if (profile)
+			e820->add((uintptr_t)profile, PROFILE_SIZE, E820::RESERVED);
+	}
+
 	// ensure low-memory is reserved
 	e820->add(0x83000, 0x1c00, E820::RESERVED);
 
@@ -1482,32 +1951,13 @@ int main(const int argc, char *const argv[])
 		finished(config->partitions[config->local_node->partition].label);
 	}
 
-	// initialize SPI/SPD, DRAM, NODEID etc
-	local_node->numachip->late_init();
-
-	// add global MCFG maps
-	for (Opteron *const *nb = &local_node->opterons[0]; nb < &local_node->opterons[local_node->nopterons]; nb++)
-		(*nb)->mmiomap->set(8, Numachip2::MCFG_BASE, Numachip2::MCFG_LIM, local_node->numachip->ht, 0);
-
-	// reserve HT decode and MCFG address range so Linux accepts it
-	e820->add(Opteron::HT_BASE, Opteron::HT_LIMIT - Opteron::HT_BASE, E820::RESERVED);
-	e820->add(Numachip2::MCFG_BASE, Numachip2::MCFG_LIM - Numachip2::MCFG_BASE + 1, E820::RESERVED);
-
-	// setup local MCFG access
-	const uint64_t mcfg = Numachip2::MCFG_BASE | ((uint64_t)config->local_node->id << 28) | 0x21;
-	lib::wrmsr(MSR_MCFG, mcfg);
-	push_msr(MSR_MCFG, mcfg);
-
-	if (options->tracing)
-		setup_gsm_early();
+	lib::phase_end();
 
-	if (config->nnodes > 1) {
-		// Use first node in config as "builder", to synchronize all slaves/observers
-		if (config->local_node == &config->nodes[0])
-			wait_for_slaves();
-		else
-			wait_for_master();
-	}
+	// nCache DIMM testing proceeds while the fabric is trained and synchronised; zeroing continues until coherency is enabled
+	lib::task_add("dram", dram_task, 0);
+	const unsigned fabric = lib::task_add("late_init", late_init_task, 0);
+	lib::task_add("sync", sync_task, fabric);
+	lib::tasks_run(options->overlap);
 
 	if (options->test_manufacture) {
 		int i = 0;
@@ -1537,6 +1987,7 @@ int main(const int argc, char *const argv[])
 			if (options->tracing)
 				e820->add((*nb)->trace_base, (*nb)->trace_limit - (*nb)->trace_base + 1, E820::RESERVED);
 
+		local_node->numachip->dram_init_wait();
 		setup_cores_observer();
 		setup_info();
 		finished(config->partitions[config->local_node->partition].label);
@@ -1552,6 +2003,9 @@ int main(const int argc, char *const argv[])
 		// hide SMBus for remote-IO
 //		lib::pmio_write8(0xba, 64); // FIXME: check?
 
+		// the master enables coherency once this server reports in
+		local_node->numachip->dram_init_wait();
+
 		// read from master after mapped
 		printf("Waiting for %s", pr_node(config->master->id));
 		local_node->numachip->write32(Numachip2::INFO + 4, (uint32_t)local_node);
@@ -1594,6 +2048,7 @@ int main(const int argc, char *const argv[])
 
 	config->local_node->added = 1;
 
+	lib::phase_begin("slaves");
 	printf("Servers ready:\n");
 
 	unsigned pos = 1;
@@ -1615,10 +2070,17 @@ int main(const int argc, char *const argv[])
 		nodes[pos++] = new Node(&config->nodes[n], ht);
 		config->nodes[n].added = 1;
 	}
+	lib::phase_end();
 
+	lib::phase_begin("scan");
 	scan();
+	lib::phase_end();
+	lib::phase_begin("pci_realloc");
 	pci_realloc();
+	lib::phase_end();
+	lib::phase_begin("remap");
 	remap();
+	lib::phase_end();
 
 	if (options->debug.maps) {
 		printf("\nDRAM maps:\n");
@@ -1634,20 +2096,53 @@ int main(const int argc, char *const argv[])
 		}
 	}
 
+	lib::phase_begin("setup");
 	setup_apicids();
 	copy_inherit();
 	if (options->tracing)
 		setup_gsm();
 	setup_info();
+	lib::phase_end();
+	lib::phase_begin("acpi");
 	acpi_tables();
 	tracing_arm();
+	lib::phase_end();
+	lib::phase_begin("dram_wait");
+	local_node->numachip->dram_init_wait();
 	enable_coherency();
+	lib::phase_end();
+	lib::phase_begin("setup_cores");
 	setup_cores();
 #ifdef DEBUG
 	test_map();
 #endif
-	if (!options->fastboot)
+	lib::phase_end();
+	if (!options->fastboot) {
+		lib::phase_begin("test_cores");
 		test_cores();
+		lib::phase_end();
+	}
+	if (options->stress) {
+		lib::phase_begin("stress");
+		stress_coherency();
+		lib::phase_end();
+	}
+	if (options->bench) {
+		lib::phase_begin("bench");
+		bench_fabric();
+		lib::phase_end();
+	}
+	if (options->slit_measure)
+		acpi_slit();
+	acpi_hmat();
+	lib::phase_begin("clear_dram");
 	clear_dram();
+	lib::phase_end();
+	if (options->memtest) {
+		lib::phase_begin("memtest");
+		e820->test();
+		lib::phase_end();
+	}
+	lib::phase_begin("finished"); // ended before booting
 	finished(config->partitions[config->local_node->partition].label);
 }
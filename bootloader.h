@@ -27,6 +27,9 @@
 #include "platform/e820.h"
 #include "platform/acpi.h"
 #include "library/access.h"
+#include "library/log.h"
+#include "library/sched.h"
+#include "library/work.h"
 #include "opteron/opteron.h"
 #include "numachip2/numachip.h"
 #include "numachip2/info.h"
@@ -34,5 +37,6 @@
 
 void caches(const bool enable);
 bool check(void);
+unsigned work_run(struct lib::work_pool *pool) nonnull;
 
 extern uint64_t dram_top;
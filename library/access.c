@@ -25,6 +25,7 @@
 #include "../opteron/msrs.h"
 #include "../platform/devices.h"
 #include "access.h"
+#include "trace.h"
 
 #define PMIO_PORT 0xcd6
 
@@ -288,6 +289,48 @@ namespace lib
 			printf("\n");
 	}
 
+	void mem_window(const uint64_t base)
+	{
+		xassert(!(base & 7));
+		setup_fs(base);
+	}
+
+	uint64_t window_read64(const uint32_t off)
+	{
+		uint64_t val;
+		asm volatile("movq %%fs:(%1), %%mm0; movq %%mm0, (%0)" :: "r"(&val), "r"(off) : "memory");
+		return val;
+	}
+
+	void window_write64(const uint32_t off, const uint64_t val)
+	{
+		asm volatile("movq (%0), %%mm0; movq %%mm0, %%fs:(%1)" :: "r"(&val), "r"(off) : "memory");
+	}
+
+	uint32_t window_read32(const uint32_t off)
+	{
+		uint32_t val;
+		asm volatile("movl %%fs:(%1), %0" : "=r"(val) : "r"(off) : "memory");
+		return val;
+	}
+
+	void window_write32(const uint32_t off, const uint32_t val)
+	{
+		asm volatile("movl %0, %%fs:(%1)" :: "r"(val), "r"(off) : "memory");
+	}
+
+	void window_xor32(const uint32_t off, const uint32_t val)
+	{
+		asm volatile("lock xorl %0, %%fs:(%1)" :: "r"(val), "r"(off) : "memory");
+	}
+
+	uint32_t window_xadd32(const uint32_t off, const uint32_t val)
+	{
+		uint32_t old = val;
+		asm volatile("lock xaddl %0, %%fs:(%1)" : "+r"(old) : "r"(off) : "memory");
+		return old;
+	}
+
 	uint64_t mcfg_base(const sci_t sci)
 	{
 		uint64_t base = (rdmsr(MSR_MCFG) & ~0xfffff);
@@ -310,6 +353,7 @@ namespace lib
 		xassert(reg < 0xfff);
 
 		ret = mem_read8(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(1 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
 		if (options->debug.access & 1)
 			printf("%02x\n", ret);
 		return ret;
@@ -323,6 +367,7 @@ namespace lib
 		xassert(!(reg & 1) && reg < 0xfff);
 
 		ret = mem_read16(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(2 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
 		if (options->debug.access & 1)
 			printf("%04x\n", ret);
 		return ret;
@@ -336,6 +381,7 @@ namespace lib
 		xassert(!(reg & 3) && reg < 0xfff);
 
 		ret = mem_read32(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(4 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
 		if (options->debug.access & 1)
 			printf("%08x\n", ret);
 		return ret;
@@ -350,6 +396,8 @@ namespace lib
 		xassert(!(reg & 7) && reg < 0xfff);
 
 		ret = mem_read64(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(4 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
+		trace_access(4 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg + 4), ret >> 32);
 		if (options->debug.access & 1)
 			printf("%016" PRIx64 "\n", ret);
 		return ret;
@@ -362,6 +410,7 @@ namespace lib
 		xassert(reg < 0xfff);
 
 		mem_write8(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((1 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
 		if (options->debug.access & 1)
 			printf("\n");
 	}
@@ -373,6 +422,7 @@ namespace lib
 		xassert(!(reg & 1) && reg < 0xfff);
 
 		mem_write16(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((2 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
 		if (options->debug.access & 1)
 			printf("\n");
 	}
@@ -384,6 +434,7 @@ namespace lib
 		xassert(!(reg & 3) && reg < 0xfff);
 
 		mem_write32(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((4 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
 		if (options->debug.access & 1)
 			printf("\n");
 	}
@@ -397,6 +448,8 @@ namespace lib
 		const uint64_t addr = mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg);
 		mem_write32(addr, val);
 		mem_write32(addr + 4, val >> 32);
+		trace_access((4 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((4 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg + 4), val >> 32);
 		if (options->debug.access & 1)
 			printf("\n");
 	}
@@ -412,6 +465,7 @@ namespace lib
 		outl(PCI_EXT_CONF(bus, dev, func, reg), PCI_CONF_SEL);
 		ret = inl(PCI_CONF_DATA);
 		sti();
+		trace_access((4 << 4) | TRACE_CF8, SCI_LOCAL, PCI_MMIO_CONF(bus, dev, func, reg), ret);
 		if (options->debug.access & 1)
 			printf("%08x\n", ret);
 		return ret;
@@ -427,6 +481,7 @@ namespace lib
 		outl(PCI_EXT_CONF(bus, dev, func, reg), PCI_CONF_SEL);
 		outl(val, PCI_CONF_DATA);
 		sti();
+		trace_access((4 << 4) | TRACE_CF8 | TRACE_WRITE, SCI_LOCAL, PCI_MMIO_CONF(bus, dev, func, reg), val);
 		if (options->debug.access & 1)
 			printf("\n");
 	}
@@ -28,8 +28,13 @@ extern "C" {
 	extern int lirq_nest;
 }
 
+#ifndef SIM
 #define cli() if (atomic_exchange_and_add(&lirq_nest, 1) == 0) { asm volatile("cli"); }
 #define sti() if (atomic_decrement_and_test(&lirq_nest))       { asm volatile("sti"); }
+#else
+#define cli() atomic_exchange_and_add(&lirq_nest, 1)
+#define sti() atomic_decrement_and_test(&lirq_nest)
+#endif
 
 // RTC constants
 #define RTC_SECONDS     0
@@ -113,6 +118,7 @@ namespace lib
 		return x | (y << 4) | (z << 8);
 	}
 
+#ifndef SIM
 	static inline uint64_t rdmsr(const msr_t msr)
 	{
 		uint64_t val;
@@ -125,6 +131,19 @@ namespace lib
 		asm volatile("wrmsr" :: "c" (msr), "A" (val));
 	}
 
+	// EAX, EBX, ECX and EDX; EBX is kept, as the PIC register
+	static inline void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t *regs)
+	{
+		asm volatile("xchg %%ebx, %%esi\n"
+			     "cpuid\n"
+			     "xchg %%ebx, %%esi" : "=a" (regs[0]), "=S" (regs[1]), "=c" (regs[2]), "=d" (regs[3]) : "a" (leaf), "c" (subleaf));
+	}
+#else
+	uint64_t rdmsr(const msr_t msr);
+	void wrmsr(const msr_t msr, const uint64_t val);
+	void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t *regs);
+#endif
+
 	void native_apic_icr_write(const uint32_t low, const uint32_t apicid);
 	void critical_enter(void);
 	void critical_leave(void);
@@ -145,6 +164,14 @@ namespace lib
 	void     mem_write16(const uint64_t addr, const uint16_t val);
 	void     mem_write32(const uint64_t addr, const uint32_t val);
 	void     mem_write64(const uint64_t addr, const uint64_t val);
+	// FS window for a run of 64-bit accesses from one base, saving the MSR write per access; interrupts must be off
+	void     mem_window(const uint64_t base);
+	uint64_t window_read64(const uint32_t off);
+	void     window_write64(const uint32_t off, const uint64_t val);
+	uint32_t window_read32(const uint32_t off);
+	void     window_write32(const uint32_t off, const uint32_t val);
+	void     window_xor32(const uint32_t off, const uint32_t val);      // locked
+	uint32_t window_xadd32(const uint32_t off, const uint32_t val);     // locked, returning the previous value
 	uint8_t  mcfg_read8(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg);
 	uint16_t mcfg_read16(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg);
 	uint32_t mcfg_read32(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg);
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arena.h"
+#include "base.h"
+
+namespace lib
+{
+	// large requests get a chunk of their own
+	void Arena::refill(const size_t len)
+	{
+		const size_t size = max(len, chunk_size);
+		struct chunk *c = (struct chunk *)malloc(sizeof(*c) + size);
+		xassert(c);
+
+		c->next = head;
+		c->size = size;
+		c->used = 0;
+		head = c;
+	}
+
+	void *Arena::alloc(const size_t len, const size_t align)
+	{
+		xassert(poweroftwo(align) && align <= sizeof(void *)); // chunk data is only pointer-aligned
+		size_t pos = head ? roundup(head->used, align) : 0;
+
+		if (!head || pos + len > head->size) {
+			refill(len);
+			pos = 0;
+		}
+
+		last = head->data + pos;
+		head->used = pos + len;
+		memset(last, 0, len);
+		return last;
+	}
+
+	void *Arena::resize(void *p, const size_t len, const size_t nlen)
+	{
+		if (!p)
+			return alloc(nlen);
+
+		if (p == last && (size_t)(last - head->data) + nlen <= head->size) {
+			if (nlen > len)
+				memset(last + len, 0, nlen - len);
+			head->used = (last - head->data) + nlen;
+			return p;
+		}
+
+		void *q = alloc(nlen);
+		memcpy(q, p, min(len, nlen));
+		return q;
+	}
+
+	void Arena::release(const struct position &pos)
+	{
+		while (head != pos.head) {
+			xassert(head); // mark from another arena
+			struct chunk *next = head->next;
+			free(head);
+			head = next;
+		}
+
+		if (head)
+			head->used = pos.used;
+		last = NULL;
+	}
+
+	void Arena::release(void)
+	{
+		const struct position none = {NULL, 0};
+		release(none);
+	}
+
+	size_t Arena::used(void) const
+	{
+		size_t total = 0;
+		for (const struct chunk *c = head; c; c = c->next)
+			total += c->used;
+		return total;
+	}
+}
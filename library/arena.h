@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+namespace lib
+{
+	// bump allocator for objects sharing a lifetime, freed together by release() or the destructor
+	class Arena {
+		struct chunk {
+			struct chunk *next; // older chunk
+			size_t size, used;
+			char data[];
+		};
+
+		struct chunk *head;
+		size_t chunk_size;
+		char *last; // latest allocation, which can grow in place
+
+		void refill(const size_t len);
+	public:
+		struct position {
+			struct chunk *head;
+			size_t used;
+		};
+
+		Arena(const size_t _chunk_size = 64 << 10): head(NULL), chunk_size(_chunk_size), last(NULL) {}
+		~Arena(void)
+		{
+			release();
+		}
+
+		// zero-initialised, as from operator new
+		void *alloc(const size_t len, const size_t align = sizeof(void *));
+		// grows the latest allocation in place when it fits, else moves it
+		void *resize(void *p, const size_t len, const size_t nlen);
+		struct position mark(void) const
+		{
+			struct position pos = {head, head ? head->used : 0};
+			return pos;
+		}
+		// frees everything allocated since the mark
+		void release(const struct position &pos);
+		void release(void);
+		// bytes in use, for statistics
+		size_t used(void) const;
+	};
+}
+
+// objects on an arena aren't deleted; their destructors mustn't own memory elsewhere
+inline void *operator new(const size_t n, lib::Arena &arena)
+{
+	return arena.alloc(n);
+}
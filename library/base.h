@@ -31,8 +31,15 @@
 #define roundup(x, n) (((x) + ((n) - 1)) & (~((n) - 1)))
 #define poweroftwo(x) (!((x) & ((x) - 1)))
 #define roundup_pow2(x, y) ({uint64_t power = (y); while (power < (x)) power <<=1; power;})
+#ifndef SIM
 #define cpu_relax() asm volatile("pause" ::: "memory")
 #define halt() while (1) asm volatile("cli; hlt" ::: "memory")
+#else
+// lets a host model advance its clock while the firmware spins
+extern "C" void sim_relax(void) __attribute__((weak));
+#define cpu_relax() do { if (sim_relax) sim_relax(); } while (0)
+#define halt() exit(1)
+#endif
 
 #define PRInode "node 0x%03x (%s)"
 
@@ -48,7 +55,7 @@
 
 #define SCI_LOCAL 0xfff
 #define XBAR_PORTS 7
-#define MAX_NODE 64
+#define MAX_NODE 256
 #define MAX_PARTITIONS 16
 #define NODE_NONE ((nodeid_t)~0U)
 #define XBARID_NONE  ((xbarid_t)~0U)
@@ -103,7 +110,7 @@ typedef uint16_t sci_t;
 typedef uint16_t reg_t;
 typedef uint32_t msr_t;
 typedef uint16_t apic_t;
-typedef uint8_t nodeid_t;
+typedef uint16_t nodeid_t;
 typedef uint8_t xbarid_t;
 typedef struct {
 	nodeid_t nodeid;
@@ -125,23 +132,46 @@ inline void *zalloc(size_t size)
 }
 #endif
 
+#include "arena.h"
+
+// elements are from the heap, or from an arena when given, so a tree of objects on the arena is freed with it
 template<class T> class Vector {
 	unsigned lim, used;
+	lib::Arena *arena;
 
+	// doubling keeps pushing amortised O(1)
 	void ensure(void) {
 		xassert(used <= lim);
 		if (used == lim) {
-			lim += 8;
-			elements = (T *)realloc((void *)elements, sizeof(T) * lim);
+			const unsigned nlim = lim ? lim * 2 : 8;
+			if (arena)
+				elements = (T *)arena->resize(elements, sizeof(T) * lim, sizeof(T) * nlim);
+			else
+				elements = (T *)realloc((void *)elements, sizeof(T) * nlim);
+			xassert(elements);
+			lim = nlim;
 		}
 	}
+
+	// stable merge of runs [lo, mid) and [mid, hi) into out, greater elements first
+	void merge(T *out, const unsigned lo, const unsigned mid, const unsigned hi) const {
+		unsigned i = lo, j = mid, k = lo;
+
+		while (i < mid && j < hi)
+			out[k++] = elements[i]->less(*elements[j]) ? elements[j++] : elements[i++];
+		while (i < mid)
+			out[k++] = elements[i++];
+		while (j < hi)
+			out[k++] = elements[j++];
+	}
 public:
 	T *elements, *limit;
 
-	Vector(void): lim(0), used(0), elements(NULL), limit(NULL) {}
+	Vector(lib::Arena *_arena = NULL): lim(0), used(0), arena(_arena), elements(NULL), limit(NULL) {}
 	~Vector(void)
 	{
-		free(elements);
+		if (!arena)
+			free(elements);
 	}
 
 	unsigned size() const
@@ -149,6 +179,11 @@ public:
 		return used;
 	}
 
+	unsigned capacity() const
+	{
+		return lim;
+	}
+
 	void push_back(T elem)
 	{
 		ensure();
@@ -171,11 +206,13 @@ public:
 		limit = &elements[used];
 	}
 
+	// last element
 	T pop()
 	{
-		T elem = elements[0];
-		del(0);
-		return elem;
+		xassert(used);
+		used--;
+		limit = &elements[used];
+		return elements[used];
 	}
 
 	void insert(T elem, const unsigned pos)
@@ -192,17 +229,33 @@ public:
 		limit = &elements[used];
 	}
 
+	// greatest first, equal elements keeping their order; bottom-up merge sort
 	void sort()
 	{
-		for (unsigned i = 0; i < used; i++) {
-			for (unsigned j = 0; j < used; j++) {
-				if (elements[j]->less(*elements[i])) {
-					T temp = elements[j];
-					elements[j] = elements[i];
-					elements[i] = temp;
-				}
-			}
+		if (used < 2)
+			return;
+
+		T *const orig = elements; // may be on the arena, so kept
+		T *scratch = (T *)malloc(sizeof(T) * used);
+		xassert(scratch);
+
+		for (unsigned width = 1; width < used; width *= 2) {
+			for (unsigned lo = 0; lo < used; lo += 2 * width)
+				merge(scratch, lo, min(lo + width, used), min(lo + 2 * width, used));
+
+			// swap roles, so each pass reads the previous one's output
+			T *const t = elements;
+			elements = scratch;
+			scratch = t;
+		}
+
+		if (elements != orig) {
+			memcpy(orig, elements, sizeof(T) * used);
+			scratch = elements;
+			elements = orig;
 		}
+
+		free(scratch);
 	}
 };
 
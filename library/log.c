@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "log.h"
+#include "utils.h"
+#include "../opteron/opteron.h"
+#include "../platform/options.h"
+
+namespace lib
+{
+	struct log_header *log_ring;
+	static bool line_start = 1;
+
+	// before the E820 map exists, so the caller reserves it once it does
+	void log_start(const uint32_t size)
+	{
+		xassert(size > sizeof(struct log_header));
+
+		struct log_header *header = (struct log_header *)os_alloc(size, 0);
+		if (!header)
+			return;
+
+		memset(header, 0, sizeof(*header));
+		::memcpy(header->sig, LOG_SIG, sizeof(header->sig));
+		header->size = size;
+		log_ring = header;
+	}
+
+	static void log_put(const char *str)
+	{
+		char *text = (char *)(log_ring + 1);
+		const uint32_t len = log_ring->size - sizeof(*log_ring);
+
+		for (; *str; str++) {
+			text[log_ring->head] = *str;
+			if (++log_ring->head == len)
+				log_ring->head = 0;
+			log_ring->written++;
+		}
+	}
+
+	// serial output is synchronous at 115200 baud, so only reaches the console at or above its level
+	void log_printf(const enum log_level level, const bool console, const char *format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+
+		if (console || level <= (options ? options->console_level : LOG_INFO)) {
+			va_list copy;
+			va_copy(copy, args);
+			vprintf(format, copy);
+			va_end(copy);
+		}
+
+		if (!log_ring) {
+			va_end(args);
+			return;
+		}
+
+		char buf[256];
+		vsnprintf(buf, sizeof(buf), format, args);
+		va_end(args);
+
+		// split into lines to prefix each
+		for (char *pos = buf; *pos;) {
+			char *end = strchr(pos, '\n');
+			char saved = 0;
+			if (end) {
+				saved = end[1];
+				end[1] = '\0';
+			}
+
+			if (line_start) {
+				char prefix[24];
+				const uint64_t usecs = Opteron::tsc_mhz ? rdtscll() / Opteron::tsc_mhz : 0;
+				snprintf(prefix, sizeof(prefix), "<%u>[%5u.%06u] ", level, (unsigned)(usecs / 1000000), (unsigned)(usecs % 1000000));
+				log_put(prefix);
+			}
+
+			log_put(pos);
+			log_ring->tsc_mhz = Opteron::tsc_mhz;
+
+			if (!end) {
+				line_start = 0;
+				break;
+			}
+
+			line_start = 1;
+			end[1] = saved;
+			pos = end + 1;
+		}
+	}
+}
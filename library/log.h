@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "base.h"
+
+// text log ring on the heap, left E820-reserved for the OS, which finds it by its signature, dmesg-style
+#define LOG_SIZE (256 << 10)
+#define LOG_SIG  "NC2DMESG"
+
+enum log_level {LOG_ERR, LOG_WARN, LOG_INFO, LOG_DEBUG};
+
+// lines are prefixed "<level>[seconds] " as the kernel's printk does
+struct log_header {
+	char sig[8];
+	uint32_t size;     // bytes including header
+	uint32_t head;     // offset of the next byte in the text area
+	uint64_t written;  // bytes written, including overwritten ones
+	uint32_t tsc_mhz;
+	uint32_t reserved;
+} __attribute__((packed));
+
+#if defined(SIM) && !defined(SIM_BOOT)
+// host tools print directly
+#define debugf(flag, format, args...) printf(format, ## args)
+#else
+#include "../platform/options.h"
+
+// always kept in the ring; only printed with the subsystem's debug flag or console-level=3
+#define debugf(flag, format, args...) lib::log_printf(LOG_DEBUG, options->debug.flag, format, ## args)
+#endif
+
+namespace lib
+{
+	extern struct log_header *log_ring;
+
+	void log_start(const uint32_t size);
+	void log_printf(const enum log_level level, const bool console, const char *format, ...) __attribute__((format (printf, 3, 4)));
+}
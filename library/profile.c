@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "profile.h"
+#include "trace.h"
+#include "utils.h"
+#include "../opteron/opteron.h"
+
+namespace lib
+{
+	static struct profile_table profile;
+
+	unsigned phase_begin(const char *name)
+	{
+		trace_phase(name);
+
+		if (profile.count == PROFILE_PHASES) {
+			warning_once("Phase table full; not profiling %s", name);
+			return PROFILE_PHASES;
+		}
+
+		struct profile_phase *phase = &profile.phases[profile.count];
+		strncpy(phase->name, name, sizeof(phase->name) - 1);
+		phase->accesses = csr_accesses; // until ended
+		phase->begin = rdtscll();
+		return profile.count++;
+	}
+
+	void phase_end(const unsigned slot)
+	{
+		if (slot >= profile.count || profile.phases[slot].end)
+			return;
+
+		struct profile_phase *phase = &profile.phases[slot];
+		phase->end = rdtscll();
+		phase->accesses = csr_accesses - phase->accesses;
+	}
+
+	// ends the latest running phase
+	void phase_end(void)
+	{
+		for (int i = profile.count - 1; i >= 0; i--) {
+			if (!profile.phases[i].end) {
+				phase_end(i);
+				return;
+			}
+		}
+	}
+
+	void profile_snapshot(struct profile_table *table, const sci_t sci)
+	{
+		*table = profile;
+		table->magic = PROFILE_MAGIC;
+		table->sci = sci;
+		table->tsc_mhz = Opteron::tsc_mhz;
+		table->now = rdtscll();
+
+		for (unsigned i = 0; i < table->count; i++)
+			if (!table->phases[i].end)
+				table->phases[i].accesses = csr_accesses - table->phases[i].accesses;
+	}
+
+	static uint64_t duration(const struct profile_phase *phase, const uint64_t now)
+	{
+		const uint64_t end = phase->end ? min(phase->end, now) : now;
+		return end > phase->begin ? end - phase->begin : 0;
+	}
+
+	// tenths of a millisecond, as the COM32 printf has no floating point
+	static uint64_t tenths(const uint64_t cycles)
+	{
+		return cycles / (Opteron::tsc_mhz * 100ULL);
+	}
+
+	void profile_summary(void)
+	{
+		const uint64_t now = rdtscll();
+		unsigned order[PROFILE_PHASES];
+		uint64_t total = 0;
+
+		// insertion sort by decreasing duration
+		for (unsigned i = 0; i < profile.count; i++) {
+			unsigned j = i;
+			for (; j > 0 && duration(&profile.phases[order[j - 1]], now) < duration(&profile.phases[i], now); j--)
+				order[j] = order[j - 1];
+			order[j] = i;
+			total += duration(&profile.phases[i], now);
+		}
+
+		printf("Boot phases:\n");
+		for (unsigned i = 0; i < profile.count; i++) {
+			const struct profile_phase *phase = &profile.phases[order[i]];
+			const uint64_t cycles = duration(phase, now);
+			const uint32_t ms = tenths(cycles), share = total ? cycles * 1000 / total : 0;
+			printf("  %-16.*s %8u.%ums %3u.%u%% %9u accesses%s\n", (int)sizeof(phase->name), phase->name,
+			  ms / 10, ms % 10, share / 10, share % 10,
+			  phase->end ? phase->accesses : (uint32_t)(csr_accesses - phase->accesses), phase->end ? "" : " (running)");
+		}
+	}
+
+	// NULL if the heap is exhausted
+	struct profile_cluster *profile_cluster(const unsigned nnodes)
+	{
+		xassert(sizeof(struct profile_cluster) + nnodes * sizeof(struct profile_table) <= PROFILE_SIZE);
+		struct profile_cluster *cluster = (struct profile_cluster *)os_alloc(PROFILE_SIZE, 1 << 16);
+		if (!cluster)
+			return NULL;
+
+		memset(cluster, 0, sizeof(*cluster) + nnodes * sizeof(struct profile_table));
+		cluster->magic = PROFILE_MAGIC;
+		cluster->nnodes = nnodes;
+		return cluster;
+	}
+
+	// convert to local TSC, taking the time the table was copied as now; UDP latency is negligible
+	void profile_merge(struct profile_cluster *cluster, const unsigned index, const struct profile_table *table)
+	{
+		xassert(index < cluster->nnodes && table->magic == PROFILE_MAGIC && table->tsc_mhz);
+
+		const uint64_t now = rdtscll();
+		struct profile_table *dst = &cluster->tables[index];
+		*dst = *table;
+		dst->tsc_mhz = Opteron::tsc_mhz;
+		dst->now = now;
+
+		for (unsigned i = 0; i < dst->count; i++) {
+			struct profile_phase *phase = &dst->phases[i];
+			phase->begin = now - (table->now - phase->begin) * Opteron::tsc_mhz / table->tsc_mhz;
+			if (phase->end)
+				phase->end = now - (table->now - phase->end) * Opteron::tsc_mhz / table->tsc_mhz;
+		}
+	}
+
+	// every server's phases, then the server reaching the barrier phase last
+	void profile_timeline(const struct profile_cluster *cluster, const char *barrier)
+	{
+		const uint64_t now = rdtscll();
+		const uint64_t ms = Opteron::tsc_mhz * 1000ULL;
+		uint64_t origin = now;
+
+		for (unsigned n = 0; n < cluster->nnodes; n++)
+			if (cluster->tables[n].magic && cluster->tables[n].count)
+				origin = min(origin, cluster->tables[n].phases[0].begin);
+
+		printf("Cluster timeline (ms):\n");
+		const struct profile_table *last = NULL;
+		const struct profile_phase *arrival = NULL;
+
+		for (unsigned n = 0; n < cluster->nnodes; n++) {
+			const struct profile_table *table = &cluster->tables[n];
+			if (!table->magic) {
+				printf("  node %u: no profile received\n", n);
+				continue;
+			}
+
+			printf("  %03x:", table->sci);
+			for (unsigned i = 0; i < table->count; i++) {
+				const struct profile_phase *phase = &table->phases[i];
+				printf(" %.*s %u+%u", (int)sizeof(phase->name), phase->name,
+				  (uint32_t)((phase->begin - origin) / ms), (uint32_t)(duration(phase, now) / ms));
+
+				if (!strncmp(phase->name, barrier, sizeof(phase->name)) && (!arrival || phase->begin > arrival->begin)) {
+					arrival = phase;
+					last = table;
+				}
+			}
+			printf("\n");
+		}
+
+		if (!arrival)
+			return;
+
+		// longest phase before reaching the barrier; phases run as overlapping tasks count until then
+		const struct profile_phase *longest = &last->phases[0];
+		for (const struct profile_phase *phase = last->phases; phase < arrival; phase++)
+			if (duration(phase, arrival->begin) > duration(longest, arrival->begin))
+				longest = phase;
+
+		const uint32_t reached = tenths(arrival->begin - origin), spent = tenths(duration(longest, arrival->begin));
+		printf("Critical path: %03x reached %s last at %u.%ums, mostly in %.*s (%u.%ums)\n",
+		  last->sci, barrier, reached / 10, reached % 10, (int)sizeof(longest->name), longest->name, spent / 10, spent % 10);
+	}
+}
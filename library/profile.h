@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "base.h"
+
+// cluster-wide phase tables on the heap, E820-reserved for the OS; located via numachip_info, so 64KB-aligned
+#define PROFILE_SIZE   (256 << 10)
+#define PROFILE_MAGIC  0x31465250 // "PRF1"
+#define PROFILE_PHASES 24
+
+struct profile_phase {
+	char name[16];
+	uint64_t begin, end; // TSC; end is 0 while running
+	uint32_t accesses;   // config-space accesses
+} __attribute__((packed));
+
+// one server's phases; sent to the master in sync responses
+struct profile_table {
+	uint32_t magic;
+	uint16_t sci;
+	uint8_t count, rsv;
+	uint32_t tsc_mhz;
+	uint64_t now;        // TSC when copied, to align with the master's clock
+	struct profile_phase phases[PROFILE_PHASES];
+} __attribute__((packed));
+
+// tables on the master's timebase, indexed as config->nodes
+struct profile_cluster {
+	uint32_t magic;
+	uint16_t nnodes, rsv;
+	struct profile_table tables[];
+} __attribute__((packed));
+
+namespace lib
+{
+	// returns the phase's slot, for ending it while others run
+	unsigned phase_begin(const char *name) nonnull;
+	void phase_end(void);
+	void phase_end(const unsigned slot);
+	void profile_snapshot(struct profile_table *table, const sci_t sci) nonnull;
+	void profile_summary(void);
+
+	struct profile_cluster *profile_cluster(const unsigned nnodes);
+	void profile_merge(struct profile_cluster *cluster, const unsigned index, const struct profile_table *table) nonnull;
+	void profile_timeline(const struct profile_cluster *cluster, const char *barrier) nonnull;
+}
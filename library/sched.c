@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sched.h"
+#include "profile.h"
+
+// saves callee-saved registers on the current stack, stores its pointer to *from and resumes the stack at to
+extern "C" void sched_switch(uintptr_t *from, const uintptr_t to);
+
+#ifdef __x86_64__
+asm(".text\n"
+    ".globl sched_switch\n"
+    "sched_switch:\n"
+    "	push %rbp; push %rbx; push %r12; push %r13; push %r14; push %r15\n"
+    "	mov %rsp, (%rdi)\n"
+    "	mov %rsi, %rsp\n"
+    "	pop %r15; pop %r14; pop %r13; pop %r12; pop %rbx; pop %rbp\n"
+    "	ret\n");
+#define SAVED_REGS 6
+#else
+asm(".text\n"
+    ".globl sched_switch\n"
+    "sched_switch:\n"
+    "	mov 4(%esp), %eax\n"
+    "	mov 8(%esp), %edx\n"
+    "	push %ebp; push %ebx; push %esi; push %edi\n"
+    "	mov %esp, (%eax)\n"
+    "	mov %edx, %esp\n"
+    "	pop %edi; pop %esi; pop %ebx; pop %ebp\n"
+    "	ret\n");
+#define SAVED_REGS 4
+#endif
+
+namespace lib
+{
+	struct task {
+		const char *name;
+		void (*fn)(void);
+		unsigned deps; // tasks to finish first
+		uintptr_t sp;
+		uintptr_t *stack;
+		unsigned phase;
+		bool started, done;
+	};
+
+	static struct task tasks[TASK_MAX];
+	static unsigned ntasks;
+	static struct task *current;
+	static uintptr_t sched_sp;
+
+	unsigned task_add(const char *name, void (*fn)(void), const unsigned deps)
+	{
+		assertf(ntasks < TASK_MAX, "Too many boot tasks");
+		xassert(!(deps & ~((1U << ntasks) - 1))); // only on earlier tasks
+
+		struct task *task = &tasks[ntasks];
+		memset(task, 0, sizeof(*task));
+		task->name = name;
+		task->fn = fn;
+		task->deps = deps;
+		return 1U << ntasks++;
+	}
+
+	bool task_running(void)
+	{
+		return current;
+	}
+
+	void task_yield(void)
+	{
+		if (current)
+			sched_switch(&current->sp, sched_sp);
+	}
+
+	static void task_entry(void)
+	{
+		current->fn();
+		current->done = 1;
+		sched_switch(&current->sp, sched_sp);
+		fatal("Finished task %s resumed", current->name);
+	}
+
+	// the first switch pops zeroed registers then returns into task_entry
+	static void task_start(struct task *task)
+	{
+		task->stack = (uintptr_t *)zalloc(TASK_STACK);
+		uintptr_t *sp = (uintptr_t *)((uintptr_t)task->stack + TASK_STACK);
+
+		*--sp = 0; // task_entry's return address, keeping the ABI's stack alignment
+		*--sp = (uintptr_t)task_entry;
+		sp -= SAVED_REGS;
+		task->sp = (uintptr_t)sp;
+		task->started = 1;
+		task->phase = phase_begin(task->name);
+	}
+
+	void tasks_run(const bool overlap)
+	{
+		unsigned done = 0;
+
+		if (!overlap) {
+			for (unsigned i = 0; i < ntasks; i++) {
+				const unsigned phase = phase_begin(tasks[i].name);
+				tasks[i].fn();
+				phase_end(phase);
+			}
+
+			ntasks = 0;
+			return;
+		}
+
+		while (done != (1U << ntasks) - 1) {
+			bool ran = 0;
+
+			for (unsigned i = 0; i < ntasks; i++) {
+				struct task *task = &tasks[i];
+				if (task->done || (task->deps & ~done))
+					continue;
+
+				if (!task->started)
+					task_start(task);
+
+				current = task;
+				sched_switch(&sched_sp, task->sp);
+				current = NULL;
+				ran = 1;
+
+				if (task->done) {
+					phase_end(task->phase);
+					free(task->stack);
+					done |= 1U << i;
+				}
+			}
+
+			assertf(ran, "Boot tasks deadlocked");
+		}
+
+		ntasks = 0;
+	}
+}
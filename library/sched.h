@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "base.h"
+
+// cooperative tasks on the BSP, each with its own stack; polling loops yield so hardware waits overlap
+#define TASK_MAX   8
+#define TASK_STACK (32 << 10)
+
+namespace lib
+{
+	// returns the task's bit, for use in later tasks' dependency masks
+	unsigned task_add(const char *name, void (*fn)(void), const unsigned deps) nonnull;
+	// runs the added tasks to completion, interleaved if overlap, else in the order added
+	void tasks_run(const bool overlap);
+	// switch to another ready task; returns immediately outside a task
+	void task_yield(void);
+	bool task_running(void);
+
+	// udelay letting other tasks run; only for long waits outside any bus transaction
+	void task_udelay(const uint32_t usecs);
+
+	// in place of cpu_relax() when polling for a long self-contained wait, eg DRAM init or link-up
+	static inline void relax(void)
+	{
+		cpu_relax();
+		task_yield();
+	}
+}
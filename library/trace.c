@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "trace.h"
+#include "utils.h"
+#include "../opteron/opteron.h"
+#include "../platform/config.h"
+
+namespace lib
+{
+	struct trace_header *trace;
+	uint32_t csr_accesses;
+	static uint64_t trace_latest[TRACE_INDEX]; // 1 + sequence number of the latest entry per register hash
+
+	void trace_start(const uint32_t size)
+	{
+		xassert(size > sizeof(struct trace_header) + sizeof(struct trace_entry));
+
+		struct trace_header *header = (struct trace_header *)os_alloc(size, 0);
+		if (!header)
+			return;
+
+		memset(header, 0, sizeof(*header));
+		memset(trace_latest, 0, sizeof(trace_latest));
+		::memcpy(header->sig, TRACE_SIG, sizeof(header->sig));
+		header->size = size;
+		header->entries = (size - sizeof(*header)) / sizeof(struct trace_entry);
+		header->last = rdtscll();
+		trace = header;
+		trace_phase("startup");
+	}
+
+	void trace_phase(const char *name)
+	{
+		if (!trace || trace->nphases == TRACE_PHASES)
+			return;
+
+		struct trace_phase *phase = &trace->phases[trace->nphases++];
+		strncpy(phase->name, name, sizeof(phase->name) - 1);
+		phase->tsc = rdtscll();
+		// only known once the Opteron is probed
+		trace->tsc_mhz = Opteron::tsc_mhz;
+	}
+
+	void trace_record(const uint8_t type, const sci_t sci, const uint32_t reg, const uint32_t val)
+	{
+		const uint64_t now = rdtscll();
+		const uint8_t phase = trace->nphases - 1;
+		uint8_t full = type;
+
+		// before the config is loaded, only local accesses occur
+		if (sci != SCI_LOCAL && config && config->local_node && sci != config->local_node->id)
+			full |= TRACE_REMOTE;
+
+		trace->accesses++;
+
+		// fold repeats of the latest access to this register while it's still in the ring
+		uint64_t *latest = &trace_latest[lib::hash64(((uint64_t)sci << 32) ^ reg ^ ((uint64_t)full << 48)) % TRACE_INDEX];
+		if (*latest && trace->total - (*latest - 1) <= trace->entries) {
+			struct trace_entry *prev = &trace_ring(trace)[(*latest - 1) % trace->entries];
+			if ((prev->type & ~TRACE_SPREAD) == full && prev->phase == phase && prev->sci == sci && prev->reg == reg && prev->val == val) {
+				// further back than a polling loop, so work happened in between
+				if (trace->total - (*latest - 1) > TRACE_FOLD)
+					prev->type |= TRACE_SPREAD;
+				prev->repeat++;
+				trace->last = now;
+				return;
+			}
+		}
+
+		*latest = trace->total + 1;
+		struct trace_entry *entry = &trace_ring(trace)[trace->head];
+		entry->type = full;
+		entry->phase = phase;
+		entry->sci = sci;
+		entry->reg = reg;
+		entry->val = val;
+		entry->delta = min(now - trace->last, (uint64_t)~0U);
+		entry->repeat = 0;
+
+		trace->last = now;
+		trace->total++;
+		if (++trace->head == trace->entries)
+			trace->head = 0;
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "base.h"
+#include "atomic.h"
+
+// config-space access trace on the heap, left E820-reserved for the OS, which finds it by its signature
+#define TRACE_MAX    (16 << 20)
+#define TRACE_SIG    "NC2TRACE"
+#define TRACE_PHASES 64
+#define TRACE_FOLD   32 // repeats within this many entries count as polling
+#define TRACE_INDEX  4096
+
+// entry type bits; access size in bytes is in the upper nibble
+#define TRACE_WRITE  1
+#define TRACE_REMOTE 2 // to another server's config space
+#define TRACE_CF8    4 // legacy port IO config access
+#define TRACE_SPREAD 8 // repeats weren't consecutive, so are re-reads or rewrites rather than polling
+
+struct trace_entry {
+	uint8_t type;
+	uint8_t phase;
+	uint16_t sci;
+	uint32_t reg;    // PCI_MMIO_CONF() offset
+	uint32_t val;
+	uint32_t delta;  // TSC cycles since the previous entry, saturated
+	uint32_t repeat; // later identical accesses folded into this one, eg polling
+} __attribute__((packed));
+
+struct trace_phase {
+	char name[24];
+	uint64_t tsc;    // at phase start
+} __attribute__((packed));
+
+struct trace_header {
+	char sig[8];
+	uint32_t size;    // bytes including header
+	uint32_t entries; // ring capacity
+	uint32_t head;    // next entry to write
+	uint32_t nphases;
+	uint64_t total;   // entries written, including overwritten ones
+	uint64_t accesses; // including folded repeats
+	uint64_t last;    // TSC at the latest access
+	uint32_t tsc_mhz;
+	uint32_t reserved;
+	struct trace_phase phases[TRACE_PHASES];
+} __attribute__((packed));
+
+namespace lib
+{
+	extern struct trace_header *trace;
+	extern uint32_t csr_accesses; // whether traced or not; phases take differences, so wrapping is harmless
+
+	void trace_start(const uint32_t size);
+	void trace_phase(const char *name) nonnull;
+	void trace_record(const uint8_t type, const sci_t sci, const uint32_t reg, const uint32_t val);
+
+	static inline void trace_access(const uint8_t type, const sci_t sci, const uint32_t reg, const uint32_t val)
+	{
+		// from every core running work items
+		atomic_increment(&csr_accesses);
+		if (trace)
+			trace_record(type, sci, reg, val);
+	}
+
+	static inline struct trace_entry *trace_ring(struct trace_header *header)
+	{
+		return (struct trace_entry *)(header + 1);
+	}
+}
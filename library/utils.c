@@ -20,6 +20,7 @@
 #include <inttypes.h>
 
 #include "utils.h"
+#include "sched.h"
 #include "../opteron/opteron.h"
 
 #define PRETTY_SIZE 16
@@ -57,6 +58,7 @@ namespace lib
 		} while (ch != 0x0a && ch != 0x0d); // enter
 	}
 
+#ifndef SIM
 	void udelay(const uint32_t usecs)
 	{
 		uint64_t limit = lib::rdtscll() + (uint64_t)usecs * Opteron::tsc_mhz;
@@ -65,6 +67,15 @@ namespace lib
 			cpu_relax();
 	}
 
+	void task_udelay(const uint32_t usecs)
+	{
+		uint64_t limit = lib::rdtscll() + (uint64_t)usecs * Opteron::tsc_mhz;
+
+		while (lib::rdtscll() < limit)
+			relax();
+	}
+#endif
+
 	const char *pr_size(uint64_t size)
 	{
 		static char pretty[PRETTY_COUNT][PRETTY_SIZE];
@@ -106,4 +117,16 @@ namespace lib
 		dump(src, n);
 		::memcpy(dst, src, n);
 	}
+
+	// buffers left to the OS are carved from the heap, being RAM the BIOS gave the module, so clash with nothing else;
+	// page-aligned for reserving in E820, and never freed; NULL if the heap is exhausted
+	void *os_alloc(const uint32_t size, const uint32_t align)
+	{
+		const uint32_t step = max(align, 4096U);
+		char *raw = (char *)malloc(roundup(size, 4096U) + step);
+		if (!raw)
+			return NULL;
+
+		return (void *)roundup((uintptr_t)raw, (uintptr_t)step);
+	}
 }
@@ -24,6 +24,7 @@
 
 namespace lib
 {
+#ifndef SIM
 	static inline uint64_t rdtscll(void)
 	{
 		uint64_t val;
@@ -31,6 +32,9 @@ namespace lib
 		asm volatile("mfence; rdtsc" : "=A"(val));
 		return val;
 	}
+#else
+	uint64_t rdtscll(void);
+#endif
 
 	static inline uint32_t bswap32(uint32_t val)
 	{
@@ -43,6 +47,7 @@ namespace lib
 	const char *pr_size(uint64_t size);
 	void dump(const void *addr, const unsigned len);
 	void memcpy(void *dst, const void *src, size_t n);
+	void *os_alloc(const uint32_t size, const uint32_t align);
 
 	static inline uint64_t hash64(uint64_t u) {
 		u += 1;
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "work.h"
+#include "access.h"
+#include "atomic.h"
+#include "utils.h"
+#include "../opteron/msrs.h"
+#include "../numachip2/numachip.h"
+
+namespace lib
+{
+	struct work_pool *work_new(void)
+	{
+		return (struct work_pool *)zalloc(sizeof(struct work_pool));
+	}
+
+	void work_free(struct work_pool *pool)
+	{
+		for (unsigned i = 0; i < pool->nqueues; i++)
+			free(pool->queues[i].items);
+		free(pool->queues);
+		free(pool);
+	}
+
+	static struct work_queue *queue(struct work_pool *pool, const sci_t sci)
+	{
+		for (unsigned i = 0; i < pool->nqueues; i++)
+			if (pool->queues[i].sci == sci)
+				return &pool->queues[i];
+
+		pool->queues = (struct work_queue *)realloc(pool->queues, (pool->nqueues + 1) * sizeof(*pool->queues));
+		xassert(pool->queues);
+
+		struct work_queue *q = &pool->queues[pool->nqueues++];
+		memset(q, 0, sizeof(*q));
+		q->sci = sci;
+		return q;
+	}
+
+	void work_add(struct work_pool *pool, const sci_t sci, const char *name, const work_fn fn, void *arg)
+	{
+		struct work_queue *q = queue(pool, sci);
+
+		if (q->tail == q->size) {
+			q->size = q->size ? q->size * 2 : 8;
+			q->items = (struct work_item *)realloc(q->items, q->size * sizeof(*q->items));
+			xassert(q->items);
+		}
+
+		struct work_item *item = &q->items[q->tail++];
+		item->name = name;
+		item->fn = fn;
+		item->arg = arg;
+		pool->items++;
+	}
+
+	uint32_t work_queued(const struct work_pool *pool, const sci_t sci)
+	{
+		for (unsigned i = 0; i < pool->nqueues; i++)
+			if (pool->queues[i].sci == sci)
+				return pool->queues[i].tail;
+
+		return 0;
+	}
+
+	static struct work_item *claim(struct work_queue *q)
+	{
+		uint32_t head = ACCESS_ONCE(q->head);
+
+		while (head < q->tail) {
+			const uint32_t seen = atomic_compare_and_exchange(&q->head, head, head + 1);
+			if (seen == head)
+				return &q->items[head];
+			head = seen;
+		}
+
+		return NULL;
+	}
+
+	void work_loop(struct work_pool *pool, const sci_t sci)
+	{
+		unsigned home = pool->nqueues;
+		for (unsigned i = 0; i < pool->nqueues; i++)
+			if (pool->queues[i].sci == sci)
+				home = i;
+
+		if (home == pool->nqueues) {
+			if (pool->strict)
+				return;
+			home = 0;
+		}
+
+		// queues are only filled before dispatch, so one pass over them finds every item
+		for (unsigned n = 0; n < (pool->strict ? 1 : pool->nqueues); n++) {
+			struct work_queue *q = &pool->queues[(home + n) % pool->nqueues];
+			struct work_item *item;
+
+			while ((item = claim(q))) {
+				const int err = item->fn(item->arg);
+				if (err) {
+					if (!atomic_compare_and_exchange(&pool->error, 0, err))
+						pool->failed = item;
+					atomic_increment(&pool->errors);
+				}
+
+				atomic_increment(&q->done);
+				atomic_increment(&pool->done);
+				cpu_relax(); // let siblings at the queue
+			}
+		}
+	}
+
+	extern "C" void work_entry(void *pool)
+	{
+		// once set up, each server's cores have their NumaChip's MCFG window
+		const uint64_t mcfg = rdmsr(MSR_MCFG) & ~0xfffffffULL;
+		const bool own = mcfg >= Numachip2::MCFG_BASE && mcfg <= Numachip2::MCFG_LIM;
+
+		work_loop((struct work_pool *)pool, own ? (mcfg - Numachip2::MCFG_BASE) >> 28 : 0xffff);
+	}
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "base.h"
+
+// work items run by application cores via the trampoline's work vector, and by the BSP while it waits
+namespace lib
+{
+	// runs on any core, so mustn't print, allocate or call the BIOS; returns 0 or an error code
+	typedef int (*work_fn)(void *arg);
+
+	struct work_item {
+		const char *name;
+		work_fn fn;
+		void *arg;
+	};
+
+	// filled by the BSP before dispatch; cores claim items by advancing head with compare-and-exchange
+	struct work_queue {
+		struct work_item *items;
+		uint32_t head, tail, size;
+		uint32_t done;
+		sci_t sci; // server whose cores take from here first
+	};
+
+	struct work_pool {
+		struct work_queue *queues;
+		unsigned nqueues;
+		uint32_t items, done, errors;
+		int error;                      // first error returned
+		const struct work_item *failed; // by this item
+		bool strict;                    // items only run on their server's cores, as for measurements
+	};
+
+	struct work_pool *work_new(void);
+	void work_free(struct work_pool *pool) nonnull;
+	void work_add(struct work_pool *pool, const sci_t sci, const char *name, const work_fn fn, void *arg);
+	// items queued for the server
+	uint32_t work_queued(const struct work_pool *pool, const sci_t sci) nonnull;
+	// claims items until all queues are empty, the server's own queue first
+	void work_loop(struct work_pool *pool, const sci_t sci) nonnull;
+	// called by the trampoline in flat protected mode on the core's own stack
+	extern "C" void work_entry(void *pool);
+}
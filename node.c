@@ -67,7 +67,9 @@ void Node::tracing_arm(void)
 
 void Node::tracing_start(void)
 {
+#ifndef SIM
 	asm volatile("wbinvd");
+#endif
 	for (ht_t n = 0; n < nopterons; n++)
 		opterons[n]->tracing_start();
 }
@@ -78,35 +80,6 @@ void Node::tracing_stop(void)
 		opterons[n]->tracing_stop();
 }
 
-void Node::trim_dram_maps(void)
-{
-	// trim nodes if over supported or requested memory config
-	int64_t over = max((int64_t)(dram_size - options->memlimit), (int64_t)(dram_size & ((1ULL << Numachip2::SIU_ATT_SHIFT) - 1)));
-	if (over <= 0)
-		return;
-
-	printf("Trimming %03x maps by %" PRIu64 "MB\n", config->id, over >> 20);
-
-	while (over > 0) {
-		uint64_t max = 0;
-
-		// find largest HT node
-		for (ht_t n = 0; n < nopterons; n++)
-			if (opterons[n]->dram_size > max)
-				max = opterons[n]->dram_size;
-
-		// reduce largest HT node by 16MB
-		for (Opteron *const *nb = &opterons[0]; nb < &opterons[nopterons]; nb++) {
-			if ((*nb)->dram_size == max) {
-				(*nb)->dram_size -= 1ULL << 24;
-				dram_size -= 1ULL << 24;
-				over -= 1ULL << 24;
-				break;
-			}
-		}
-	}
-}
-
 // instantiated for remote nodes
 Node::Node(Config::node *_config, const ht_t ht): local(0), master_sci(SCI_LOCAL), neigh_ht(0), neigh_link(0), apics(), napics(0), nopterons(ht), numachip(NULL), config(_config), dram_end(0), trace_base(0), trace_lim(0), mmio32_base(0), mmio32_limit(0), mmio64_base(0), mmio64_limit(0), apic_offset(0)
 {
@@ -138,6 +111,8 @@ Node::Node(Config::node *_config, const sci_t _master_sci): local(1), master_sci
 #ifndef SIM
 	const ht_t nc = Opteron::ht_fabric_fixup(neigh_ht, neigh_link, Numachip2::VENDEV_NC2);
 #else
+	neigh_ht = 0;
+	neigh_link = 0;
 	const ht_t nc = 1;
 #endif
 	assertf(nc, "NumaChip2 not found");
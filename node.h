@@ -52,7 +52,6 @@ public:
 	void tracing_arm(void);
 	void tracing_start(void);
 	void tracing_stop(void);
-	void trim_dram_maps(void);
 
 	Node(Config::node *_config, const ht_t ht);
 	Node(Config::node *_config, const sci_t _master_sci);
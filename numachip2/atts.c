@@ -43,9 +43,12 @@ void Numachip2::DramAtt::init(void)
 
 void Numachip2::DramAtt::range(const uint64_t base, const uint64_t limit, const sci_t dest)
 {
-	if (options->debug.maps)
-		printf("%s: DRAM ATT 0x%012" PRIx64 ":0x%012" PRIx64 " to %03x", pr_node(numachip.config->id), base, limit, dest);
+	debugf(maps, "%s: DRAM ATT 0x%012" PRIx64 ":0x%012" PRIx64 " to %03x\n", pr_node(numachip.config->id), base, limit, dest);
+	fill(base, limit, dest);
+}
 
+void Numachip2::DramAtt::fill(const uint64_t base, const uint64_t limit, const sci_t dest)
+{
 	xassert(limit > base);
 	xassert(limit < (1ULL << depth));
 
@@ -57,9 +60,6 @@ void Numachip2::DramAtt::range(const uint64_t base, const uint64_t limit, const
 
 	for (uint64_t addr = base; addr < (limit + 1U); addr += 1ULL << SIU_ATT_SHIFT)
 		numachip.write32(SIU_ATT_ENTRY, dest);
-
-	if (options->debug.maps)
-		printf("\n");
 }
 
 Numachip2::MmioAtt::MmioAtt(Numachip2 &_numachip): numachip(_numachip)
@@ -72,8 +72,7 @@ void Numachip2::MmioAtt::init(void)
 
 void Numachip2::MmioAtt::range(const uint64_t base, const uint64_t limit, const sci_t dest)
 {
-	if (options->debug.maps)
-		printf("%s: MMIO32 ATT 0x%" PRIx64 ":0x%" PRIx64 " to %03x", pr_node(numachip.config->id), base, limit, dest);
+	debugf(maps, "%s: MMIO32 ATT 0x%" PRIx64 ":0x%" PRIx64 " to %03x", pr_node(numachip.config->id), base, limit, dest);
 
 	xassert(limit > base);
 	const uint64_t mask = (1ULL << MMIO32_ATT_SHIFT) - 1;
@@ -85,6 +84,5 @@ void Numachip2::MmioAtt::range(const uint64_t base, const uint64_t limit, const
 	for (uint64_t addr = base; addr < (limit + 1U); addr += 1ULL << MMIO32_ATT_SHIFT)
 		numachip.write32(PIU_ATT_ENTRY, dest);
 
-	if (options->debug.maps)
-		printf("\n");
+	debugf(maps, "\n");
 }
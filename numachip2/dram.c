@@ -16,16 +16,14 @@
  */
 
 #include "numachip.h"
+#include "ncache.h"
 #include "../bootloader.h"
+#include "../library/sched.h"
 #include "../library/utils.h"
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
-#define MTAG16_SHIFT 5
-#define MTAG8_SHIFT 6
-#define CTAG_SHIFT 3
-
 bool Numachip2::dram_check(void) const
 {
 	uint32_t val = read32(MCTR_ECC_STATUS);
@@ -46,7 +44,44 @@ void Numachip2::dram_reset(void)
 		printf("<mctr PHY reset>");
 }
 
-void Numachip2::dram_init(void)
+// percentage of the running BIST pass, from its address counter in 64-bit words
+unsigned Numachip2::dram_progress(void) const
+{
+	return (uint64_t)read32(MCTR_BIST_ADDR) * 100 >> (dram_total_shift - 3);
+}
+
+// bytes of remote memory the nCache holds; the local register isn't programmed until dram_init_wait, but slaves
+// program theirs before reporting in
+uint64_t Numachip2::ncache_size(void) const
+{
+	if (local)
+		return 1ULL << dram_ncache_shift;
+	return 1ULL << (30 + ((read32(NCACHE_CTRL) >> 3) & 3));
+}
+
+// progress is only shown when not overlapped with other tasks' output
+void Numachip2::dram_bist_wait(const char *what) const
+{
+	const bool progress = !lib::task_running();
+	unsigned shown = ~0U;
+
+	printf("<%s", what);
+	while (read32(MCTR_BIST_CTRL) & 1) {
+		const unsigned percent = min(dram_progress(), 99U);
+		if (progress && percent != shown) {
+			printf(" %2u%%\b\b\b\b", percent);
+			shown = percent;
+		}
+		lib::relax();
+	}
+
+	if (shown != ~0U)
+		printf("    \b\b\b\b");
+	printf(">");
+}
+
+// train, optionally test, then start zeroing the nCache DIMM; the tags are set up by dram_init_wait
+void Numachip2::dram_init_start(void)
 {
 	int i;
 
@@ -72,7 +107,7 @@ void Numachip2::dram_init(void)
 			// exit early if all up
 			if (allup)
 				break;
-			cpu_relax();
+			lib::relax();
 		}
 
 		// mctr PHY are not up; restart training
@@ -94,61 +129,48 @@ void Numachip2::dram_init(void)
 	// test memory
 	write32(MCTR_BIST_ADDR, 0);
 	if (options->dimmtest) {
-		const char baton[] = "-\\|/";
 		write32(MCTR_BIST_CTRL, ((options->dimmtest & 0xff) << 16) | ((dram_total_shift - 3) << 3) | (1<<2) | (1<<1) | (1<<0));
-		printf("<testing ");
-		while (read32(MCTR_BIST_CTRL) & 1) {
-			printf("%c\b", baton[i++ % (sizeof(baton) - 1)]);
-			lib::udelay(1000000);
-		}
-		printf("\b>");
+		dram_bist_wait("testing");
 		assertf(((read32(MCTR_BIST_CTRL) >> 9) & 3) == 3, "NumaConnect DIMM failure");
 	}
 
-	// start zeroing and wait
+	// start zeroing; completes in the background
+	write32(MCTR_BIST_ADDR, 0);
 	write32(MCTR_BIST_CTRL, (1<<12) | ((dram_total_shift - 3) << 3) | (1<<2) | (1<<0));
-	printf("<zeroing");
-	while (read32(MCTR_BIST_CTRL) & 1)
-		cpu_relax();
-	printf(">");
 
-	const uint64_t hosttotal = e820->memlimit();
-	bool mtag_byte_mode = ((read32(PE_STATUS + 1 * PE_OFFSET) & (1<<31)) != 0);
-	unsigned ncache_shift = 30; // minimum
-	uint64_t ctag = 1ULL << (ncache_shift - CTAG_SHIFT);
-	// round up to mask constraints to allow manipulation
-	uint64_t mtag = roundup((hosttotal >> (mtag_byte_mode ? MTAG8_SHIFT : MTAG16_SHIFT)) + 1, 1 << 19);
-
-	// check if insufficient MTag
-	if (mtag > (total - (1ULL << ncache_shift) - ctag)) {
-		// round down to mask constraint
-		mtag = (total - (1ULL << ncache_shift) - ctag) & ~((1 << 19) - 1);
-	} else {
-		// check if nCache can use more space
-		while ((1ULL << ncache_shift) + ctag + mtag <= total) {
-			ncache_shift++;
-			ctag = 1ULL << (ncache_shift - CTAG_SHIFT);
-		}
+	const bool mtag_byte_mode = ((read32(PE_STATUS + 1 * PE_OFFSET) & (1<<31)) != 0);
+	struct ncache_layout layout;
+	assertf(ncache_layout(&layout, total, e820->memlimit(), mtag_byte_mode, options->ncache), "NumaConnect DIMM too small for the nCache and tags");
 
-		// too large, use next size down
-		ncache_shift--;
-		ctag = 1ULL << (ncache_shift - CTAG_SHIFT);
-	}
+	if (options->ncache && options->ncache != 1ULL << layout.shift)
+		warning("Using %uMB nCache rather than %" PRIu64 "MB", 1 << (layout.shift - 20), options->ncache >> 20);
+	if (layout.memlimit < e820->memlimit())
+		warning("MTag covers only %" PRIu64 "GB of %" PRIu64 "GB memory", layout.memlimit >> 30, e820->memlimit() >> 30);
 
-	uint64_t mtag_base = (1ULL << ncache_shift) + ctag;
-	uint64_t mtag_mask = roundup_pow2(mtag, 1 << 19);
-	options->memlimit = (total - mtag_base) << (mtag_byte_mode ? MTAG8_SHIFT : MTAG16_SHIFT);
+	// known before zeroing completes, as remote servers' memory is limited by it
+	dram_ncache_shift = layout.shift;
+	dram_ctag = layout.ctag;
+	dram_mtag_base = layout.mtag_base;
+	dram_mtag_mask = layout.mtag_mask;
+	options->memlimit = layout.memlimit;
+
+	printf("%dMB nCache, zeroing\n", 1 << (dram_ncache_shift - 20));
+}
+
+// before the nCache or tags are used, so at the latest before coherency is enabled
+void Numachip2::dram_init_wait(void)
+{
+	printf("DRAM init: ");
+	dram_bist_wait("zeroing");
 
 	// nCache, then CTag, then MTag
-	write32(NCACHE_CTRL, (ncache_shift - 30) << 3);
-	write32(CTAG_BASE + TAG_ADDR_MASK, (1 << (ncache_shift - 30)) - 1);
+	write32(NCACHE_CTRL, (dram_ncache_shift - 30) << 3);
+	write32(CTAG_BASE + TAG_ADDR_MASK, (1 << (dram_ncache_shift - 30)) - 1);
 	write32(MTAG_BASE + TAG_ADDR_MASK, 0x7f);     // no tag comparison mask for MTag
-	write32(CTAG_BASE + TAG_MCTR_OFFSET, 1ULL << (ncache_shift - 19));
-	write32(CTAG_BASE + TAG_MCTR_MASK, (ctag >> 19) - 1);
-	write32(MTAG_BASE + TAG_MCTR_OFFSET, mtag_base >> 19);
-	write32(MTAG_BASE + TAG_MCTR_MASK, (mtag_mask >> 19) - 1);
-
-	printf("%dMB nCache", 1 << (ncache_shift - 20));
+	write32(CTAG_BASE + TAG_MCTR_OFFSET, 1ULL << (dram_ncache_shift - 19));
+	write32(CTAG_BASE + TAG_MCTR_MASK, (dram_ctag >> 19) - 1);
+	write32(MTAG_BASE + TAG_MCTR_OFFSET, dram_mtag_base >> 19);
+	write32(MTAG_BASE + TAG_MCTR_MASK, (dram_mtag_mask >> 19) - 1);
 
 #ifdef DEBUG
 	printf("CTag TAG_ADDR_MASK   %08x\n", read32(CTAG_BASE + TAG_ADDR_MASK));
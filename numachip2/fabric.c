@@ -22,13 +22,30 @@
 #include "numachip.h"
 #include "lc.h"
 #include "router.h"
+#include "routecache.h"
+#include "spi.h"
 #include "../platform/config.h"
 #include "../bootloader.h"
+#include "../library/utils.h"
+
+// persist routing tables in the SPI EEPROM
+class SpiStore: public RouteStore {
+	Numachip2 &numachip;
+public:
+	SpiStore(Numachip2 &_numachip): numachip(_numachip) {}
+	void read(const uint16_t addr, const unsigned len, uint8_t *data)
+	{
+		numachip.spi_read(addr, len, data);
+	}
+	void write(const uint16_t addr, const unsigned len, uint8_t *data)
+	{
+		numachip.spi_write(addr, len, data);
+	}
+};
 
 void Numachip2::fabric_reset(void)
 {
-	if (options->debug.fabric)
-		printf("<reset>");
+	debugf(fabric, "<reset>");
 
 	// ensure all links are in reset
 	uint32_t mask = 0x3f;
@@ -106,7 +123,7 @@ bool Numachip2::fabric_train(void)
 		// exit early if all up
 		if (allup)
 			break;
-		cpu_relax();
+		lib::relax();
 	}
 
 	// not all links are up; restart training if we have errors
@@ -186,7 +203,21 @@ void Numachip2::fabric_routing(void)
 	memset(siu_routes, 0xff, sizeof(siu_routes));
 
 	printf("Routing:\n");
-	router->run(::config->nnodes);
+	SpiStore store(*this);
+	RouteCache cache(*router, config->id, ::config->nnodes, ROUTE_CACHE_VERSION, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+
+	// large clusters always compute routes, which is expected rather than a warning
+	const bool cached = options->route_cache && cache.fits();
+	if (options->route_cache && !cached)
+		printf("- routing tables for %u servers are too large to cache\n", ::config->nnodes);
+
+	if (cached && cache.load(store))
+		printf("- using cached routes for topology %016" PRIx64 "\n", cache.topology());
+	else {
+		router->run(::config->nnodes);
+		if (cached)
+			cache.save(store);
+	}
 
 	for (unsigned node = 0; node < ::config->nnodes; node++) {
 		for (unsigned p = 0; p <= 6; p++) {
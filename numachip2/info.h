@@ -33,5 +33,7 @@ struct numachip_info {
 	unsigned neigh_ht : 3;
 	unsigned neigh_link : 2;
 	unsigned linkmask : 6;     // bitmask of links to scan
+	unsigned bench : 1;        // fabric matrix in an E820-reserved page starting with BENCH_MAGIC
 	bool lc4;                  // else LC5
+	uint16_t profile;          // address of cluster boot phase tables >> 16, or 0
 } __attribute__((packed)) __attribute__((aligned(4)));
@@ -36,7 +36,7 @@ public:
 	virtual uint64_t status(void) {return 0;};
 	virtual bool check(void) = 0;
 	virtual void clear(void) {};
-	virtual void add_route(const sci_t, const uint8_t);
+	virtual void add_route(const sci_t, const uint8_t) {};
 	virtual void commit(void) {};
 };
 
@@ -27,9 +27,8 @@ Numachip2::MmioMap::MmioMap(Numachip2 &_numachip): numachip(_numachip), used(0)
 
 void Numachip2::MmioMap::set(const unsigned range, const uint64_t base, const uint64_t limit, const uint8_t dht)
 {
-	if (options->debug.maps)
-		printf("Adding NC MMIO range %d on %s: 0x%08" PRIx64 ":0x%08" PRIx64 " to %d\n",
-			range, pr_node(numachip.config->id), base, limit, dht);
+	debugf(maps, "Adding NC MMIO range %d on %s: 0x%08" PRIx64 ":0x%08" PRIx64 " to %d\n",
+		range, pr_node(numachip.config->id), base, limit, dht);
 
 	xassert(limit > base);
 	xassert(range < Numachip2::MMIO_RANGES);
@@ -58,8 +57,7 @@ void Numachip2::MmioMap::add(const uint64_t base, const uint64_t limit, const ui
 
 void Numachip2::MmioMap::del(const unsigned range)
 {
-	if (options->debug.maps)
-		printf("Deleting NC MMIO range %u on %s\n", range, pr_node(numachip.config->id));
+	debugf(maps, "Deleting NC MMIO range %u on %s\n", range, pr_node(numachip.config->id));
 
 	xassert(range < Numachip2::MMIO_RANGES);
 
@@ -111,9 +109,8 @@ Numachip2::DramMap::DramMap(Numachip2 &_numachip): numachip(_numachip)
 
 void Numachip2::DramMap::set(const unsigned range, const uint64_t base, const uint64_t limit, const uint8_t dht)
 {
-	if (options->debug.maps)
-		printf("Adding NC DRAM range %u on %s: 0x%012" PRIx64 ":0x%012" PRIx64 " to %d\n",
-			range, pr_node(numachip.config->id), base, limit, dht);
+	debugf(maps, "Adding NC DRAM range %u on %s: 0x%012" PRIx64 ":0x%012" PRIx64 " to %d\n",
+		range, pr_node(numachip.config->id), base, limit, dht);
 
 	xassert(limit > base);
 	xassert(range < Numachip2::DRAM_RANGES);
@@ -132,8 +129,7 @@ void Numachip2::DramMap::set(const unsigned range, const uint64_t base, const ui
 
 void Numachip2::DramMap::del(const unsigned range)
 {
-	if (options->debug.maps)
-		printf("Deleting NC DRAM range %u on %s\n", range, pr_node(numachip.config->id));
+	debugf(maps, "Deleting NC DRAM range %u on %s\n", range, pr_node(numachip.config->id));
 
 	xassert(range < Numachip2::DRAM_RANGES);
 
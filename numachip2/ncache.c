@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ncache.h"
+#include "../library/base.h"
+
+#define MTAG_GRANULE (1ULL << 19) // tag offset and mask granularity
+
+static uint64_t ncache_tags(const unsigned shift)
+{
+	return (1ULL << shift) + (1ULL << (shift - CTAG_SHIFT));
+}
+
+bool ncache_layout(struct ncache_layout *layout, const uint64_t total, const uint64_t hosttotal, const bool byte_mode, const uint64_t ncache)
+{
+	const unsigned mtag_shift = byte_mode ? MTAG8_SHIFT : MTAG16_SHIFT;
+	// round up to mask constraints to allow manipulation
+	const uint64_t wanted = roundup((hosttotal >> mtag_shift) + 1, MTAG_GRANULE);
+	unsigned shift = NCACHE_MIN_SHIFT;
+
+	if (ncache) {
+		while (shift < NCACHE_MAX_SHIFT && (1ULL << shift) < ncache)
+			shift++;
+		// sizes too large for the DIMM step down, still leaving a granule of MTag
+		while (shift > NCACHE_MIN_SHIFT && ncache_tags(shift) + MTAG_GRANULE > total)
+			shift--;
+	} else {
+		// largest leaving MTag for all host memory, else the smallest
+		for (unsigned s = NCACHE_MIN_SHIFT; s <= NCACHE_MAX_SHIFT; s++)
+			if (ncache_tags(s) + wanted <= total)
+				shift = s;
+	}
+
+	if (ncache_tags(shift) + MTAG_GRANULE > total)
+		return 0;
+
+	layout->shift = shift;
+	layout->ctag = 1ULL << (shift - CTAG_SHIFT);
+	layout->mtag_base = ncache_tags(shift);
+	// round down to mask constraint if insufficient
+	const uint64_t mtag = min(wanted, (total - layout->mtag_base) & ~(MTAG_GRANULE - 1));
+	layout->mtag_mask = roundup_pow2(mtag, MTAG_GRANULE);
+	layout->memlimit = (total - layout->mtag_base) << mtag_shift;
+	return 1;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define MTAG16_SHIFT 5 // host bytes per MTag byte, as log2
+#define MTAG8_SHIFT 6
+#define CTAG_SHIFT 3   // nCache bytes per CTag byte, as log2
+
+#define NCACHE_MIN_SHIFT 30 // NCACHE_CTRL encodes 1GB to 8GB
+#define NCACHE_MAX_SHIFT 33
+
+// the nCache DIMM: nCache, then CTag, then MTag
+struct ncache_layout {
+	unsigned shift;                       // nCache of 2^shift bytes
+	uint64_t ctag, mtag_base, mtag_mask;
+	uint64_t memlimit;                    // host memory the MTag covers
+};
+
+// size for the DIMM and the host memory to cover; ncache is the wanted size, stepped down if it doesn't fit, or 0 for
+// the most leaving the host covered; false if even the smallest doesn't fit
+bool ncache_layout(struct ncache_layout *layout, const uint64_t total, const uint64_t hosttotal, const bool byte_mode, const uint64_t ncache);
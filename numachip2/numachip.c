@@ -138,7 +138,6 @@ void Numachip2::late_init(void)
 	dramatt.init();
 	mmioatt.init();
 
-	dram_init();
 	fabric_init();
 	pe_init();
 
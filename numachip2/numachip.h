@@ -56,6 +56,8 @@ class Numachip2 {
 		explicit DramAtt(Numachip2 &_numachip);
 		void init(void);
 		void range(const uint64_t base, const uint64_t limit, const sci_t dest);
+		// without logging, so usable from work items
+		void fill(const uint64_t base, const uint64_t limit, const sci_t dest);
 	};
 
 	class MmioAtt {
@@ -77,6 +79,8 @@ class Numachip2 {
 	uint8_t nlcs;
 	const bool local;
 	unsigned dram_total_shift;
+	unsigned dram_ncache_shift;             // nCache layout, set up once zeroed
+	uint64_t dram_ctag, dram_mtag_base, dram_mtag_mask;
 	struct spi_board_info board_info;
 	uint64_t prev_tval;
 
@@ -97,7 +101,8 @@ class Numachip2 {
 
 	/* dram.c */
 	void dram_reset(void);
-	void dram_init(void);
+	unsigned dram_progress(void) const;
+	void dram_bist_wait(const char *what) const nonnull;
 
 	/* pe.c */
 	void pe_load_microcode(const unsigned pe);
@@ -232,6 +237,7 @@ public:
 	friend class DramAtt;
 	MmioAtt mmioatt;
 	friend class MmioAtt;
+	friend class SpiStore;
 
 	static uint32_t read64(const sci_t sci, const ht_t ht, const reg_t reg);
 	uint64_t read64(const reg_t reg) const;
@@ -247,6 +253,8 @@ public:
 	void apic_icr_write(const uint32_t low, const uint32_t apicid);
 	static ht_t probe(const sci_t sci);
 	static ht_t probe_slave(const sci_t sci);
+	void dram_init_start(void);
+	void dram_init_wait(void);
 	void late_init(void);
 	void finished(void);
 	uint32_t rom_read(const uint8_t reg);
@@ -257,6 +265,7 @@ public:
 	bool fabric_check(void) const;
 	void fabric_reset(void);
 	bool dram_check(void) const;
+	uint64_t ncache_size(void) const;
 	static bool check(const sci_t sci, const ht_t ht);
 	bool check(void) const;
 	void flash(const uint8_t *image, const size_t len);
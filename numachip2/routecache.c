@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "routecache.h"
+#include "../library/base.h"
+#include "../library/utils.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+RouteCache::RouteCache(Router &_router, const nodeid_t _node, const unsigned _nnodes, const uint32_t _version,
+  const uint16_t _base, const unsigned _limit):
+  router(_router), node(_node), nnodes(_nnodes), version(_version), base(_base), limit(_limit)
+{
+	xassert(nnodes <= MAX_NODE && node < nnodes);
+	router.size(nnodes); // filled by load() or Router::run()
+}
+
+// routes for each ingress port of the local node, then the distance matrix
+unsigned RouteCache::length(void) const
+{
+	return XBAR_PORTS * nnodes + nnodes * nnodes;
+}
+
+uint64_t RouteCache::topology(void) const
+{
+	uint64_t hash = lib::hash64(nnodes | MAX_DETOUR << 24 | (uint64_t)HOP_COST << 32);
+
+	for (nodeid_t n = 0; n < nnodes; n++)
+		for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++)
+			hash = lib::hash64(hash ^ ((uint64_t)n << 32 | (uint64_t)xbarid << 24 | router.neigh[n][xbarid].nodeid << 8 | router.neigh[n][xbarid].xbarid));
+
+	return hash;
+}
+
+bool RouteCache::fits(void) const
+{
+	return sizeof(struct route_cache_header) + length() <= limit;
+}
+
+// write in chunks that don't cross pages
+void RouteCache::program(RouteStore &store, uint8_t *buf, unsigned offset, const unsigned end) const
+{
+	while (offset < end) {
+		const unsigned len = min(ROUTE_CACHE_PAGE - ((base + offset) % ROUTE_CACHE_PAGE), end - offset);
+		store.write(base + offset, len, buf + offset);
+		offset += len;
+	}
+}
+
+bool RouteCache::load(RouteStore &store)
+{
+	struct route_cache_header header;
+	store.read(base, sizeof(header), (uint8_t *)&header);
+
+	if (header.magic != ROUTE_CACHE_MAGIC || header.version != version || header.topology != topology() ||
+	  header.node != node || header.nnodes != nnodes || header.length != length())
+		return 0;
+
+	if (!fits())
+		return 0;
+
+	const unsigned total = sizeof(header) + header.length;
+
+	uint8_t *buf = (uint8_t *)zalloc(total);
+	xassert(buf);
+	store.read(base, total, buf);
+
+	struct route_cache_header *stored = (struct route_cache_header *)buf;
+	const uint32_t checksum = stored->checksum;
+	stored->checksum = 0;
+
+	if (memcmp(stored, &header, offsetof(struct route_cache_header, checksum)) || lib::checksum(buf, total) != checksum) {
+		warning("Cached routing tables are corrupt");
+		free(buf);
+		return 0;
+	}
+
+	const uint8_t *pos = buf + sizeof(header);
+	for (xbarid_t in = 0; in < XBAR_PORTS; in++) {
+		memcpy(router.routes[node][in], pos, nnodes);
+		pos += nnodes;
+	}
+
+	for (nodeid_t src = 0; src < nnodes; src++) {
+		memcpy(router.dist[src], pos, nnodes);
+		pos += nnodes;
+	}
+
+	free(buf);
+	return 1;
+}
+
+bool RouteCache::save(RouteStore &store)
+{
+	if (!fits())
+		return 0;
+
+	const unsigned total = sizeof(struct route_cache_header) + length();
+
+	uint8_t *buf = (uint8_t *)zalloc(total);
+	xassert(buf);
+
+	struct route_cache_header *header = (struct route_cache_header *)buf;
+	header->magic = ROUTE_CACHE_MAGIC;
+	header->version = version;
+	header->topology = topology();
+	header->node = node;
+	header->nnodes = nnodes;
+	header->length = length();
+	header->checksum = 0;
+
+	uint8_t *pos = buf + sizeof(*header);
+	for (xbarid_t in = 0; in < XBAR_PORTS; in++) {
+		memcpy(pos, router.routes[node][in], nnodes);
+		pos += nnodes;
+	}
+
+	for (nodeid_t src = 0; src < nnodes; src++) {
+		memcpy(pos, router.dist[src], nnodes);
+		pos += nnodes;
+	}
+
+	header->checksum = lib::checksum(buf, total);
+
+	// write payload first, so an interrupted update leaves a header that fails the checksum
+	program(store, buf, sizeof(*header), total);
+	program(store, buf, 0, sizeof(*header));
+
+	free(buf);
+	return 1;
+}
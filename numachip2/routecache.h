@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "router.h"
+
+#define ROUTE_CACHE_MAGIC 0x31435452 // "RTC1"
+#define ROUTE_CACHE_VERSION 1         // bump when the payload layout or route selection changes
+#define ROUTE_CACHE_PAGE  128        // writes can't cross pages
+
+struct route_cache_header {
+	uint32_t magic;
+	uint32_t version;  // ROUTE_CACHE_VERSION when saved
+	uint64_t topology; // hash of cabling and routing options
+	uint16_t node, nnodes;
+	uint32_t length;   // payload bytes following header
+	uint32_t checksum; // over header and payload, with this field zero
+} __attribute__((packed));
+
+// byte-addressed persistent storage, eg the Numachip2 SPI EEPROM
+class RouteStore {
+public:
+	// can't use pure virtual (= 0) due to link-time dependency with libstdc++
+	virtual void read(const uint16_t, const unsigned, uint8_t *) {};
+	virtual void write(const uint16_t, const unsigned, uint8_t *) {};
+};
+
+// local node's routing table slice and the distance matrix, reused while the topology is unchanged
+class RouteCache {
+	Router &router;
+	const nodeid_t node;
+	const unsigned nnodes;
+	const uint32_t version;
+	const uint16_t base;
+	const unsigned limit;
+
+	unsigned length(void) const;
+	void program(RouteStore &store, uint8_t *buf, unsigned offset, const unsigned end) const;
+public:
+	RouteCache(Router &_router, const nodeid_t _node, const unsigned _nnodes, const uint32_t _version,
+	  const uint16_t _base, const unsigned _limit);
+	uint64_t topology(void) const;
+	// the distance matrix outgrows the store above about 85 nodes
+	bool fits(void) const;
+	bool load(RouteStore &store);
+	bool save(RouteStore &store);
+};
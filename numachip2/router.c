@@ -16,14 +16,48 @@
  */
 
 #include "router.h"
+#include "verify.h"
 #include "../library/base.h"
+#include "../library/log.h"
 #include <stdio.h>
 #include <string.h>
 
 static bool debug;
-static unsigned routes_count, routes_total, routes_min = 10000, routes_max;
 
-void Router::find(const nodeid_t pos, const nodeid_t dst, const unsigned hops, const unsigned _usage, deps_t _deps, const xbarid_t last_xbarid)
+// depth-first search for a dependency path between channels
+bool Router::reaches(const unsigned from, const unsigned to)
+{
+	unsigned top = 0;
+
+	memset(visited, 0, channels * sizeof(*visited));
+	visited[from] = 1;
+	stack[top++] = from;
+
+	while (top) {
+		const unsigned ch = stack[--top];
+		if (ch == to)
+			return 1;
+
+		const xbarid_t xbarid = (ch / MAX_VCS) % XBAR_PORTS;
+		const nodeid_t node = ch / MAX_VCS / XBAR_PORTS;
+		const nodeid_t next = neigh[node][xbarid].nodeid;
+
+		for (unsigned bit = 0; bit < XBAR_PORTS * MAX_VCS; bit++) {
+			if (!(deps[ch] & (1 << bit)))
+				continue;
+
+			const unsigned succ = channel(next, bit / MAX_VCS, bit % MAX_VCS);
+			if (!visited[succ]) {
+				visited[succ] = 1;
+				stack[top++] = succ;
+			}
+		}
+	}
+
+	return 0;
+}
+
+void Router::find(const nodeid_t pos, const nodeid_t dst, const unsigned hops, const unsigned _usage, const xbarid_t last_xbarid, const uint8_t last_vc, const unsigned last)
 {
 	if (debug) {
 		for (unsigned i = 0; i < hops; i++)
@@ -33,25 +67,31 @@ void Router::find(const nodeid_t pos, const nodeid_t dst, const unsigned hops, c
 	}
 
 	// no room
-	if (hops > nnodes)
+	if (hops > nnodes || hops >= MAX_ROUTE)
 		return;
 
-	if (hops > best.hops) {
+	// once descending, only down links remain
+	const bool descending = updown && last_xbarid && !up(neigh[pos][last_xbarid].nodeid, pos);
+	const unsigned togo = descending ? downhops[pos][dst] : minhops[pos][dst];
+
+	if (hops + togo > limit) {
 		if (debug) printf(" overhops\n");
 		return;
 	}
 
-	if (_usage > best.usage) {
-		if (debug) printf(" overusage\n");
+	// even a minimal remaining path can't improve on best
+	if (best.hops != ~0U && ((hops + togo) * HOP_COST + _usage) >= (best.hops * HOP_COST + best.usage)) {
+		if (debug) printf(" overcost\n");
 		return;
 	}
 
 	// if reached goal, update best
 	if (pos == dst) {
-		if ((hops * HOP_COST + _usage) < (best.hops * HOP_COST + best.usage)) {
+		if (best.hops == ~0U || (hops * HOP_COST + _usage) < (best.hops * HOP_COST + best.usage)) {
 			memcpy(best.route, route, hops * sizeof(route[0]));
-			best.deps = _deps;
+			memcpy(best.vcs, route_vcs, hops * sizeof(route_vcs[0]));
 			best.route[hops] = 0; // route to local Numachip
+			best.vcs[hops] = 0;
 			best.hops = hops;
 			best.usage = _usage;
 		}
@@ -65,24 +105,45 @@ void Router::find(const nodeid_t pos, const nodeid_t dst, const unsigned hops, c
 
 		// if route already defined, skip alternatives
 		// FIXME: move out of loop
-		if (routes[pos][last_xbarid][dst] != XBARID_NONE && xbarid != routes[pos][last_xbarid][dst]) {
+		const bool defined = routes[pos][last_xbarid][dst] != XBARID_NONE;
+		if (defined && xbarid != routes[pos][last_xbarid][dst]) {
 //			printf("!");
 			continue;
 		}
 
-		// check if cyclic
-		if (xbarid && last_xbarid) {
-			if (_deps.table[next.nodeid][xbarid][pos][last_xbarid]) {
-				if (debug) printf(" %02u:%u already depends on %02u:%u\n", next.nodeid, xbarid, pos, last_xbarid);
+		// having arrived down a link, never go up
+		if (descending && up(pos, next.nodeid))
+			continue;
+
+		// packets may move to a higher VC at each hop, never back
+		for (uint8_t vc = last_vc; vc < nvcs; vc++) {
+			if (defined && vc != max(last_vc, vcs[pos][last_xbarid][dst]))
 				continue;
+
+			const unsigned ch = channel(pos, xbarid, vc);
+			const uint16_t bit = 1 << (xbarid * MAX_VCS + vc);
+			bool added = 0;
+
+			// check if cyclic
+			if (last != CHANNEL_NONE && !(deps[last] & bit)) {
+				if (reaches(ch, last)) {
+					if (debug) printf(" %02u:%u.%u already depends on channel %u\n", pos, xbarid, vc, last);
+					continue;
+				}
+
+				deps[last] |= bit;
+				added = 1;
 			}
 
-			_deps.table[next.nodeid][xbarid][pos][last_xbarid] = 1;
-		}
+			if (debug) printf(" xbarid=%u vc=%u next=%02u:%u \n", xbarid, vc, next.nodeid, next.xbarid);
+			route[hops] = xbarid;
+			route_vcs[hops] = vc;
+			find(next.nodeid, dst, hops + 1, _usage + usage[pos][xbarid], next.xbarid, vc, ch);
 
-		if (debug) printf(" xbarid=%u next=%02u:%u \n", xbarid, next.nodeid, next.xbarid);
-		route[hops] = xbarid;
-		find(next.nodeid, dst, hops + 1, _usage + usage[pos][xbarid], _deps, next.xbarid);
+			// drop dependency added for this candidate
+			if (added)
+				deps[last] &= ~bit;
+		}
 	}
 }
 
@@ -92,22 +153,31 @@ void Router::update(const nodeid_t src, const nodeid_t dst)
 	printf("usage %3u:", best.usage);
 #endif
 	xbarid_t xbarid = 0;
-	unsigned hop = 0;
+	uint8_t vc = 0;
+	unsigned hop = 0, last = CHANNEL_NONE;
 	nodeid_t pos = src;
 
 	while (1) {
 #ifdef DEBUG
 		printf(" %02u:%u", pos, xbarid);
 #endif
+		if (routes[pos][xbarid][dst] == XBARID_NONE)
+			vcs[pos][xbarid][dst] = best.vcs[hop];
+		vc = best.vcs[hop];
 		xbarid = routes[pos][xbarid][dst] = best.route[hop++];
 		usage[pos][xbarid]++; // model congestion at link controller send buffer
 #ifdef DEBUG
-		printf("->%u", xbarid);
+		printf("->%u.%u", xbarid, vc);
 #endif
 		if (xbarid == 0)
 			break;
 
-		xassert(hop < nnodes);
+		// record channel dependency
+		if (last != CHANNEL_NONE)
+			deps[last] |= 1 << (xbarid * MAX_VCS + vc);
+		last = channel(pos, xbarid, vc);
+
+		xassert(hop <= best.hops);
 		dest_t next = neigh[pos][xbarid];
 		pos = next.nodeid;
 		xbarid = next.xbarid;
@@ -115,9 +185,9 @@ void Router::update(const nodeid_t src, const nodeid_t dst)
 
 	// ignore local route
 	if (hop > 1) {
-		if (hop < routes_min)
+		if (hop - 1 < routes_min)
 			routes_min = hop - 1;
-		if (hop > routes_max)
+		if (hop - 1 > routes_max)
 			routes_max = hop - 1;
 
 		routes_count++;
@@ -130,32 +200,180 @@ void Router::update(const nodeid_t src, const nodeid_t dst)
 #endif
 }
 
-Router::Router(): nnodes(-1), usage(), deps(), route(), best(), dist()
+// rows of n entries for each of n nodes and their ports, in one block
+static ports_t *alloc_ports(const unsigned n, const uint8_t fill)
 {
-	memset(routes, XBARID_NONE, sizeof(routes));
-	memset(neigh, XBARID_NONE, sizeof(neigh));
+	ports_t *rows = (ports_t *)zalloc(n * sizeof(ports_t));
+	uint8_t *data = (uint8_t *)zalloc(n * XBAR_PORTS * n);
+	xassert(rows && data);
+	memset(data, fill, n * XBAR_PORTS * n);
+
+	for (unsigned node = 0; node < n; node++)
+		for (unsigned p = 0; p < XBAR_PORTS; p++)
+			rows[node][p] = &data[(node * XBAR_PORTS + p) * n];
+
+	return rows;
 }
 
-void Router::run(const unsigned _nnodes)
+static uint8_t **alloc_matrix(const unsigned n, const uint8_t fill)
 {
+	uint8_t **rows = (uint8_t **)zalloc(n * sizeof(*rows));
+	uint8_t *data = (uint8_t *)zalloc(n * n);
+	xassert(rows && data);
+	memset(data, fill, n * n);
+
+	for (unsigned node = 0; node < n; node++)
+		rows[node] = &data[node * n];
+
+	return rows;
+}
+
+Router::Router(): nnodes(0), nneigh(0), channels(0), routes_count(0), routes_total(0), routes_min(10000), routes_max(0),
+  usage(NULL), deps(NULL), route(), route_vcs(), best(), minhops(NULL), downhops(NULL), level(NULL), limit(0), updown(0), visited(NULL), stack(NULL),
+  nvcs(1), neigh(NULL), routes(NULL), vcs(NULL), dist(NULL)
+{
+}
+
+Router::~Router()
+{
+	release();
+	free(neigh);
+}
+
+void Router::release(void)
+{
+	if (routes) {
+		free(routes[0][0]);
+		free(routes);
+		free(vcs[0][0]);
+		free(vcs);
+		free(dist[0]);
+		free(dist);
+		free(minhops[0]);
+		free(minhops);
+		free(downhops[0]);
+		free(downhops);
+		free(level);
+		free(usage);
+		free(deps);
+		free(visited);
+		free(stack);
+		routes = vcs = NULL;
+	}
+}
+
+// extend adjacency list to n nodes
+void Router::grow(const unsigned n)
+{
+	if (n <= nneigh)
+		return;
+
+	neigh = (dest_t (*)[XBAR_PORTS])realloc(neigh, n * sizeof(*neigh));
+	xassert(neigh);
+	memset(&neigh[nneigh], XBARID_NONE, (n - nneigh) * sizeof(*neigh));
+	nneigh = n;
+}
+
+// record a cable; may be described from either or both ends
+void Router::connect(const nodeid_t node, const xbarid_t xbarid, const nodeid_t rnode, const xbarid_t rxbarid)
+{
+	xassert(node < MAX_NODE && rnode < MAX_NODE);
+	xassert(xbarid > 0 && xbarid < XBAR_PORTS && rxbarid > 0 && rxbarid < XBAR_PORTS);
+	grow(max(node, rnode) + 1U);
+
+	const dest_t local = neigh[node][xbarid], remote = neigh[rnode][rxbarid];
+	assertf(local.nodeid == NODE_NONE || (local.nodeid == rnode && local.xbarid == rxbarid),
+	  "Port %02u%c is already connected to %02u%c", node, 'A' + xbarid - 1, local.nodeid, 'A' + local.xbarid - 1);
+	assertf(remote.nodeid == NODE_NONE || (remote.nodeid == node && remote.xbarid == xbarid),
+	  "Port %02u%c is already connected to %02u%c", rnode, 'A' + rxbarid - 1, remote.nodeid, 'A' + remote.xbarid - 1);
+
+	neigh[node][xbarid] = {rnode, rxbarid};
+	neigh[rnode][rxbarid] = {node, xbarid};
+}
+
+// allocate tables for the actual number of nodes
+void Router::size(const unsigned _nnodes)
+{
+	xassert(_nnodes > 0 && _nnodes <= MAX_NODE);
+	if (routes && nnodes == _nnodes)
+		return;
+
+	release();
+	grow(_nnodes);
+
 	nnodes = _nnodes;
+	channels = nnodes * XBAR_PORTS * MAX_VCS;
+	routes = alloc_ports(nnodes, XBARID_NONE);
+	vcs = alloc_ports(nnodes, 0);
+	dist = alloc_matrix(nnodes, 0);
+	minhops = alloc_matrix(nnodes, 0xff);
+	downhops = alloc_matrix(nnodes, 0xff);
+	level = (uint8_t *)zalloc(nnodes);
+	usage = (unsigned (*)[XBAR_PORTS])zalloc(nnodes * sizeof(*usage));
+	deps = (uint16_t *)zalloc(channels * sizeof(*deps));
+	visited = (bool *)zalloc(channels * sizeof(*visited));
+	stack = (uint16_t *)zalloc(channels * sizeof(*stack));
+	xassert(usage && deps && visited && stack && level);
+
+	routes_count = routes_total = routes_max = 0;
+	routes_min = 10000;
+}
 
+// shortest physical paths, ignoring dependencies, which bound the search
+void Router::shortest(void)
+{
 	for (nodeid_t n = 0; n < nnodes; n++) {
-		printf("node %2u:", n);
+		minhops[n][n] = 0;
+		for (xbarid_t x = 1; x < XBAR_PORTS; x++)
+			if (neigh[n][x].nodeid != NODE_NONE)
+				minhops[n][neigh[n][x].nodeid] = 1;
+	}
 
-		for (xbarid_t x = 1; x <= 6; x++) {
-			if (neigh[n][x].xbarid == XBARID_NONE)
-				printf("    ");
-			else
-				printf(" %02u%c", neigh[n][x].nodeid, 'A' + neigh[n][x].xbarid - 1);
-		}
+	for (nodeid_t k = 0; k < nnodes; k++)
+		for (nodeid_t i = 0; i < nnodes; i++)
+			for (nodeid_t j = 0; j < nnodes; j++)
+				if (minhops[i][k] + minhops[k][j] < minhops[i][j])
+					minhops[i][j] = minhops[i][k] + minhops[k][j];
 
-		printf("\n");
+	if (!updown)
+		return;
+
+	for (nodeid_t n = 0; n < nnodes; n++)
+		level[n] = minhops[0][n];
+
+	for (nodeid_t n = 0; n < nnodes; n++) {
+		downhops[n][n] = 0;
+		for (xbarid_t x = 1; x < XBAR_PORTS; x++)
+			if (neigh[n][x].nodeid != NODE_NONE && !up(n, neigh[n][x].nodeid))
+				downhops[n][neigh[n][x].nodeid] = 1;
 	}
 
-	printf("\n");
+	for (nodeid_t k = 0; k < nnodes; k++)
+		for (nodeid_t i = 0; i < nnodes; i++)
+			for (nodeid_t j = 0; j < nnodes; j++)
+				if (downhops[i][k] + downhops[k][j] < downhops[i][j])
+					downhops[i][j] = downhops[i][k] + downhops[k][j];
+
+	// up to a common ancestor k, as up links are down links reversed, then down
+	for (nodeid_t i = 0; i < nnodes; i++) {
+		for (nodeid_t j = 0; j < nnodes; j++) {
+			unsigned hops = 0xff;
+			for (nodeid_t k = 0; k < nnodes; k++)
+				hops = min(hops, (unsigned)downhops[k][i] + downhops[k][j]);
+			minhops[i][j] = hops;
+		}
+	}
+}
+
+// towards node 0 by breadth-first level, ties broken by node ID, so every link has one direction
+bool Router::up(const nodeid_t from, const nodeid_t to) const
+{
+	return level[to] < level[from] || (level[to] == level[from] && to < from);
+}
 
-	// perform routing for all nodes; only write local tables
+// each pair's cheapest route not closing a dependency cycle with those before it; false if a pair has none
+bool Router::route_all(void)
+{
 	for (nodeid_t src = 0; src < nnodes; src++) {
 		for (nodeid_t dst = 0; dst < nnodes; dst++) {
 			best.hops = ~0U;
@@ -163,28 +381,76 @@ void Router::run(const unsigned _nnodes)
 #ifdef DEBUG
 			printf("%02u->%02u: ", src, dst);
 #endif
-			find(src, dst, 0, 0, deps, 0); // calculate optimal route
+			// deepen until a route passes the cycle check; up*/down* routes are only bounded by the route length
+			const unsigned most = updown ? min(nnodes, MAX_ROUTE - 1U) : min(minhops[src][dst] + MAX_DETOUR, MAX_ROUTE - 1);
+			for (limit = minhops[src][dst]; best.hops == ~0U && limit <= most; limit++)
+				find(src, dst, 0, 0, 0, 0, CHANNEL_NONE);
+
+			if (best.hops == ~0U)
+				return 0;
+
 			update(src, dst); // increment path usage
 			dist[src][dst] = best.hops; // used for ACPI SLIT
 		}
 	}
 
+	return 1;
+}
+
+void Router::run(const unsigned _nnodes)
+{
+	size(_nnodes);
+
+	for (nodeid_t n = 0; n < nnodes; n++) {
+		debugf(fabric, "node %2u:", n);
+
+		for (xbarid_t x = 1; x <= 6; x++) {
+			if (neigh[n][x].xbarid == XBARID_NONE)
+				debugf(fabric, "    ");
+			else
+				debugf(fabric, " %02u%c", neigh[n][x].nodeid, 'A' + neigh[n][x].xbarid - 1);
+		}
+
+		debugf(fabric, "\n");
+	}
+
+	debugf(fabric, "\n");
+	updown = 0;
+	shortest();
+
+	// routes chosen earlier can leave a pair no acyclic route, so then start over with routes that can't form cycles
+	if (!route_all()) {
+		debugf(fabric, "no acyclic route within %u extra hops; routing up*/down*\n", MAX_DETOUR);
+		release();
+		size(_nnodes);
+		updown = 1;
+		shortest();
+		assertf(route_all(), "Fabric isn't connected");
+	}
+
 	dump();
+
+#ifdef DEBUG
+	RouteVerifier *verifier = new RouteVerifier(*this, nnodes);
+	if (!verifier->run())
+		warning("Routing tables failed verification");
+	delete verifier;
+#endif
 }
 
 void Router::dump() const
 {
-	printf("usage:");
+	debugf(fabric, "usage:");
 	for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++)
-		printf(" %4c", 'A' + xbarid-1);
-	printf("\n");
+		debugf(fabric, " %4c", 'A' + xbarid-1);
+	debugf(fabric, "\n");
 
 	for (nodeid_t node = 0; node < nnodes; node++) {
-		printf("   %02u:", node);
+		debugf(fabric, "   %02u:", node);
 		for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++)
-			printf("  %3u", usage[node][xbarid]);
-		printf("\n");
+			debugf(fabric, "  %3u", usage[node][xbarid]);
+		debugf(fabric, "\n");
 	}
 
-	printf("hops: min %u, max %u, average %ue-2\n", routes_min, routes_max, routes_total * 100 / routes_count);
+	debugf(fabric, "hops: min %u, max %u, average %ue-2\n", routes_min, routes_max, routes_total * 100 / routes_count);
 }
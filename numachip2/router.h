@@ -24,36 +24,73 @@
 
 #define HOP_COST 10
 #define MAX_ROUTE (MAX_NODE / 2) // safe estimate
+#define MAX_VCS 2 // regular and escape virtual channel
+#define MAX_DETOUR 2 // extra hops tried before rerouting up*/down*
+#define CHANNEL_NONE (~0U)
 
 // NOTE: congestion is modelled at the link controller send buffer
 
-typedef struct {
-	bool table[MAX_NODE][XBAR_PORTS][MAX_NODE][XBAR_PORTS];
-} deps_t;
+// NOTE: the MC, CC and RS classes have separate buffers and credits in the SIU and LCs and
+// share one routing table, so each class has an identical channel dependency graph; RS
+// packets are always sunk, so protocol dependencies can't close a cycle across classes
+
+// NOTE: tables are sized for the actual node count, as MAX_NODE-sized arrays need over 1MB;
+// the cabling is an adjacency list grown by connect()
+
+// per-port rows indexed by destination, eg routes[node][in][dst]
+typedef uint8_t *ports_t[XBAR_PORTS];
 
 class Router {
-	unsigned nnodes;
+	unsigned nnodes, nneigh, channels;
+	unsigned routes_count, routes_total, routes_min, routes_max;
 
 	// built-up state
-	unsigned usage[MAX_NODE][XBAR_PORTS];
-	deps_t deps;
+	unsigned (*usage)[XBAR_PORTS];
+	uint16_t *deps; // channel (node, xbarid, vc) depends on bit (xbarid * MAX_VCS + vc) of the neighbour it leads to
 
 	// per-route state
 	xbarid_t route[MAX_ROUTE];
+	uint8_t route_vcs[MAX_ROUTE];
 	struct {
 		xbarid_t route[MAX_ROUTE];
+		uint8_t vcs[MAX_ROUTE];
 		unsigned hops, usage;
-		deps_t deps;
 	} best;
 
-	void find(const nodeid_t pos, const nodeid_t dst, const unsigned hops, const unsigned _usage, deps_t _deps, const xbarid_t last_xbarid);
+	uint8_t **minhops; // ignoring dependencies, or legal up*/down* hops
+	uint8_t **downhops; // over down links only
+	uint8_t *level; // hops from node 0, which orients each link up or down
+	unsigned limit;
+	bool updown; // only routes never going up after down, which can't form cycles
+
+	// cycle check state
+	bool *visited;
+	uint16_t *stack;
+
+	static unsigned channel(const nodeid_t node, const xbarid_t xbarid, const uint8_t vc)
+	{
+		return (node * XBAR_PORTS + xbarid) * MAX_VCS + vc;
+	}
+
+	void grow(const unsigned n);
+	void release(void);
+	bool reaches(const unsigned from, const unsigned to);
+	void shortest(void);
+	bool up(const nodeid_t from, const nodeid_t to) const;
+	bool route_all(void);
+	void find(const nodeid_t pos, const nodeid_t dst, const unsigned hops, const unsigned _usage, const xbarid_t last_xbarid, const uint8_t last_vc, const unsigned last);
 	void update(const nodeid_t src, const nodeid_t dst);
 public:
-	dest_t neigh[MAX_NODE][XBAR_PORTS]; 	// fabric state
-	xbarid_t routes[MAX_NODE][XBAR_PORTS][MAX_NODE]; // built-up state
-	uint8_t dist[MAX_NODE][MAX_NODE]; // used in ACPI SLIT table
+	unsigned nvcs; // virtual channels usable by routes
+	dest_t (*neigh)[XBAR_PORTS]; // fabric state
+	ports_t *routes; // built-up state
+	ports_t *vcs; // minimum outgoing VC
+	uint8_t **dist; // used in ACPI SLIT table
 
 	Router();
+	~Router();
+	void connect(const nodeid_t node, const xbarid_t xbarid, const nodeid_t rnode, const xbarid_t rxbarid);
+	void size(const unsigned _nnodes);
 	void run(const unsigned _nnodes);
 	void dump() const;
 };
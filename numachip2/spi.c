@@ -116,7 +116,7 @@ void Numachip2::spi_write(const uint16_t addr, const unsigned len, uint8_t *data
 {
 	// can only transfer 128 bytes (1 page) at a time and not cross page boundaries
 	xassert(len > 0 && len <= 128);
-	xassert((addr & ~0x7f) == ((addr + len) & ~0x7f));
+	xassert((addr & ~0x7f) == ((addr + len - 1) & ~0x7f));
 
 	spi_enable();
 
@@ -21,6 +21,8 @@
 
 #define SPI_IMAGE_INFO_BASE   0
 #define SPI_BOARD_INFO_BASE   128
+#define SPI_ROUTE_CACHE_BASE  1024
+#define SPI_ROUTE_CACHE_SIZE  (8 << 10)
 #define SPI_LOG_BASE          (16 << 20)
 #define SPI_LOG_SIZE          (16 << 20)
 
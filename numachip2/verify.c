@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "verify.h"
+#include "../library/base.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_ERRORS 8
+
+unsigned RouteVerifier::successor(const unsigned ch, const unsigned bit) const
+{
+	const xbarid_t xbarid = (ch / MAX_VCS) % XBAR_PORTS;
+	const nodeid_t node = ch / MAX_VCS / XBAR_PORTS;
+
+	return channel(router.neigh[node][xbarid].nodeid, bit / MAX_VCS, bit % MAX_VCS);
+}
+
+// each cable must be described from both ends
+bool RouteVerifier::symmetric(void)
+{
+	bool ok = 1;
+
+	for (nodeid_t node = 0; node < nnodes; node++) {
+		for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++) {
+			const dest_t next = router.neigh[node][xbarid];
+			if (next.nodeid == NODE_NONE)
+				continue;
+
+			if (next.nodeid >= nnodes || next.xbarid >= XBAR_PORTS ||
+			  router.neigh[next.nodeid][next.xbarid].nodeid != node || router.neigh[next.nodeid][next.xbarid].xbarid != xbarid) {
+				if (errors++ < MAX_ERRORS)
+					error("Link %02u:%u to %02u:%u is not symmetric", node, xbarid, next.nodeid, next.xbarid);
+				ok = 0;
+			}
+		}
+	}
+
+	return ok;
+}
+
+// follow the tables from src to dst, recording channel dependencies and link load
+bool RouteVerifier::walk(const nodeid_t src, const nodeid_t dst)
+{
+	nodeid_t pos = src;
+	xbarid_t in = 0;
+	uint8_t vc = 0;
+	unsigned hops = 0, last = CHANNEL_NONE;
+
+	while (1) {
+		const xbarid_t out = router.routes[pos][in][dst];
+		if (out == XBARID_NONE || out >= XBAR_PORTS) {
+			if (errors++ < MAX_ERRORS)
+				error("Route %02u->%02u has no entry at %02u:%u", src, dst, pos, in);
+			return 0;
+		}
+
+		vc = max(vc, router.vcs[pos][in][dst]);
+		if (vc >= MAX_VCS) {
+			if (errors++ < MAX_ERRORS)
+				error("Route %02u->%02u uses invalid VC%u at %02u:%u", src, dst, vc, pos, in);
+			return 0;
+		}
+
+		if (out == 0)
+			break;
+
+		const dest_t next = router.neigh[pos][out];
+		if (next.nodeid == NODE_NONE) {
+			if (errors++ < MAX_ERRORS)
+				error("Route %02u->%02u leaves %02u via unconnected port %u", src, dst, pos, out);
+			return 0;
+		}
+
+		// deterministic state is (node, port, vc), so a longer route must revisit one
+		if (++hops > channels) {
+			if (errors++ < MAX_ERRORS)
+				error("Route %02u->%02u loops", src, dst);
+			return 0;
+		}
+
+		const unsigned ch = channel(pos, out, vc);
+		if (last != CHANNEL_NONE)
+			succ[last] |= 1 << (out * MAX_VCS + vc);
+		last = ch;
+		load[pos][out]++;
+
+		pos = next.nodeid;
+		in = next.xbarid;
+	}
+
+	if (pos != dst) {
+		if (errors++ < MAX_ERRORS)
+			error("Route %02u->%02u is delivered at %02u", src, dst, pos);
+		return 0;
+	}
+
+	if (hops != router.dist[src][dst]) {
+		if (errors++ < MAX_ERRORS)
+			error("Route %02u->%02u takes %u hops, but distance is %u", src, dst, hops, router.dist[src][dst]);
+		return 0;
+	}
+
+	return 1;
+}
+
+// iterative Tarjan; returns strongly connected components that contain a cycle
+unsigned RouteVerifier::strongconnect(const unsigned root)
+{
+	unsigned depth = 0, found = 0;
+
+	index[root] = lowlink[root] = next_index++;
+	stack[top++] = root;
+	onstack[root] = 1;
+	calls[depth++] = root;
+	nextbit[root] = 0;
+
+	while (depth) {
+		const unsigned v = calls[depth - 1];
+
+		// visit next successor
+		while (nextbit[v] < XBAR_PORTS * MAX_VCS && !(succ[v] & (1 << nextbit[v])))
+			nextbit[v]++;
+
+		if (nextbit[v] < XBAR_PORTS * MAX_VCS) {
+			const unsigned w = successor(v, nextbit[v]++);
+
+			if (!index[w]) {
+				index[w] = lowlink[w] = next_index++;
+				stack[top++] = w;
+				onstack[w] = 1;
+				nextbit[w] = 0;
+				calls[depth++] = w;
+			} else if (onstack[w]) {
+				lowlink[v] = min(lowlink[v], index[w]);
+				if (w == v)
+					found++; // channel depends on itself
+			}
+			continue;
+		}
+
+		// all successors visited; pop component if v is its root
+		if (lowlink[v] == index[v]) {
+			unsigned size = 0, w;
+			do {
+				w = stack[--top];
+				onstack[w] = 0;
+				size++;
+			} while (w != v);
+
+			if (size > 1) {
+				if (cycles + found < MAX_ERRORS)
+					error("Channel %02u:%u.%u is part of a %u-channel dependency cycle",
+					  v / MAX_VCS / XBAR_PORTS, (v / MAX_VCS) % XBAR_PORTS, v % MAX_VCS, size);
+				found++;
+			}
+		}
+
+		depth--;
+		if (depth) {
+			const unsigned u = calls[depth - 1];
+			lowlink[u] = min(lowlink[u], lowlink[v]);
+		}
+	}
+
+	return found;
+}
+
+// links crossing between the two sides, counted once per cable
+unsigned RouteVerifier::cut(const bool *side) const
+{
+	unsigned links = 0;
+
+	for (nodeid_t node = 0; node < nnodes; node++) {
+		for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++) {
+			const dest_t next = router.neigh[node][xbarid];
+			if (next.nodeid != NODE_NONE && side[node] != side[next.nodeid] && node < next.nodeid)
+				links++;
+		}
+	}
+
+	return links;
+}
+
+// cut reduction from moving a node alone: its links to the other side less those to its own
+int RouteVerifier::gain(const bool *side, const nodeid_t node) const
+{
+	int sum = 0;
+
+	for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++) {
+		const dest_t next = router.neigh[node][xbarid];
+		if (next.nodeid != NODE_NONE && next.nodeid != node)
+			sum += side[next.nodeid] != side[node] ? 1 : -1;
+	}
+
+	return sum;
+}
+
+unsigned RouteVerifier::links(const nodeid_t a, const nodeid_t b) const
+{
+	unsigned n = 0;
+
+	for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++)
+		n += router.neigh[a][xbarid].nodeid == b;
+
+	return n;
+}
+
+// estimate bisection width by greedy pair swaps from an ID-ordered split, with Kernighan-Lin gains
+// updated around each swap, so a pass costs O(n^2 * ports) rather than recounting the cut per pair
+void RouteVerifier::bisect(void)
+{
+	bool *side = (bool *)zalloc(nnodes * sizeof(*side));
+	int *gains = (int *)zalloc(nnodes * sizeof(*gains));
+	xassert(side && gains);
+
+	for (nodeid_t node = 0; node < nnodes; node++)
+		side[node] = node >= nnodes / 2;
+
+	bisection = cut(side);
+	for (nodeid_t node = 0; node < nnodes; node++)
+		gains[node] = gain(side, node);
+
+	for (bool improved = 1; improved; ) {
+		improved = 0;
+
+		for (nodeid_t a = 0; a < nnodes; a++) {
+			for (nodeid_t b = 0; b < nnodes; b++) {
+				if (side[a] || !side[b])
+					continue;
+
+				// links between the pair stay cut, yet count in both gains
+				const int delta = gains[a] + gains[b] - 2 * (int)links(a, b);
+				if (delta <= 0)
+					continue;
+
+				side[a] = 1;
+				side[b] = 0;
+				bisection -= delta;
+				improved = 1;
+
+				// only the pair and their neighbours change
+				gains[a] = gain(side, a);
+				gains[b] = gain(side, b);
+				for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++) {
+					const nodeid_t na = router.neigh[a][xbarid].nodeid, nb = router.neigh[b][xbarid].nodeid;
+					if (na != NODE_NONE)
+						gains[na] = gain(side, na);
+					if (nb != NODE_NONE)
+						gains[nb] = gain(side, nb);
+				}
+			}
+		}
+	}
+
+	xassert(bisection == cut(side));
+
+	bisection_load = 0;
+	for (nodeid_t node = 0; node < nnodes; node++)
+		for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++)
+			if (router.neigh[node][xbarid].nodeid != NODE_NONE && side[node] != side[router.neigh[node][xbarid].nodeid])
+				bisection_load += load[node][xbarid];
+
+	free(gains);
+	free(side);
+}
+
+RouteVerifier::RouteVerifier(const Router &_router, const unsigned _nnodes):
+  router(_router), nnodes(_nnodes), channels(_nnodes * XBAR_PORTS * MAX_VCS), next_index(1), top(0),
+  errors(0), cycles(0), max_load(0), bisection(0), bisection_load(0)
+{
+	xassert(nnodes <= MAX_NODE);
+
+	succ = (uint16_t *)zalloc(channels * sizeof(*succ));
+	load = (unsigned (*)[XBAR_PORTS])zalloc(nnodes * sizeof(*load));
+	index = (uint16_t *)zalloc(channels * sizeof(*index));
+	lowlink = (uint16_t *)zalloc(channels * sizeof(*lowlink));
+	stack = (uint16_t *)zalloc(channels * sizeof(*stack));
+	calls = (uint16_t *)zalloc(channels * sizeof(*calls));
+	nextbit = (uint8_t *)zalloc(channels * sizeof(*nextbit));
+	onstack = (bool *)zalloc(channels * sizeof(*onstack));
+	xassert(succ && load && index && lowlink && stack && calls && nextbit && onstack);
+}
+
+RouteVerifier::~RouteVerifier()
+{
+	free(succ);
+	free(load);
+	free(index);
+	free(lowlink);
+	free(stack);
+	free(calls);
+	free(nextbit);
+	free(onstack);
+}
+
+bool RouteVerifier::run(void)
+{
+	if (symmetric()) {
+		for (nodeid_t src = 0; src < nnodes; src++)
+			for (nodeid_t dst = 0; dst < nnodes; dst++)
+				walk(src, dst);
+	}
+
+	for (unsigned ch = 0; ch < channels; ch++)
+		if (!index[ch])
+			cycles += strongconnect(ch);
+
+	for (nodeid_t node = 0; node < nnodes; node++)
+		for (xbarid_t xbarid = 1; xbarid < XBAR_PORTS; xbarid++)
+			max_load = max(max_load, load[node][xbarid]);
+
+	bisect();
+
+	printf("Routing verification: %u errors, %u dependency cycles, max link load %u routes, bisection %u links carrying %u routes\n",
+	  errors, cycles, max_load, bisection, bisection_load);
+
+	return !errors && !cycles;
+}
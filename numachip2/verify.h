@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "router.h"
+
+// checks routing tables using only neigh, routes, vcs and dist, so any routing engine can be verified
+class RouteVerifier {
+	const Router &router;
+	const unsigned nnodes, channels;
+
+	// channel dependency graph, in the same encoding as Router
+	uint16_t *succ;
+	unsigned (*load)[XBAR_PORTS];
+
+	// Tarjan state; index 0 is unvisited
+	uint16_t *index, *lowlink, *stack, *calls;
+	uint8_t *nextbit;
+	bool *onstack;
+	unsigned next_index, top;
+
+	static unsigned channel(const nodeid_t node, const xbarid_t xbarid, const uint8_t vc)
+	{
+		return (node * XBAR_PORTS + xbarid) * MAX_VCS + vc;
+	}
+
+	unsigned successor(const unsigned ch, const unsigned bit) const;
+	bool symmetric(void);
+	bool walk(const nodeid_t src, const nodeid_t dst);
+	unsigned strongconnect(const unsigned root);
+	unsigned cut(const bool *side) const;
+	int gain(const bool *side, const nodeid_t node) const;
+	unsigned links(const nodeid_t a, const nodeid_t b) const;
+	void bisect(void);
+public:
+	unsigned errors, cycles, max_load, bisection, bisection_load;
+
+	RouteVerifier(const Router &_router, const unsigned _nnodes);
+	~RouteVerifier();
+	bool run(void);
+};
@@ -24,8 +24,7 @@
 
 void Opteron::MmioMap10::remove(const unsigned range)
 {
-	if (options->debug.maps)
-		printf("Deleting NB MMIO range %u on %03x#%d\n", range, opteron.sci, opteron.ht);
+	debugf(maps, "Deleting NB MMIO range %u on %03x#%d\n", range, opteron.sci, opteron.ht);
 
 	xassert(range < ranges);
 
@@ -170,9 +169,8 @@ void Opteron::MmioMap15::set(const unsigned range, uint64_t base, uint64_t limit
 {
 	const bool ovw = 1;
 
-	if (options->debug.maps)
-		printf("Adding NB MMIO range %u on %03x#%x: 0x%08" PRIx64 ":0x%08" PRIx64 " to %d.%d\n",
-			range, opteron.sci, opteron.ht, base, limit, dest, link);
+	debugf(maps, "Adding NB MMIO range %u on %03x#%x: 0x%08" PRIx64 ":0x%08" PRIx64 " to %d.%d\n",
+		range, opteron.sci, opteron.ht, base, limit, dest, link);
 
 	xassert(range < ranges);
 	xassert(limit > base);
@@ -223,9 +221,8 @@ void Opteron::MmioMap10::set(unsigned range, uint64_t base, uint64_t limit, cons
 {
 	const bool ovw = 1;
 
-	if (options->debug.maps)
-		printf("Adding NB MMIO range %u on %03x#%x: 0x%08" PRIx64 ":0x%08" PRIx64 " to %d.%d\n",
-			range, opteron.sci, opteron.ht, base, limit, dest, link);
+	debugf(maps, "Adding NB MMIO range %u on %03x#%x: 0x%08" PRIx64 ":0x%08" PRIx64 " to %d.%d\n",
+		range, opteron.sci, opteron.ht, base, limit, dest, link);
 
 	xassert(range < ranges);
 	xassert(limit > base);
@@ -316,8 +313,7 @@ void Opteron::MmioMap::remove(const uint64_t base, const uint64_t limit)
 
 void Opteron::DramMap::remove(unsigned range)
 {
-	if (options->debug.maps)
-		printf("Deleting NB DRAM range %u on %03x#%x\n", range, opteron.sci, opteron.ht);
+	debugf(maps, "Deleting NB DRAM range %u on %03x#%x\n", range, opteron.sci, opteron.ht);
 
 	xassert(range < 8);
 
@@ -381,9 +377,8 @@ void Opteron::DramMap::print()
 
 void Opteron::DramMap::set(const unsigned range, const uint64_t base, const uint64_t limit, const ht_t dest)
 {
-	if (options->debug.maps)
-		printf("Adding NB DRAM range %u on %03x#%d: 0x%012" PRIx64 ":0x%012" PRIx64 " to %d\n",
-		  range, opteron.sci, opteron.ht, base, limit, dest);
+	debugf(maps, "Adding NB DRAM range %u on %03x#%d: 0x%012" PRIx64 ":0x%012" PRIx64 " to %d\n",
+	  range, opteron.sci, opteron.ht, base, limit, dest);
 
 	xassert(range < 8);
 	xassert(limit > base);
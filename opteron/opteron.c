@@ -23,6 +23,7 @@
 #include "../library/utils.h"
 #include "../platform/trampoline.h"
 #include "../platform/options.h"
+#include "../platform/dramplan.h"
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -391,18 +392,15 @@ void Opteron::init(void)
 	uint64_t dram_limit = ((uint64_t)(read32(DRAM_LIMIT) & 0x1fffff) << 27) | 0x7ffffff;
 	dram_size = dram_limit - dram_base + 1;
 
-	// if slave, subtract and disable MMIO hole
+	// if slave, subtract and disable MMIO hole; placed above 4GB, all its DRAM is then addressed linearly
 	if (!local) {
 		val = read32(DRAM_HOLE);
 		if (val & 1) {
-			dram_size -= (val & 0xff00) << (23 - 7);
+			dram_size -= dram_hoisted(val, dram_base, dram_limit);
 			write32(DRAM_HOLE, val & ~0xff81);
 		}
 	}
 
-	// round down DRAM size to 2GB to prevent holes with <2GB alignment for kernel
-	dram_size &= ~((2ULL << 30) - 1);
-
 	// set up buffer for HT tracing
 	if (options->tracing) {
 		trace_base = dram_base + dram_size - options->tracing;
@@ -551,7 +549,7 @@ void Opteron::dram_clear_wait(void)
 {
 	// poll until done indicated
 	while (read32(MCTL_SEL_LOW) & (1 << 9))
-		cpu_relax();
+		lib::relax();
 
 	clear32(MCTL_CONF_HIGH, 3 << 12); // reenable memory controller prefetch
 }
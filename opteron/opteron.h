@@ -29,10 +29,10 @@ class Opteron {
 		void print(const unsigned range);
 		void print();
 		MmioMap(Opteron &_opteron, const unsigned _ranges): opteron(_opteron), ranges(_ranges) {};
-		virtual void remove(const unsigned range);
+		virtual void remove(const unsigned) {};
 		void remove(const uint64_t base, const uint64_t limit);
-		virtual bool read(const unsigned range, uint64_t *base, uint64_t *limit, ht_t *dest, link_t *link, bool *lock) nonnull;
-		virtual void set(const unsigned range, uint64_t base, uint64_t limit, const ht_t dest, const link_t link, const bool ro=0);
+		virtual bool read(const unsigned, uint64_t *, uint64_t *, ht_t *, link_t *, bool *) nonnull {return 0;};
+		virtual void set(const unsigned, uint64_t, uint64_t, const ht_t, const link_t, const bool=0) {};
 		void add(const uint64_t base, const uint64_t limit, const ht_t dest, const link_t link);
 	};
 public:
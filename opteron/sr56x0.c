@@ -124,8 +124,7 @@ SR56x0::SR56x0(const sci_t _sci, const bool _local): sci(_sci), local(_local), w
 
 void SR56x0::limits(const uint64_t limit)
 {
-	if (options->debug.maps)
-		printf("Setting limits on %03x IOH to 0x%" PRIx64 "\n", sci, limit);
+	debugf(maps, "Setting limits on %03x IOH to 0x%" PRIx64 "\n", sci, limit);
 	xassert((limit & ((1ULL << 24) - 1)) == (1ULL << 24) - 1);
 
 	// limit to HyperTransport range
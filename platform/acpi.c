@@ -430,10 +430,9 @@ void ACPI::check(void)
 		acpi_sdt *table = (acpi_sdt *)rsdt_entries[i];
 		assert_checksum(table, table->len);
 
-		if (options->debug.acpi)
-			printf(" table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
-				table, table->sig.l, table->sig.s, table->oemid,
-				table->oemtableid, table->checksum, table->revision, table->len);
+		debugf(acpi, " table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
+			table, table->sig.l, table->sig.s, table->oemid,
+			table->oemtableid, table->checksum, table->revision, table->len);
 
 		// find the DSDT table also
 		if (table->sig.l == STR_DW_H("FACP")) {
@@ -441,10 +440,9 @@ void ACPI::check(void)
 			memcpy(&dsdt, &table->data[4], sizeof(dsdt));
 			assert_checksum(dsdt, dsdt->len);
 
-			if (options->debug.acpi)
-				printf(" table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
-					dsdt, dsdt->sig.l, dsdt->sig.s, dsdt->oemid,
-					dsdt->oemtableid, dsdt->checksum, dsdt->revision, dsdt->len);
+			debugf(acpi, " table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
+				dsdt, dsdt->sig.l, dsdt->sig.s, dsdt->oemid,
+				dsdt->oemtableid, dsdt->checksum, dsdt->revision, dsdt->len);
 
 			for (unsigned j = 0; j < 4; j++) {
 				char c = (dsdt->sig.l >> (j * 8)) & 0xff;
@@ -469,11 +467,10 @@ void ACPI::check(void)
 			memcpy(&xsdtp, &rptr->xsdt_addr, sizeof(xsdtp));
 			assert_checksum(xsdtp, xsdtp->len);
 
-			if (options->debug.acpi)
-				printf(" table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d, %d\n",
-					xsdtp, xsdtp->sig.l, xsdtp->sig.s, xsdtp->oemid,
-					xsdtp->oemtableid, xsdtp->checksum, xsdtp->revision, xsdtp->len,
-					sizeof(*xsdtp));
+			debugf(acpi, " table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d, %d\n",
+				xsdtp, xsdtp->sig.l, xsdtp->sig.s, xsdtp->oemid,
+				xsdtp->oemtableid, xsdtp->checksum, xsdtp->revision, xsdtp->len,
+				sizeof(*xsdtp));
 
 			uint64_t *xsdt_entries = (uint64_t *)&(xsdtp->data);
 
@@ -482,11 +479,10 @@ void ACPI::check(void)
 				memcpy(&table, &xsdt_entries[i], sizeof(table));
 				assert_checksum(table, table->len);
 
-				if (options->debug.acpi)
-					printf(" table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
-						table, table->sig.l, table->sig.s, table->oemid,
-						table->oemtableid, table->checksum, table->revision,
-						table->len);
+				debugf(acpi, " table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
+					table, table->sig.l, table->sig.s, table->oemid,
+					table->oemtableid, table->checksum, table->revision,
+					table->len);
 
 				// find the DSDT table also
 				if (table->sig.l == STR_DW_H("FACP")) {
@@ -494,11 +490,10 @@ void ACPI::check(void)
 					memcpy(&dsdt, &table->data[4], sizeof(dsdt));
 					assert_checksum(dsdt, dsdt->len);
 
-					if (options->debug.acpi)
-						printf(" table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
-							dsdt, dsdt->sig.l, dsdt->sig.s, dsdt->oemid,
-							dsdt->oemtableid, dsdt->checksum, dsdt->revision,
-							dsdt->len);
+					debugf(acpi, " table: %p, %08x, %.4s, %.6s, %.8s, %d, %d, %d\n",
+						dsdt, dsdt->sig.l, dsdt->sig.s, dsdt->oemid,
+						dsdt->oemtableid, dsdt->checksum, dsdt->revision,
+						dsdt->len);
 				}
 
 #ifdef UNUSED
@@ -613,15 +608,15 @@ ACPI::ACPI(void): bios_shadowed(0)
 	rsdt = find_root("RSDT");
 	xassert(rsdt);
 
-	if (options->debug.acpi)
-		printf("RSDT at %p; XSDT at %p\n", rsdt, xsdt);
+	debugf(acpi, "RSDT at %p; XSDT at %p\n", rsdt, xsdt);
 
 	printf("\n");
 
 	get_cores();
 }
 
-AcpiTable::AcpiTable(const char *name, const unsigned rev, const bool copy): payload(0), allocated(0), used(0)
+AcpiTable::AcpiTable(const char *name, const unsigned rev, lib::Arena &_arena, const bool copy):
+	arena(&_arena), payload(0), allocated(0), used(0)
 {
 	memset(&header, 0, sizeof(header));
 	memcpy(&header.sig.s, name, 4);
@@ -644,9 +639,10 @@ AcpiTable::AcpiTable(const char *name, const unsigned rev, const bool copy): pay
 void AcpiTable::extend(const unsigned len)
 {
 	if (used + len > allocated) {
-		allocated = roundup(used + len, chunk);
-		payload = (char *)realloc((void *)payload, allocated);
-		xassert(payload);
+		// doubling, so appending entry by entry is linear; in place while the table is the arena's latest allocation
+		const unsigned nallocated = max(roundup(used + len, chunk), allocated * 2);
+		payload = (char *)arena->resize(payload, allocated, nallocated);
+		allocated = nallocated;
 	}
 }
 
@@ -669,8 +665,7 @@ unsigned AcpiTable::reserve(const unsigned len)
 {
 	extend(len);
 
-	if (options->debug.acpi)
-		printf("ACPI extend by %u bytes\n", len);
+	debugf(acpi, "ACPI extend by %u bytes\n", len);
 
 	memset(payload + used, 0, len);
 
@@ -152,8 +152,10 @@ struct acpi_fadt {
 	struct GenericAddressStructure X_GPE1Block;
 } __attribute__((packed));
 
+// payload is on the caller's arena, so freed with the tables built alongside
 class AcpiTable {
 	static const unsigned chunk = 1024;
+	lib::Arena *const arena;
 	void checksum(void);
 	void extend(const unsigned len);
 public:
@@ -161,7 +163,7 @@ public:
 	char *payload;
 	unsigned allocated, used;
 
-	AcpiTable(const char *name, const unsigned rev, const bool copy = 0) nonnull;
+	AcpiTable(const char *name, const unsigned rev, lib::Arena &_arena, const bool copy = 0) nonnull;
 	void append(const char *data, const unsigned len) nonnull;
 	unsigned reserve(const unsigned len);
 	void increment64(const unsigned offset) const;
@@ -25,7 +25,7 @@
 
 #include "aml.h"
 #include "../numachip2/numachip.h"
-#ifdef SIM
+#if defined(SIM) && !defined(SIM_BOOT)
 #include "../simulation/node.h"
 #else
 #include "../node.h"
@@ -51,6 +51,8 @@
     (((x) & 0x00ff000000000000ULL) >> 40) | \
     (((x) & 0xff00000000000000ULL) >> 56))
 
+// built in two passes: measure() sizes the tree bottom-up, then emit() writes it into one buffer of that size;
+// nodes and their child lists are on the arena while building, so the tree is freed at once rather than deleted
 class Container {
 protected:
 	static const uint8_t ExtOpPrefix = 0x5b;
@@ -60,10 +62,9 @@ protected:
 	static const uint8_t QWordPrefix = 0x0e;
 	static const uint8_t BufferOp = 0x11;
 	static const uint16_t EndTag = 0x0079;
-	int offset, bufsize;
+	unsigned inner; // bytes following the PkgLength, for containers having one
 public:
 	Vector<Container *> children;
-	char *buf;
 	enum ResourceUsage {ResourceProducer, ResourceConsumer};
 	enum MinType {MinNotFixed, MinFixed};
 	enum MaxType {MaxNotFixed, MaxFixed};
@@ -74,108 +75,94 @@ public:
 	enum ResourceType {ResourceTypeMemory, ResourceTypeIO, ResourceTypeBus};
 	enum Serialisation {NotSerialised, Serialised};
 
-	Container(void): offset(0), bufsize(0), buf(NULL) {}
+	static lib::Arena *arena;
 
-	virtual ~Container(void) {
-		free(buf);
-	}
-
-	void ensure(const int need) {
-		if (offset + need <= bufsize)
-			return;
+	Container(void): inner(0), children(arena) {}
 
-		bufsize += 1024;
-		buf = (char *)realloc((void *)buf, bufsize);
-		xassert(buf);
+	static void *operator new(const size_t n) {
+		xassert(arena);
+		return arena->alloc(n);
 	}
 
-	void pack(const uint8_t val) {
-		const int need = sizeof(val);
-		ensure(need);
-		*(uint8_t *)&buf[offset] = val;
-		offset += need;
+	static void operator delete(void *) {}
+
+	static char *pack(char *out, const uint8_t val) {
+		*(uint8_t *)out = val;
+		return out + sizeof(val);
 	}
 
-	void pack(const uint16_t val) {
-		const int need = sizeof(val);
-		ensure(need);
-		*(uint16_t *)&buf[offset] = val;
-		offset += need;
+	static char *pack(char *out, const uint16_t val) {
+		memcpy(out, &val, sizeof(val));
+		return out + sizeof(val);
 	}
 
-	void pack(const uint32_t val) {
-		const int need = sizeof(val);
-		ensure(need);
-		*(uint32_t *)&buf[offset] = val;
-		offset += need;
+	static char *pack(char *out, const uint32_t val) {
+		memcpy(out, &val, sizeof(val));
+		return out + sizeof(val);
 	}
 
-	void pack(const uint64_t val) {
-		const int need = sizeof(val);
-		ensure(need);
-		*(uint64_t *)&buf[offset] = val;
-		offset += need;
+	static char *pack(char *out, const uint64_t val) {
+		memcpy(out, &val, sizeof(val));
+		return out + sizeof(val);
 	}
 
-	void pack(const char *str) {
-		const int need = strlen(str);
-		xassert(need >= 4);
-		ensure(need);
-		strncpy((char *)&buf[offset], str, need);
-		offset += strlen(str);
+	static char *pack(char *out, const char *str) {
+		const unsigned len = strlen(str);
+		xassert(len >= 4);
+		memcpy(out, str, len);
+		return out + len;
 	}
 
-	int lenlen(int l) {
-		if (l < 64)
+	// PkgLength bytes needed to encode itself and the l bytes following
+	static unsigned lenlen(const unsigned l) {
+		if (l + 1 < 64)
 			return 1;
 
-		l >>= 4;
-		int i = 1;
+		unsigned n = 2;
+		while (l + n >= 1U << (4 + 8 * (n - 1)))
+			n++;
 
-		while (l) {
-			i++;
-			l >>= 8;
-		}
-		return i;
+		xassert(n <= 4);
+		return n;
 	}
 
-	void pack_length(int l) {
-		if (l < 64) {
-			pack((uint8_t)l);
-			return;
-		}
+	static char *pack_length(char *out, const unsigned l) {
+		const unsigned n = lenlen(l);
+		const unsigned total = l + n;
 
-		unsigned char pkglen = offset;
-		/* First octet stores 4 LSBs */
-		pack((uint8_t)(l & 0xf));
-		l >>= 4;
+		if (n == 1)
+			return pack(out, (uint8_t)total);
 
-		while (l) {
-			pack((uint8_t)l);
-			l >>= 8;
-		}
+		/* First octet stores 4 LSBs and the count of additional octets in 7:6 */
+		out = pack(out, (uint8_t)(((n - 1) << 6) | (total & 0xf)));
+		for (unsigned i = 1; i < n; i++)
+			out = pack(out, (uint8_t)(total >> (4 + 8 * (i - 1))));
 
-		/* Compute and store additional octets in 7:6 of first octet */
-		uint8_t octets = offset - pkglen - 1;
-		xassert(octets < 4);
-		buf[pkglen] |= octets << 6;
+		return out;
 	}
 
-	virtual int build(void) {
-		int l = 0;
+	unsigned measure_children(void) {
+		unsigned l = 0;
 
 		for (Container **c = children.elements; c < children.limit; c++)
-			l += (*c)->build();
+			l += (*c)->measure();
 
 		return l;
 	}
 
-	void insert(void) {
-		for (Container **c = children.elements; c < children.limit; c++) {
-			ensure((*c)->offset);
-			memcpy((void *)&buf[offset], (const void *)&(*c)->buf[0], (*c)->offset);
-			offset += (*c)->offset;
-		}
+	char *emit_children(char *out) {
+		for (Container **c = children.elements; c < children.limit; c++)
+			out = (*c)->emit(out);
+
+		return out;
+	}
+
+	virtual unsigned measure(void) {
+		return measure_children();
+	}
+
+	virtual char *emit(char *out) {
+		return emit_children(out);
 	}
 };
 
@@ -196,21 +183,24 @@ public:
 		xassert(_maxa);
 	}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 0);
+		return 26;
+	}
 
-		pack((uint8_t)0x87);
-		pack((uint16_t)0x0017); /* Minimum length (23) */
-		pack((uint8_t)ResourceTypeMemory);
-		pack((uint8_t)((usage << 1) | (mint << 2) | (maxt << 3)));
-		pack((uint8_t)(access | (cache << 1))); /* Type-specific flags */
-		pack(gran);
-		pack(mina);
-		pack(maxa);
-		pack(trans);
-		pack(size);
+	char *emit(char *out) {
+		out = pack(out, (uint8_t)0x87);
+		out = pack(out, (uint16_t)0x0017); /* Minimum length (23) */
+		out = pack(out, (uint8_t)ResourceTypeMemory);
+		out = pack(out, (uint8_t)((usage << 1) | (mint << 2) | (maxt << 3)));
+		out = pack(out, (uint8_t)(access | (cache << 1))); /* Type-specific flags */
+		out = pack(out, gran);
+		out = pack(out, mina);
+		out = pack(out, maxa);
+		out = pack(out, trans);
+		out = pack(out, size);
 
-		return offset;
+		return out;
 	}
 };
 
@@ -231,21 +221,24 @@ public:
 		xassert(_maxa);
 	}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 0);
+		return 46;
+	}
 
-		pack((uint8_t)0x8a);
-		pack((uint16_t)0x002b); /* Minimum length (43) */
-		pack((uint8_t)ResourceTypeMemory);
-		pack((uint8_t)((usage << 1) | (mint << 2) | (maxt << 3)));
-		pack((uint8_t)(access | (cache << 1))); /* Type-specific flags */
-		pack(gran);
-		pack(mina);
-		pack(maxa);
-		pack(trans);
-		pack(size);
+	char *emit(char *out) {
+		out = pack(out, (uint8_t)0x8a);
+		out = pack(out, (uint16_t)0x002b); /* Minimum length (43) */
+		out = pack(out, (uint8_t)ResourceTypeMemory);
+		out = pack(out, (uint8_t)((usage << 1) | (mint << 2) | (maxt << 3)));
+		out = pack(out, (uint8_t)(access | (cache << 1))); /* Type-specific flags */
+		out = pack(out, gran);
+		out = pack(out, mina);
+		out = pack(out, maxa);
+		out = pack(out, trans);
+		out = pack(out, size);
 
-		return offset;
+		return out;
 	}
 };
 
@@ -263,21 +256,24 @@ public:
 	  usage(_usage), mint(_mint), maxt(_maxt), decode(_decode), ranget(_ranget),
 	  gran(_gran), mina(_mina), maxa(_maxa), trans(_trans), size(_size) {}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 0);
+		return 16;
+	}
 
-		pack((uint8_t)0x88);
-		pack((uint16_t)0x000d); /* Minimum length (13) */
-		pack((uint8_t)ResourceTypeIO);
-		pack((uint8_t)((decode << 1) | (mint << 2) | (maxt << 3)));
-		pack((uint8_t)ranget); /* Type-specific flags */
-		pack(gran);
-		pack(mina);
-		pack(maxa);
-		pack(trans);
-		pack(size);
+	char *emit(char *out) {
+		out = pack(out, (uint8_t)0x88);
+		out = pack(out, (uint16_t)0x000d); /* Minimum length (13) */
+		out = pack(out, (uint8_t)ResourceTypeIO);
+		out = pack(out, (uint8_t)((decode << 1) | (mint << 2) | (maxt << 3)));
+		out = pack(out, (uint8_t)ranget); /* Type-specific flags */
+		out = pack(out, gran);
+		out = pack(out, mina);
+		out = pack(out, maxa);
+		out = pack(out, trans);
+		out = pack(out, size);
 
-		return offset;
+		return out;
 	}
 };
 
@@ -295,21 +291,24 @@ public:
 	  usage(_usage), mint(_mint), maxt(_maxt), decode(_decode), ranget(_ranget),
 	  gran(_gran), mina(_mina), maxa(_maxa), trans(_trans), size(_size) {}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 0);
+		return 26;
+	}
 
-		pack((uint8_t)0x87);
-		pack((uint16_t)0x0017); /* Minimum length (23) */
-		pack((uint8_t)ResourceTypeIO);
-		pack((uint8_t)((decode << 1) | (mint << 2) | (maxt << 3)));
-		pack((uint8_t)ranget); /* Type-specific flags */
-		pack(gran);
-		pack(mina);
-		pack(maxa);
-		pack(trans);
-		pack(size);
+	char *emit(char *out) {
+		out = pack(out, (uint8_t)0x87);
+		out = pack(out, (uint16_t)0x0017); /* Minimum length (23) */
+		out = pack(out, (uint8_t)ResourceTypeIO);
+		out = pack(out, (uint8_t)((decode << 1) | (mint << 2) | (maxt << 3)));
+		out = pack(out, (uint8_t)ranget); /* Type-specific flags */
+		out = pack(out, gran);
+		out = pack(out, mina);
+		out = pack(out, maxa);
+		out = pack(out, trans);
+		out = pack(out, size);
 
-		return offset;
+		return out;
 	}
 };
 
@@ -326,36 +325,42 @@ public:
 	  usage(_usage), mint(_mint), maxt(_maxt), decode(_decode), gran(_gran),
 	  mina(_mina), maxa(_maxa), trans(_trans), size(_size) {}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 0);
+		return 16;
+	}
 
-		pack((uint8_t)0x88);
-		pack((uint16_t)0x000d); /* Minimum length (13) */
-		pack((uint8_t)ResourceTypeBus);
-		pack((uint8_t)((decode << 1) | (mint << 2) | (maxt << 3)));
-		pack((uint8_t)0); /* Type-specific flags; 0 for bus */
-		pack(gran);
-		pack(mina);
-		pack(maxa);
-		pack(trans);
-		pack(size);
+	char *emit(char *out) {
+		out = pack(out, (uint8_t)0x88);
+		out = pack(out, (uint16_t)0x000d); /* Minimum length (13) */
+		out = pack(out, (uint8_t)ResourceTypeBus);
+		out = pack(out, (uint8_t)((decode << 1) | (mint << 2) | (maxt << 3)));
+		out = pack(out, (uint8_t)0); /* Type-specific flags; 0 for bus */
+		out = pack(out, gran);
+		out = pack(out, mina);
+		out = pack(out, maxa);
+		out = pack(out, trans);
+		out = pack(out, size);
 
-		return offset;
+		return out;
 	}
 };
 
 class Package: public Container {
 public:
-	int build(void) {
-		pack(BufferOp);
-		int l = 4 + Container::build();
-		pack_length(lenlen(l) + l);
-		pack(BytePrefix);
-		pack((uint8_t)(l - 2));
-		Container::insert();
-		pack(EndTag);
+	unsigned measure(void) {
+		inner = 4 + measure_children();
+		xassert(inner - 2 <= 0xff);
+		return 1 + lenlen(inner) + inner;
+	}
 
-		return offset;
+	char *emit(char *out) {
+		out = pack(out, BufferOp);
+		out = pack_length(out, inner);
+		out = pack(out, BytePrefix);
+		out = pack(out, (uint8_t)(inner - 2));
+		out = emit_children(out);
+		return pack(out, EndTag);
 	}
 };
 
@@ -364,35 +369,41 @@ class Constant: public Container {
 public:
 	Constant(const uint64_t _val): val(_val) {}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 0);
 
-		if (val <= 1) {
-			pack((uint8_t)val);
+		if (val <= 1)
 			return 1;
-		}
+		if (val <= 0xff)
+			return 2;
+		if (val <= 0xffff)
+			return 3;
+		if (val <= 0xffffffff)
+			return 5;
+		return 9;
+	}
+
+	char *emit(char *out) {
+		if (val <= 1)
+			return pack(out, (uint8_t)val);
 
 		if (val <= 0xff) {
-			pack(BytePrefix);
-			pack((uint8_t)val);
-			return 2;
+			out = pack(out, BytePrefix);
+			return pack(out, (uint8_t)val);
 		}
 
 		if (val <= 0xffff) {
-			pack(WordPrefix);
-			pack((uint16_t)val);
-			return 3;
+			out = pack(out, WordPrefix);
+			return pack(out, (uint16_t)val);
 		}
 
 		if (val <= 0xffffffff) {
-			pack(DWordPrefix);
-			pack((uint32_t)val);
-			return 5;
+			out = pack(out, DWordPrefix);
+			return pack(out, (uint32_t)val);
 		}
 
-		pack(QWordPrefix);
-		pack(val);
-		return 9;
+		out = pack(out, QWordPrefix);
+		return pack(out, val);
 	}
 };
 
@@ -404,17 +415,19 @@ public:
 		strncpy(name, _name, sizeof(name));
 	}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() > 0);
 
-		pack(MethodOp);
-		int l = strlen(name) + 1 + Container::build();
-		pack_length(lenlen(l) + l);
-		pack(name);
-		pack((uint8_t)0); /* Field flags/number of args */
-		Container::insert();
+		inner = strlen(name) + 1 + measure_children();
+		return 1 + lenlen(inner) + inner;
+	}
 
-		return offset;
+	char *emit(char *out) {
+		out = pack(out, MethodOp);
+		out = pack_length(out, inner);
+		out = pack(out, name);
+		out = pack(out, (uint8_t)0); /* Field flags/number of args */
+		return emit_children(out);
 	}
 };
 
@@ -427,14 +440,15 @@ public:
 
 	EisaId(const uint16_t _id): id(_id) {}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 0);
+		return 5;
+	}
 
-		pack(DWordPrefix);
-		pack(EISAID);
-		pack(N16(id));
-
-		return offset;
+	char *emit(char *out) {
+		out = pack(out, DWordPrefix);
+		out = pack(out, EISAID);
+		return pack(out, N16(id));
 	}
 };
 
@@ -451,15 +465,15 @@ public:
 		strncpy(name, _name, sizeof(name));
 	}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() == 1);
+		return 1 + strlen(name) + measure_children();
+	}
 
-		pack(NameOp);
-		pack(name);
-		Container::build();
-		Container::insert();
-
-		return offset;
+	char *emit(char *out) {
+		out = pack(out, NameOp);
+		out = pack(out, name);
+		return emit_children(out);
 	}
 };
 
@@ -477,17 +491,17 @@ public:
 		strncpy(name, _name, sizeof(name));
 	}
 
-	int build(void) {
+	unsigned measure(void) {
 		xassert(children.size() < 2);
+		return 1 + (children.size() ? 0 : strlen(name)) + measure_children();
+	}
 
-		pack(ReturnOp);
+	char *emit(char *out) {
+		out = pack(out, ReturnOp);
 		if (!children.size())
-			pack(name);
+			out = pack(out, name);
 
-		Container::build();
-		Container::insert();
-
-		return offset;
+		return emit_children(out);
 	}
 };
 
@@ -502,15 +516,17 @@ public:
 		strncpy(name, _name, sizeof(name));
 	}
 
-	int build(void) {
-		pack(ExtOpPrefix);
-		pack(DeviceOp);
-		int l = Container::build() + strlen(name);
-		pack_length(lenlen(l) + l);
-		pack(name);
-		Container::insert();
+	unsigned measure(void) {
+		inner = measure_children() + strlen(name);
+		return 2 + lenlen(inner) + inner;
+	}
 
-		return offset;
+	char *emit(char *out) {
+		out = pack(out, ExtOpPrefix);
+		out = pack(out, DeviceOp);
+		out = pack_length(out, inner);
+		out = pack(out, name);
+		return emit_children(out);
 	}
 };
 
@@ -522,31 +538,44 @@ public:
 		strncpy(name, _name, sizeof(name));
 	}
 
-	int build(void) {
-		pack(ScopeOp);
-		int l = Container::build() + strnlen(name, sizeof(name));
-		pack_length(l + lenlen(l));
-		pack(name);
-		Container::insert();
-		return offset;
+	unsigned measure(void) {
+		inner = measure_children() + strnlen(name, sizeof(name));
+		return 1 + lenlen(inner) + inner;
+	}
+
+	char *emit(char *out) {
+		out = pack(out, ScopeOp);
+		out = pack_length(out, inner);
+		out = pack(out, name);
+		return emit_children(out);
 	}
 };
 
-char *remote_aml(uint32_t *len)
+lib::Arena *Container::arena;
+
+unsigned ioh_northbridge(const ht_t *hts, const unsigned n, const ht_t ioh_ht)
 {
-	Container *sb = new Scope("\\_SB_");
+	for (unsigned i = 0; i < n; i++)
+		if (hts[i] == ioh_ht)
+			return i;
 
-	unsigned numa = 0;
+	return 0;
+}
+
+char *remote_aml(uint32_t *len, const uint32_t *pxm)
+{
+	lib::Arena arena;
+	Container::arena = &arena;
+	Container *sb = new Scope("\\_SB_");
 
 	// for the master's PCI bus, add a proximity object
 	Container *rbus = new Scope("PCI0");
-	rbus->children.push_back(new Name("_PXM", new Constant(numa))); // FIXME: lookup from proximity table
+	rbus->children.push_back(new Name("_PXM", new Constant(pxm[0])));
 	sb->children.push_back(rbus);
-	numa += local_node->numachip->ht;
 
 	for (Node *const *node = &nodes[1]; node < &nodes[nnodes]; node++) {
 		char name[5];
-		snprintf(name, sizeof(name), "X%03d", node - &nodes[0]);
+		snprintf(name, sizeof(name), "X%03d", (int)(node - &nodes[0]));
 		Container *bus = new Device(name);
 
 		bus->children.push_back(new Name("_HID", new EisaId(EisaId::PNP0A08)));
@@ -555,7 +584,7 @@ char *remote_aml(uint32_t *len)
 		bus->children.push_back(new Name("_BBN", new Constant(0x00)));
 		bus->children.push_back(new Name("_SEG", new Constant(node - &nodes[0])));
 		bus->children.push_back(new Name("_ADR", new Constant(0x00)));
-		bus->children.push_back(new Name("_PXM", new Constant(numa)));
+		bus->children.push_back(new Name("_PXM", new Constant(pxm[node - &nodes[0]])));
 
 		Container *package = new Package();
 
@@ -606,10 +635,14 @@ char *remote_aml(uint32_t *len)
 		bus->children.push_back(method);
 
 		sb->children.push_back(bus);
-		numa += (*node)->numachip->ht;
 	}
 
-	*len = sb->build();
-	sb->insert();
-	return sb->buf;
+	*len = sb->measure();
+	char *buf = (char *)malloc(*len);
+	xassert(buf);
+
+	char *end = sb->emit(buf);
+	xassert(end == buf + *len);
+	Container::arena = NULL;
+	return buf;
 }
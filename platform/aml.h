@@ -19,9 +19,13 @@
 #define __DNC_AML
 
 #include <stdint.h>
+#include "../library/base.h"
 
 #define AML_MAXNODES 999
 
-char *remote_aml(uint32_t *len);
+// index of the northbridge with the IOH link among a server's, else its first, whose SRAT domain root bridges take
+unsigned ioh_northbridge(const ht_t *hts, const unsigned n, const ht_t ioh_ht);
+// pxm is each server's proximity domain in the SRAT for the northbridge its IOH hangs off
+char *remote_aml(uint32_t *len, const uint32_t *pxm);
 
 #endif
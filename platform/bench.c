@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../bootloader.h"
+#include "../library/access.h"
+#include "../library/utils.h"
+#include "../library/work.h"
+
+#define LINE 64
+
+struct bench_matrix *bench;
+
+enum bench_kind {Latency, Read, Write, Copy};
+static const char *const kind_names[] = {"latency", "read", "write", "copy"};
+
+// one core's share of a pair's buffer, and its counters
+struct bench_work {
+	enum bench_kind kind;
+	uint64_t base, bytes;
+	uint64_t cycles, lines;
+};
+
+// a full-period LCG modulo the power-of-two line count, so loads don't follow a stride the prefetchers learn
+static uint32_t chase_next(const uint32_t line, const uint32_t mask)
+{
+	return (line * 1664525 + 1013904223) & mask;
+}
+
+// on a core of the source server, with the buffer in the target's memory
+static int bench_work(void *arg)
+{
+	struct bench_work *work = (struct bench_work *)arg;
+	uint32_t lines = work->bytes / LINE, off = 0;
+	uint64_t start = 0;
+
+	lib::mem_window(work->base);
+
+	switch (work->kind) {
+	case Latency:
+		// link every line into one cycle, then follow it once round
+		lines = roundup_pow2(lines + 1, 1) / 2;
+		for (uint32_t line = 0; line < lines; line++)
+			lib::window_write64(line * LINE, chase_next(line, lines - 1) * LINE);
+
+		start = lib::rdtscll();
+		for (uint32_t i = 0; i < lines; i++)
+			off = lib::window_read64(off);
+		work->cycles = lib::rdtscll() - start;
+
+		// back at the start unless a load returned other than was stored
+		if (off)
+			return 1;
+		break;
+	case Read:
+		start = lib::rdtscll();
+		for (uint32_t line = 0; line < lines; line++)
+			(void)lib::window_read64(line * LINE);
+		work->cycles = lib::rdtscll() - start;
+		break;
+	case Write:
+		start = lib::rdtscll();
+		for (uint32_t line = 0; line < lines; line++)
+			lib::window_write64(line * LINE, line);
+		work->cycles = lib::rdtscll() - start;
+		break;
+	case Copy:
+		// first half to second; bytes read and written both count, as STREAM does
+		lines /= 2;
+		start = lib::rdtscll();
+		for (uint32_t line = 0; line < lines; line++)
+			lib::window_write64((lines + line) * LINE, lib::window_read64(line * LINE));
+		work->cycles = lib::rdtscll() - start;
+		lines *= 2;
+		break;
+	}
+
+	work->lines = lines;
+	return 0;
+}
+
+// in the upper half of each server's memory, clear of the master's low memory and the HT decode range
+uint64_t bench_buffer(const Node *node, const uint64_t bytes)
+{
+	const uint64_t base = roundup(node->dram_base + node->dram_size / 2, 1ULL << 20);
+
+	assertf(base + bytes <= node->dram_base + node->dram_size, "%s has too little memory for a %" PRIu64 " byte buffer",
+	  pr_node(node->config->id), bytes);
+	assertf(base + bytes <= Opteron::HT_BASE || base >= Opteron::HT_LIMIT,
+	  "%s buffer overlaps HT decode range", pr_node(node->config->id));
+	return base;
+}
+
+#define PROBE_BATCHES 16
+#define PROBE_READS   16  // per batch
+#define PROBE_STRIDE  4096
+
+// one core of the source server, the buffer in the target's memory
+struct probe_work {
+	uint64_t base, deadline;
+	uint64_t cycles; // median batch, per read
+};
+
+// reads with the core's caches disabled, so each goes to the target's memory
+static int probe_work(void *arg)
+{
+	struct probe_work *work = (struct probe_work *)arg;
+	uint64_t batches[PROBE_BATCHES];
+
+	lib::mem_window(work->base);
+	disable_cache();
+
+	for (unsigned b = 0; b < PROBE_BATCHES; b++) {
+		if (lib::rdtscll() > work->deadline) {
+			enable_cache();
+			return 1;
+		}
+
+		const uint64_t start = lib::rdtscll();
+		for (uint32_t r = 0; r < PROBE_READS; r++)
+			(void)lib::window_read64((b * PROBE_READS + r) * PROBE_STRIDE);
+		const uint64_t cycles = lib::rdtscll() - start;
+
+		// insertion into the sorted batches so far
+		unsigned pos = b;
+		for (; pos > 0 && batches[pos - 1] > cycles; pos--)
+			batches[pos] = batches[pos - 1];
+		batches[pos] = cycles;
+	}
+
+	enable_cache();
+	work->cycles = batches[PROBE_BATCHES / 2] / PROBE_READS;
+	return 0;
+}
+
+bool bench_latency(uint32_t *ns, const uint32_t timeout_ms)
+{
+	const uint64_t bytes = PROBE_BATCHES * PROBE_READS * PROBE_STRIDE;
+	struct probe_work *works = (struct probe_work *)zalloc(nnodes * sizeof(*works));
+	const uint64_t deadline = lib::rdtscll() + (uint64_t)timeout_ms * 1000 * Opteron::tsc_mhz;
+	bool ok = 1;
+
+	lib::critical_enter();
+
+	// as for the fabric matrix, each round's pairs use different memory controllers
+	for (unsigned r = 0; r < nnodes && ok; r++) {
+		lib::work_pool *pool = lib::work_new();
+		pool->strict = 1;
+
+		for (unsigned s = 0; s < nnodes; s++) {
+			works[s].base = bench_buffer(nodes[(s + r) % nnodes], bytes);
+			works[s].deadline = deadline;
+			lib::work_add(pool, nodes[s]->config->id, "latency probe", probe_work, &works[s]);
+		}
+
+		if (work_run(pool))
+			ok = 0;
+		lib::work_free(pool);
+
+		for (unsigned s = 0; s < nnodes && ok; s++) {
+			const unsigned d = (s + r) % nnodes;
+			ns[s * nnodes + d] = works[s].cycles * 1000 / Opteron::tsc_mhz;
+			debugf(acpi, "%03x->%03x: %" PRIu64 " cycles per uncached read\n", nodes[s]->config->id, nodes[d]->config->id, works[s].cycles);
+		}
+	}
+
+	lib::critical_leave();
+	free(works);
+	return ok;
+}
+
+static void bench_print(const char *title, uint32_t bench_entry::*field)
+{
+	printf("%s:\n     ", title);
+	for (unsigned d = 0; d < nnodes; d++)
+		printf(" %6.3x", nodes[d]->config->id);
+	printf("\n");
+
+	for (unsigned s = 0; s < nnodes; s++) {
+		printf("  %03x", nodes[s]->config->id);
+		for (unsigned d = 0; d < nnodes; d++)
+			printf(" %6u", bench->entries[s * nnodes + d].*field);
+		printf("\n");
+	}
+}
+
+// latency and bandwidth from every server's cores to every server's memory
+void bench_fabric(void)
+{
+	const unsigned cores = max(options->bench_cores, 1);
+	assertf(sizeof(*bench) + nnodes * nnodes * sizeof(bench->entries[0]) <= BENCH_SIZE, "Too many servers for the fabric matrix");
+	assertf(options->bench / cores >= 2 * LINE && options->bench / cores < (4ULL << 30), "bench=%" PRIu64 " gives unusable per-core buffers", options->bench);
+
+	bench = (struct bench_matrix *)lib::os_alloc(BENCH_SIZE, 0);
+	if (!bench) {
+		warning("No memory for the fabric matrix");
+		return;
+	}
+
+	memset(bench, 0, sizeof(*bench) + nnodes * nnodes * sizeof(bench->entries[0]));
+	bench->magic = BENCH_MAGIC;
+	bench->nnodes = nnodes;
+	bench->cores = cores;
+	bench->bytes = options->bench;
+	e820->add((uintptr_t)bench, BENCH_SIZE, E820::RESERVED);
+
+	struct bench_work *works = (struct bench_work *)zalloc(nnodes * cores * sizeof(*works));
+
+	printf("Measuring fabric with %u cores per server", cores);
+	lib::critical_enter();
+
+	for (enum bench_kind kind = Latency; kind <= Copy; kind = bench_kind(kind + 1)) {
+		const unsigned count = kind == Latency ? 1 : cores;
+
+		// in each round, every server's cores use a different server's memory, so pairs don't share a memory controller
+		for (unsigned r = 0; r < nnodes; r++) {
+			lib::work_pool *pool = lib::work_new();
+			pool->strict = 1;
+
+			for (unsigned s = 0; s < nnodes; s++) {
+				const uint64_t buffer = bench_buffer(nodes[(s + r) % nnodes], options->bench);
+
+				for (unsigned k = 0; k < count; k++) {
+					struct bench_work *work = &works[s * cores + k];
+					work->kind = kind;
+					work->bytes = (options->bench / count) & ~(LINE - 1);
+					work->base = buffer + k * work->bytes;
+					lib::work_add(pool, nodes[s]->config->id, kind_names[kind], bench_work, work);
+				}
+			}
+
+			if (work_run(pool))
+				fatal("Fabric measurement failed");
+			lib::work_free(pool);
+
+			for (unsigned s = 0; s < nnodes; s++) {
+				const unsigned d = (s + r) % nnodes;
+				struct bench_entry *entry = &bench->entries[s * nnodes + d];
+
+				for (unsigned k = 0; k < count; k++) {
+					const struct bench_work *work = &works[s * cores + k];
+					debugf(cores, "%03x->%03x core %u %s: %" PRIu64 " lines in %" PRIu64 " cycles\n",
+					  nodes[s]->config->id, nodes[d]->config->id, k, kind_names[kind], work->lines, work->cycles);
+
+					const uint32_t mbps = work->cycles ? work->lines * LINE * Opteron::tsc_mhz / work->cycles : 0;
+					switch (kind) {
+					case Latency:
+						entry->latency = work->lines ? work->cycles * 1000 / Opteron::tsc_mhz / work->lines : 0;
+						break;
+					case Read:
+						entry->read += mbps;
+						break;
+					case Write:
+						entry->write += mbps;
+						break;
+					case Copy:
+						entry->copy += mbps;
+						break;
+					}
+				}
+			}
+
+			printf(".");
+		}
+	}
+
+	lib::critical_leave();
+	free(works);
+	printf("\n");
+
+	bench_print("Fabric latency (ns), from rows' cores to columns' memory", &bench_entry::latency);
+	bench_print("Read bandwidth (MB/s)", &bench_entry::read);
+	bench_print("Write bandwidth (MB/s)", &bench_entry::write);
+	bench_print("Copy bandwidth (MB/s)", &bench_entry::copy);
+}
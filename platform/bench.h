@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// measured fabric matrix on the heap, E820-reserved for the OS, which finds it by its magic; flagged in numachip_info
+#define BENCH_SIZE  (256 << 10)
+#define BENCH_MAGIC 0x31424e46 // "FNB1"
+
+// from one server's cores to one server's memory
+struct bench_entry {
+	uint32_t latency;           // ns per dependent load
+	uint32_t read, write, copy; // MB/s, summed over the cores
+} __attribute__((packed));
+
+// rows by source server, columns by target, both in nodes[] order
+struct bench_matrix {
+	uint32_t magic;
+	uint16_t nnodes, cores; // cores per server measuring bandwidth
+	uint64_t bytes;         // buffer in each server's memory
+	struct bench_entry entries[];
+} __attribute__((packed));
+
+extern struct bench_matrix *bench; // once measured
+
+// scratch memory on the server for measurements, clear of its low memory
+uint64_t bench_buffer(const class Node *node, const uint64_t bytes);
+void bench_fabric(void);
+// uncached read latency (ns) from one core of every server to every server's memory, rows by source; false on timeout
+bool bench_latency(uint32_t *ns, const uint32_t timeout_ms);
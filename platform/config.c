@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include "../library/base.h"
+#include "../library/log.h"
 #include "../platform/os.h"
 #include "../numachip2/router.h"
 #include "../node.h"
@@ -45,8 +46,9 @@ const char *pr_node(const sci_t id)
 	return ret;
 }
 
-Config::Config(void): nnodes(1), nodes(), local_node(), master(), npartitions(), partitions()
+Config::Config(void): nalloc(0), nnodes(1), nodes(NULL), local_node(), master(), npartitions(), partitions()
 {
+	grow(1);
 	nodes[0].partition = 0;
 	nodes[0].master = 1;
 	nodes[0].id = 0;
@@ -64,6 +66,19 @@ struct Config::node *Config::find(const sci_t id)
 	fatal("Failed to find %03x in configuration", id);
 }
 
+// extend node array to n entries
+void Config::grow(const unsigned n)
+{
+	if (n <= nalloc)
+		return;
+
+	assertf(n <= MAX_NODE, "Configuration has more than %u nodes", MAX_NODE);
+	nodes = (struct node *)realloc(nodes, n * sizeof(*nodes));
+	xassert(nodes);
+	memset(&nodes[nalloc], 0, (n - nalloc) * sizeof(*nodes));
+	nalloc = n;
+}
+
 bool Config::parse_blank(const char *data)
 {
 	return *data == '#' || *data == '\n' || *data == '\0';
@@ -108,11 +123,12 @@ bool Config::parse_node(char const *data)
 	char ports[32];
 	memset(ports, 0, sizeof(ports));
 
-	int ret = sscanf(data, "suffix=%hhu mac=%s partition=%u ports=%[A-F0-9, ]", &suffix, mac, &partition, ports);
+	int ret = sscanf(data, "suffix=%hu mac=%31s partition=%u ports=%31[A-F0-9, ]", &suffix, mac, &partition, ports);
 	if (ret > 0 && ret < 3) // ports arguments needs to be optional
 		fatal("Malformed config file node line; syntax is eg 'suffix=01 mac=0025905a7810 partition=1 ports= , ,02A,03A,04A' but only %d parsed\nInput is [%s]", ret, data);
 
-	xassert(suffix > 0 && suffix < 64);
+	xassert(suffix > 0 && suffix <= MAX_NODE);
+	grow(nnodes + 1);
 	nodes[nnodes].id = suffix - 1;
 
 	// parse MAC address
@@ -150,15 +166,15 @@ bool Config::parse_node(char const *data)
 		p++; // move to next char
 
 		rnode--; // array starts from 0, not 1
-		router->neigh[nnodes][q] = {(nodeid_t)rnode, (xbarid_t)port};
-		nodes[nnodes].portmask |= 1 << (q - 1);
+		xassert(rnode < MAX_NODE);
+		grow(rnode + 1);
 
-		// setup the reverse of the connection
-		router->neigh[rnode][port] = {(nodeid_t)nnodes, (xbarid_t)q};
+		// sets up both ends of the connection
+		router->connect(nnodes, q, rnode, port);
+		nodes[nnodes].portmask |= 1 << (q - 1);
 		nodes[rnode].portmask |= 1 << (port - 1);
 
-		if (options->debug.config)
-			printf(", %02u%c-%02u%c", nnodes+1, 'A'+q-1, rnode+1, 'A'+port-1);
+		debugf(config, ", %02u%c-%02u%c", nnodes+1, 'A'+q-1, rnode+1, 'A'+port-1);
 	}
 
 	nodes[nnodes].partition = partition - 1; // starts from 1
@@ -183,7 +199,7 @@ void Config::parse(const char *pos)
 	}
 }
 
-Config::Config(const char *filename): nnodes(0), nodes(), local_node()
+Config::Config(const char *filename): nalloc(0), nnodes(0), nodes(NULL), local_node()
 {
 	size_t len;
 	printf("Config %s", filename);
@@ -209,8 +225,7 @@ Config::Config(const char *filename): nnodes(0), nodes(), local_node()
 	// find local MAC address
 	for (unsigned i = 0; i < nnodes; i++) {
 		if (!memcmp(os->mac, nodes[i].mac, sizeof(os->mac))) {
-			if (options->debug.config)
-				printf("MAC matches node %u", i);
+			debugf(config, "MAC matches node %u", i);
 			local_node = &nodes[i];
 			break;
 		}
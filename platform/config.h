@@ -36,7 +36,10 @@ public:
 		bool monitor;
 	};
 private:
+	unsigned nalloc;
+
 	struct node *find(const sci_t id) nonnull;
+	void grow(const unsigned n);
 	bool parse_blank(const char *data);
 	bool parse_prefix(const char *data);
 	bool parse_partition(const char *data);
@@ -45,7 +48,7 @@ private:
 public:
 	char prefix[16];
 	unsigned nnodes;
-	struct node nodes[MAX_NODE];
+	struct node *nodes; // grown as node lines and cables are parsed
 	struct node *local_node, *master;
 
 	unsigned npartitions;
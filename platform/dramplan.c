@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "dramplan.h"
+#include "../library/base.h"
+
+uint64_t dram_hoisted(const uint32_t hole, const uint64_t base, const uint64_t limit)
+{
+	// the hole offset also includes the northbridge's base, so use the hole base
+	if (!(hole & 1) || base >= (1ULL << 32) || limit < (1ULL << 32))
+		return 0;
+
+	return (1ULL << 32) - max((uint64_t)(hole & 0xff000000), base);
+}
+
+// reduce the largest northbridges to a common level, so the server totals its target
+static void dram_plan_trim(const struct dram_plan *plan, struct dram_plan_server *server, const uint64_t target)
+{
+	const uint64_t g = plan->map_granule;
+	unsigned order[PLAN_NBS];
+	uint64_t total = 0;
+
+	// by decreasing size
+	for (unsigned i = 0; i < server->nbs; i++) {
+		unsigned j = i;
+		for (; j > 0 && server->nb_size[order[j - 1]] < server->nb_size[i]; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+		total += server->nb_size[i];
+	}
+
+	if (total <= target)
+		return;
+
+	// the fewest largest northbridges to cut to a level no lower than the next largest
+	uint64_t rest = total;
+	for (unsigned k = 1; k <= server->nbs; k++) {
+		rest -= server->nb_size[order[k - 1]];
+		const uint64_t next = k < server->nbs ? server->nb_size[order[k]] : 0;
+
+		if (rest > target || target - rest < k * next)
+			continue;
+
+		// whole granules over the level go to the largest
+		const uint64_t level = (target - rest) / (k * g) * g;
+		unsigned extra = (target - rest - k * level) / g;
+
+		for (unsigned i = 0; i < k; i++)
+			server->nb_size[order[i]] = level + (i < extra ? g : 0);
+		return;
+	}
+
+	xassert(0);
+}
+
+void plan_dram(struct dram_plan *plan, struct dram_plan_server *servers, const unsigned nservers)
+{
+	xassert(plan->map_granule && !(plan->align % plan->map_granule) && !(plan->att_granule % plan->align));
+
+	plan->top = 0;
+	plan->usable = plan->lost_map = plan->lost_align = plan->lost_limit = plan->padding = 0;
+
+	for (struct dram_plan_server *server = servers; server < &servers[nservers]; server++) {
+		xassert(server->nbs <= PLAN_NBS && server->hole < server->detected[0]);
+		uint64_t total = 0, detected = 0;
+
+		// northbridge maps have limited granularity
+		for (unsigned i = 0; i < server->nbs; i++) {
+			server->nb_size[i] = server->detected[i] & ~(plan->map_granule - 1);
+			detected += server->detected[i];
+			total += server->nb_size[i];
+		}
+
+		// the limit, then the alignment, are taken as whole granules from the largest northbridges
+		const uint64_t limited = min(total, server->limit & ~(plan->map_granule - 1));
+		server->size = limited & ~(plan->align - 1);
+		server->lost_map = detected - total;
+		server->lost_limit = total - limited;
+		server->lost_align = limited - server->size;
+		dram_plan_trim(plan, server, server->size);
+
+		// move above the HT decode range when overlapping it, ending the previous server there
+		uint64_t base = plan->top;
+		if (base < plan->hole_limit && base + server->size > plan->hole_base) {
+			plan->padding += plan->hole_limit - plan->top;
+			if (server > servers)
+				(server - 1)->end = plan->hole_limit - 1;
+			base = plan->hole_limit;
+		}
+
+		server->base = base;
+		for (unsigned i = 0; i < server->nbs; i++) {
+			server->nb_base[i] = base;
+			base += server->nb_size[i];
+		}
+
+		// the ATT routes whole granules, so the next server starts on one
+		server->end = roundup(base, plan->att_granule) - 1;
+		plan->padding += server->end + 1 - base;
+		plan->top = server->end + 1;
+
+		plan->usable += server->size - server->hole;
+		plan->lost_map += server->lost_map;
+		plan->lost_limit += server->lost_limit;
+		plan->lost_align += server->lost_align;
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define PLAN_NBS 7 // northbridges per server, as Node::opterons
+
+// one server's memory as detected, then as placed
+struct dram_plan_server {
+	unsigned nbs;
+	uint64_t detected[PLAN_NBS]; // per northbridge
+	uint64_t limit;          // usable by the server, from MTag coverage or memlimit
+	uint64_t hole;           // in the sizes, but below 4GB under the MMIO hole, so holding no DRAM
+
+	uint64_t nb_base[PLAN_NBS], nb_size[PLAN_NBS];
+	uint64_t base, size;                       // memory used, contiguous from base
+	uint64_t end;                              // inclusive, padded to the next server or the HT decode range
+	uint64_t lost_map, lost_align, lost_limit; // memory dropped to each constraint
+};
+
+struct dram_plan {
+	uint64_t map_granule;           // northbridge DRAM base and limit granularity
+	uint64_t align;                 // servers' memory ends so aligned, so holes in the map suit the kernel
+	uint64_t att_granule;           // servers' ranges start so aligned
+	uint64_t hole_base, hole_limit; // HT decode range, never holding memory
+
+	uint64_t top;                                      // end of the last server's range
+	uint64_t usable, lost_map, lost_align, lost_limit; // over all servers, excluding MMIO holes
+	uint64_t padding;                                  // address space without memory, between servers
+};
+
+// DRAM hoisted from under the MMIO hole to above 4GB, by the northbridge spanning 4GB with the DRAM hole register given
+uint64_t dram_hoisted(const uint32_t hole, const uint64_t base, const uint64_t limit);
+// place servers in order from address 0, keeping the most memory the constraints allow
+void plan_dram(struct dram_plan *plan, struct dram_plan_server *servers, const unsigned nservers);
@@ -15,6 +15,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -22,6 +23,7 @@
 #include "e820.h"
 #include "trampoline.h"
 #include "../library/base.h"
+#include "../library/access.h"
 #include "../library/utils.h"
 #include "../bootloader.h"
 
@@ -39,7 +41,7 @@ void E820::dump(void)
 	uint64_t last_base = map->base, last_length = map->length;
 
 	for (unsigned i = 0; i < *used; i++) {
-		printf(" %011" PRIx64 ":%011" PRIx64 " (%011" PRIx64 ") %s\n",
+		debugf(e820, " %011" PRIx64 ":%011" PRIx64 " (%011" PRIx64 ") %s\n",
 		  map[i].base, map[i].base + map[i].length, map[i].length, names[map[i].type]);
 
 		if (i) {
@@ -83,102 +85,54 @@ struct e820entry *E820::position(const uint64_t addr)
 	return &map[i];
 }
 
-void E820::insert(struct e820entry *pos)
+void E820::queue(const uint64_t base, const uint64_t length, const uint32_t type)
 {
-	if (options->debug.e820 > 1)
-		printf(", inserting");
+	debugf(e820, "Adding e820 %011" PRIx64 ":%011" PRIx64 " (%011" PRIx64 ") %s\n", base, base + length, length, names[type]);
 
-	int n = *used - (pos - map);
-	if (n > 0)
-		memmove(pos + 1, pos, sizeof(*pos) * n);
-
-	*used += 1;
-	xassert(*used < E820_MAP_MAX);
-}
-
-void E820::remove(struct e820entry *start, struct e820entry *end)
-{
-	const struct e820entry *last = map + *used;
-	memmove(start, end, (size_t)last - (size_t)end);
-	*used -= end - start;
-}
+	xassert(base < (base + length));
 
-bool E820::overlap(const uint64_t a1, const uint64_t a2, const uint64_t b1, const uint64_t b2) const
-{
-	if (a2 > b1 && a1 < b2)
-		return 1;
-	if (a1 <= b1 && a2 >= b2)
-		return 1;
-	if (a1 >= b1 && a2 <= b2)
-		return 1;
+	if (nbatch == batch_size) {
+		batch_size = batch_size ? batch_size * 2 : 64;
+		batch = (struct e820batch *)realloc(batch, batch_size * sizeof(*batch));
+		xassert(batch);
+	}
 
-	return 0;
+	struct e820batch *entry = &batch[nbatch++];
+	entry->base = base;
+	entry->end = base + length;
+	entry->type = type;
 }
 
-void E820::add(const uint64_t base, const uint64_t length, const uint32_t type)
+void E820::commit(void)
 {
-	if (options->debug.e820)
-		printf("Adding e820 %011" PRIx64 ":%011" PRIx64 " (%011" PRIx64 ") %s\n", base, base + length, length, names[type]);
+	if (!nbatch)
+		return;
 
-	xassert(base < (base + length));
+	// the current map first, so queued adds override it
+	struct e820batch *all = (struct e820batch *)malloc((*used + nbatch) * sizeof(*all));
+	xassert(all);
 
-	struct e820entry *last = map + *used;
-	struct e820entry *spos = position(base);
-
-	// if valid entries
-	if (last > map && spos < last) {
-		// split head
-		if (overlap(base, base + length, spos->base, spos->base + spos->length) && base != spos->base) {
-			insert(spos);
-			spos++;
-			last++;
-			spos->base = base;
-			spos->length = (spos-1)->base + (spos-1)->length - base;
-			spos->type = (spos-1)->type;
-			(spos-1)->length = base - (spos-1)->base;
-		}
+	for (unsigned i = 0; i < *used; i++) {
+		all[i].base = map[i].base;
+		all[i].end = map[i].base + map[i].length;
+		all[i].type = map[i].type;
+		all[i].seq = i;
 	}
 
-	struct e820entry *epos = position(base + length);
-
-	// if valid entries
-	if (last > map && epos < last) {
-		// split tail
-		if (overlap(base, base + length, epos->base, epos->base + epos->length) && base + length != epos->base + epos->length) {
-			epos++;
-			insert(epos);
-			last++;
-			epos->type = (epos-1)->type;
-			epos->base = base + length;
-			epos->length = (epos-1)->base + (epos-1)->length - epos->base;
-			(epos-1)->length = base + length - (epos-1)->base;
-		}
+	for (unsigned i = 0; i < nbatch; i++) {
+		all[*used + i] = batch[i];
+		all[*used + i].seq = *used + i;
 	}
 
-	// delete all covered entries
-	remove(spos, epos);
-
-	// insert new entry
-	insert(spos);
-	spos->base = base;
-	spos->length = length;
-	spos->type = type;
-
-	// merge adjacent entries of the same type
-	unsigned pos = *used - 1;
-	while (pos > 0) {
-		struct e820entry *cur = map + pos;
-		struct e820entry *bef = cur - 1;
-
-		if (bef->base + bef->length == cur->base && bef->type == cur->type) {
-			cur->length += bef->length;
-			cur->base = bef->base;
-			remove(bef, cur);
-			continue;
-		}
+	*used = e820_resolve(map, E820_MAP_MAX / sizeof(*map), all, *used + nbatch);
+	nbatch = 0;
+	free(all);
+}
 
-		pos--;
-	}
+void E820::add(const uint64_t base, const uint64_t length, const uint32_t type)
+{
+	queue(base, length, type);
+	commit();
 }
 
 uint64_t E820::expand(const uint64_t type, const uint64_t size)
@@ -204,21 +158,19 @@ uint64_t E820::expand(const uint64_t type, const uint64_t size)
 
 	fatal("Insufficient space to expand %s region by %" PRIu64 " bytes", names[type], size);
 out:
-	if (options->debug.e820)
-		printf("Expanding: ");
+	debugf(e820, "Expanding: ");
 	add(base, size, type);
 	return base;
 }
 
-E820::E820(void): test_errors(0)
+E820::E820(void): test_errors(0), batch(NULL), nbatch(0), batch_size(0)
 {
 	// setup relocated area
 	uint32_t relocate_size = roundup(&asm_relocate_end - &asm_relocate_start, 1024);
 	// see http://groups.google.com/group/comp.lang.asm.x86/msg/9b848f2359f78cdf
 	uint32_t tom_lower = *((uint16_t *)0x413) << 10;
 	asm_relocated = (char *)((tom_lower - relocate_size) & ~0xfffUL);
-	if (options->debug.e820)
-		printf("Trampoline at 0x%p:0x%p\n", asm_relocated, asm_relocated + relocate_size);
+	debugf(e820, "Trampoline at 0x%p:0x%p\n", asm_relocated, asm_relocated + relocate_size);
 
 	// copy trampoline data
 	memcpy(asm_relocated, &asm_relocate_start, relocate_size);
@@ -234,13 +186,12 @@ E820::E820(void): test_errors(0)
 	bool last;
 	do {
 		last = os->memmap_entry(&base, &length, &type);
-		add(base, length, type);
+		queue(base, length, type);
 	} while (last);
+	commit();
 
-	if (options->debug.e820) {
-		printf("BIOS-provided e820 map:\n");
-		dump();
-	}
+	debugf(e820, "BIOS-provided e820 map:\n");
+	dump();
 
 	add((uint64_t)asm_relocated, relocate_size, RESERVED);
 
@@ -275,114 +226,245 @@ void E820::test_address(const uint64_t addr, const uint64_t val)
 	}
 }
 
-void E820::test_location(const uint64_t addr, const test_state state)
+// slices stay within a latency chunk, and within the 32-bit window offset
+#define TEST_SLICE (1ULL << 30)
+#define TEST_CHUNK (16ULL << 30)
+// accesses per dispatch, so even remote slices finish well inside the work watchdog's second
+#define TEST_ACCESSES (1 << 18)
+
+enum test_state {Seed, Test, Rezero};
+static const char *const test_names[] = {"seed", "test", "rezero"};
+
+// read by the items while they run
+static uint64_t test_stride;
+static bool test_latency;
+
+// part of one server's memory, swept by one of its cores
+struct test_slice {
+	uint64_t base, bytes;
+	uint64_t done; // swept in this state, over however many dispatches
+	unsigned node; // index in nodes[]
+	enum test_state state;
+	uint64_t errors, addr, val; // and the first mismatch
+	uint64_t cycles;            // over the latency samples
+	uint32_t samples, min, max;
+};
+
+static int test_slice(void *arg)
 {
-	// only do read under 4GB
-	if (addr < (4ULL << 32)) {
-		(void)lib::mem_read64(addr);
-		return;
+	struct test_slice *slice = (struct test_slice *)arg;
+	const bool sample = test_latency && slice->state == Test;
+
+	const uint64_t end = min(slice->bytes, slice->done + TEST_ACCESSES * test_stride);
+	lib::mem_window(slice->base);
+
+	for (uint64_t off = slice->done; off < end; off += test_stride) {
+		const uint64_t addr = slice->base + off;
+		uint64_t val;
+
+		if (sample) {
+			const uint64_t start = lib::rdtscll();
+			val = lib::window_read64(off);
+			const uint32_t cycles = lib::rdtscll() - start;
+
+			slice->cycles += cycles;
+			slice->samples++;
+			slice->min = min(slice->min, cycles);
+			slice->max = max(slice->max, cycles);
+		} else
+			val = lib::window_read64(off);
+
+		// memory was zeroed earlier, then is seeded with the address hash and re-zeroed
+		if (val != (slice->state == Test ? lib::hash64(addr) : 0) && !slice->errors++) {
+			slice->addr = addr;
+			slice->val = val;
+		}
+
+		if (slice->state == Seed)
+			lib::window_write64(off, lib::hash64(addr));
+		else if (slice->state == Test)
+			lib::window_write64(off, 0);
 	}
 
-	// prevent access to HT decode range
-	if (addr >= Opteron::HT_BASE && addr < Opteron::HT_LIMIT)
-		return;
+	slice->done = end;
+	return 0;
+}
 
-	uint64_t hash, val;
+// split a usable range into slices on the servers owning it
+static void test_split(uint64_t start, const uint64_t end, struct test_slice **slices, unsigned *nslices)
+{
+	// memory on the first northbridge is actively used
+	start = roundup(max(start, 4ULL << 30), 8);
 
-	switch (state) {
-	case Seed:
-		// memory was zeroed ealier; verify
-		val = lib::mem_read64(addr);
-		if (val != 0) {
-			printf("address 0x%" PRIx64 " was 0x%016" PRIx64 " but should have been 0 (seed)\n", addr, val);
-			test_errors++;
+	while (start < end) {
+		// skip the HT decode range
+		if (start >= Opteron::HT_BASE && start < Opteron::HT_LIMIT) {
+			start = Opteron::HT_LIMIT;
+			continue;
 		}
 
-		lib::mem_write64(addr, lib::hash64(addr));
-		break;
-	case Test:
-		val = lib::mem_read64(addr);
-		hash = lib::hash64(addr);
-		if (val != hash) {
-			printf("address 0x%" PRIx64 " was 0x%016" PRIx64 " but should have been 0x%016" PRIx64 " (seed)\n", addr, val, hash);
-			test_errors++;
+		unsigned n = 0;
+		while (n < nnodes && (start < nodes[n]->dram_base || start > nodes[n]->dram_end))
+			n++;
+
+		uint64_t next = min(end, (start & ~(TEST_SLICE - 1)) + TEST_SLICE);
+		if (start < Opteron::HT_BASE)
+			next = min(next, Opteron::HT_BASE);
+
+		if (n == nnodes) {
+			warning("Usable memory at 0x%" PRIx64 " isn't on any server", start);
+			start = next;
+			continue;
 		}
 
-		// re-zero memory
-		lib::mem_write64(addr, 0);
-		break;
-	case Rezero:
-		// verify zeroing
-		val = lib::mem_read64(addr);
-		if (val != 0) {
-			printf("address 0x%" PRIx64 " was 0x%016" PRIx64 " but should have been 0 (rezero)\n", addr, val);
-			test_errors++;
+		next = min(next, nodes[n]->dram_end + 1);
+		if (!(*nslices & (*nslices - 1))) {
+			*slices = (struct test_slice *)realloc(*slices, max(*nslices * 2, 1U) * sizeof(**slices));
+			xassert(*slices);
 		}
-		break;
+
+		struct test_slice *slice = &(*slices)[(*nslices)++];
+		memset(slice, 0, sizeof(*slice));
+		slice->base = start;
+		slice->bytes = next - start;
+		slice->node = n;
+		start = next;
 	}
 }
 
-void E820::test_range(const uint64_t start, const uint64_t end, const test_state state)
+// read latency per chunk, showing slow DIMMs or memory decoded to the wrong server
+static void test_latencies(const struct test_slice *slices, const unsigned nslices)
 {
-	// memory on the first northbridge is actively used
-	if (start < (4ULL << 30))
-		return;
+	struct chunk {
+		uint64_t cycles;
+		uint32_t samples, min, max;
+		unsigned node;
+	};
+
+	const unsigned nchunks = (slices[nslices - 1].base + slices[nslices - 1].bytes - 1) / TEST_CHUNK + 1;
+	struct chunk *chunks = (struct chunk *)zalloc(nchunks * sizeof(*chunks));
+	uint32_t *fastest = (uint32_t *)zalloc(nnodes * sizeof(*fastest));
+
+	for (const struct test_slice *slice = slices; slice < &slices[nslices]; slice++) {
+		struct chunk *chunk = &chunks[slice->base / TEST_CHUNK];
+		if (!slice->samples)
+			continue;
 
-	const unsigned STEP_MIN = 64, STEP_MAX = 4 << 20;
-	uint64_t pos = start;
-	const uint64_t mid = start + (end - start) / 2;
-	uint64_t step = STEP_MIN;
-
-	if (options->debug.e820)
-		printf(" [");
-	while (pos < mid) {
-		test_location(pos, state);
-		pos = (pos + step) & ~7;
-		step = min(step << 1, STEP_MAX);
+		chunk->min = chunk->samples ? min(chunk->min, slice->min) : slice->min;
+		chunk->max = max(chunk->max, slice->max);
+		chunk->cycles += slice->cycles;
+		chunk->samples += slice->samples;
+		chunk->node = slice->node;
 	}
 
-	while (pos < end) {
-		test_location(pos, state);
-		step = min((end - pos) / 2, STEP_MAX);
-		pos += max(step, STEP_MIN) & ~7;
+	for (struct chunk *chunk = chunks; chunk < &chunks[nchunks]; chunk++) {
+		if (!chunk->samples)
+			continue;
+
+		const uint32_t avg = chunk->cycles / chunk->samples;
+		if (!fastest[chunk->node] || avg < fastest[chunk->node])
+			fastest[chunk->node] = avg;
+	}
+
+	printf("Read latency by %lluGB chunk (ns):\n", TEST_CHUNK >> 30);
+	for (struct chunk *chunk = chunks; chunk < &chunks[nchunks]; chunk++) {
+		if (!chunk->samples)
+			continue;
+
+		const uint32_t avg = chunk->cycles / chunk->samples;
+		printf("  %011llx %s: avg %u, min %u, max %u over %u reads%s\n", (chunk - chunks) * TEST_CHUNK,
+		  pr_node(nodes[chunk->node]->config->id), avg * 1000 / Opteron::tsc_mhz, chunk->min * 1000 / Opteron::tsc_mhz,
+		  chunk->max * 1000 / Opteron::tsc_mhz, chunk->samples, avg > fastest[chunk->node] * 3 / 2 ? " (slow)" : "");
 	}
-	if (options->debug.e820)
-		printf("accessible]");
+
+	free(fastest);
+	free(chunks);
 }
 
 void E820::test(void)
 {
 	printf("Testing e820 handler and access");
 
-	// read existing E820 entries
+	// usable ranges as the OS reads them through the int15h handler
 	uint64_t base, length, type;
+	struct test_slice *slices = NULL;
+	unsigned nslices = 0;
+	bool left;
+
 	os->memmap_start();
+	do {
+		left = os->memmap_entry(&base, &length, &type);
+
+		debugf(e820, "\n%011" PRIx64 ":%011" PRIx64 " (%011" PRIx64 ") %s", base, base + length, length, names[type]);
+
+		if (type == RAM)
+			test_split(base, base + length, &slices, &nslices);
+	} while (left);
 
-	uint64_t last = 0;
+	if (!nslices) {
+		printf("; no memory to test\n");
+		return;
+	}
+
+	test_stride = max(roundup(options->memtest_stride, 8), 8ULL);
+	test_latency = options->memtest_latency;
+	test_errors = 0;
+	uint64_t last = lib::rdtscll();
+	lib::critical_enter();
+
+	// each phase completes on every server before the next checks it
+	for (test_state state = Seed; state <= Rezero; state = test_state(state + 1)) {
+		for (struct test_slice *slice = slices; slice < &slices[nslices]; slice++) {
+			slice->state = state;
+			slice->done = 0;
+			slice->errors = 0;
+			if (state == Test)
+				slice->min = ~0U;
+		}
 
-	for (test_state phase = Seed; phase <= Rezero; phase = test_state(phase + 1)) {
-		bool left;
-		test_errors = 0;
+		for (bool left = 1; left;) {
+			lib::work_pool *pool = lib::work_new();
+			pool->strict = 1;
 
-		do {
-			left = os->memmap_entry(&base, &length, &type);
+			for (struct test_slice *slice = slices; slice < &slices[nslices]; slice++)
+				if (slice->done < slice->bytes)
+					lib::work_add(pool, nodes[slice->node]->config->id, test_names[state], test_slice, slice);
 
-			if (options->debug.e820)
-				printf("\n%011" PRIx64 ":%011" PRIx64 " (%011" PRIx64 ") %s", base, base + length, length, names[type]);
+			if (work_run(pool))
+				fatal("Memory test failed to run");
+			lib::work_free(pool);
 
-			if (type == RAM)
-				test_range(base, base + length, phase);
+			left = 0;
+			for (const struct test_slice *slice = slices; slice < &slices[nslices]; slice++)
+				left |= slice->done < slice->bytes;
 
 			// check every ~4s
-			uint64_t now = lib::rdtscll();
-			if (now - last > 1e10) {
+			const uint64_t now = lib::rdtscll();
+			if (now - last > (uint64_t)4e6 * Opteron::tsc_mhz) {
 				check();
 				last = now;
 			}
-		} while (left);
+		}
+
+		for (const struct test_slice *slice = slices; slice < &slices[nslices]; slice++) {
+			if (!slice->errors)
+				continue;
+
+			warning("%" PRIu64 " errors in %s of 0x%" PRIx64 ":0x%" PRIx64 "; first 0x%" PRIx64 " was 0x%016" PRIx64,
+			  slice->errors, test_names[state], slice->base, slice->base + slice->bytes, slice->addr, slice->val);
+			test_errors += slice->errors;
+		}
+
+		printf(".");
 	}
 
+	lib::critical_leave();
 	printf("\n");
+
+	if (test_latency)
+		test_latencies(slices, nslices);
+
+	free(slices);
 	if (test_errors)
 		warning("%" PRIu64 " errors", test_errors);
 }
@@ -28,21 +28,27 @@ struct e820entry {
 	uint32_t type;
 } __attribute__((packed));
 
+// an add resolved with others in one sweep; where adds overlap, the latest wins
+struct e820batch {
+	uint64_t base, end;
+	uint32_t type;
+	uint32_t seq; // order added
+};
+
+// sorts the batch, then writes the resolved map with adjacent entries of the same type merged; returns entries written
+unsigned e820_resolve(struct e820entry *map, const unsigned max, struct e820batch *batch, const unsigned n);
+
 class E820 {
 private:
-	enum test_state {Seed, Test, Rezero};
 	uint64_t test_errors;
 	struct e820entry *map;
 	uint16_t *used;
+	struct e820batch *batch; // queued adds
+	unsigned nbatch, batch_size;
 	static const char *names[10];
 	static const uint64_t PATTERN = 0xa0a1a2a3a4a5a6a7ULL;
 
-	void insert(struct e820entry *pos) nonnull;
-	void remove(struct e820entry *start, struct e820entry *end) nonnull;
-	bool overlap(const uint64_t a1, const uint64_t a2, const uint64_t b1, const uint64_t b2) const;
 	void test_address(const uint64_t addr, const uint64_t val);
-	void test_location(const uint64_t addr, const test_state state);
-	void test_range(const uint64_t start, const uint64_t end, const test_state state);
 public:
 	static const uint64_t RAM = 1;
 	static const uint64_t RESERVED = 2;
@@ -54,6 +60,9 @@ public:
 	E820(void);
 	bool exists(const uint64_t base, const uint64_t length) const;
 	void dump(void);
+	// adds are queued, then resolved together by commit, which the map must have before it's read
+	void queue(const uint64_t base, const uint64_t length, const uint32_t type);
+	void commit(void);
 	void add(const uint64_t base, const uint64_t length, const uint32_t type);
 	uint64_t expand(const uint64_t type, const uint64_t size);
 	uint64_t memlimit(void);
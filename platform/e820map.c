@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "e820.h"
+
+static int by_base(const void *a, const void *b)
+{
+	const struct e820batch *x = (const struct e820batch *)a, *y = (const struct e820batch *)b;
+
+	if (x->base != y->base)
+		return x->base < y->base ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+// max-heap of the batch indices covering the sweep position, by when added
+static void heap_push(const struct e820batch *batch, unsigned *heap, unsigned *nheap, const unsigned index)
+{
+	unsigned pos = (*nheap)++;
+
+	for (; pos && batch[heap[(pos - 1) / 2]].seq < batch[index].seq; pos = (pos - 1) / 2)
+		heap[pos] = heap[(pos - 1) / 2];
+	heap[pos] = index;
+}
+
+static void heap_pop(const struct e820batch *batch, unsigned *heap, unsigned *nheap)
+{
+	const unsigned last = heap[--*nheap];
+	unsigned pos = 0;
+
+	while (2 * pos + 1 < *nheap) {
+		unsigned child = 2 * pos + 1;
+		if (child + 1 < *nheap && batch[heap[child + 1]].seq > batch[heap[child]].seq)
+			child++;
+		if (batch[heap[child]].seq < batch[last].seq)
+			break;
+		heap[pos] = heap[child];
+		pos = child;
+	}
+
+	heap[pos] = last;
+}
+
+unsigned e820_resolve(struct e820entry *map, const unsigned max, struct e820batch *batch, const unsigned n)
+{
+	unsigned *heap = (unsigned *)malloc(n * sizeof(*heap));
+	unsigned nheap = 0, used = 0, next = 0;
+	uint64_t pos = 0;
+	xassert(heap || !n);
+
+	qsort(batch, n, sizeof(*batch), by_base);
+
+	while (next < n || nheap) {
+		if (!nheap)
+			pos = batch[next].base;
+
+		while (next < n && batch[next].base <= pos)
+			heap_push(batch, heap, &nheap, next++);
+
+		// covered entries ending are only dropped once latest
+		while (nheap && batch[heap[0]].end <= pos)
+			heap_pop(batch, heap, &nheap);
+
+		if (!nheap)
+			continue;
+
+		// the latest add covering here decides, until it ends or a later one may start
+		const struct e820batch *top = &batch[heap[0]];
+		const uint64_t end = next < n ? min(top->end, batch[next].base) : top->end;
+
+		if (used && map[used - 1].base + map[used - 1].length == pos && map[used - 1].type == top->type) {
+			map[used - 1].length += end - pos;
+		} else {
+			xassert(used < max);
+			map[used].base = pos;
+			map[used].length = end - pos;
+			map[used].type = top->type;
+			used++;
+		}
+
+		pos = end;
+	}
+
+	free(heap);
+	return used;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "hmat.h"
+#include "bench.h"
+#include "../library/base.h"
+
+// 0 and 0xffff mean unreachable to the OS, so entries are kept between
+#define ENTRY_MAX 0xfffe
+
+static char *put(char *out, const void *data, const unsigned len, unsigned *total)
+{
+	if (out) {
+		memcpy(out, data, len);
+		out += len;
+	}
+	*total += len;
+	return out;
+}
+
+// entries are values in multiples of the base unit, so the largest fits
+static char *locality(char *out, const struct hmat_info *info, const uint8_t type, const uint32_t *values,
+  const uint64_t scale, unsigned *total)
+{
+	const unsigned n = info->ndomains;
+	uint64_t largest = 1;
+	for (unsigned i = 0; i < n * n; i++)
+		largest = max(largest, values[i] * scale);
+
+	struct acpi_hmat_locality loc;
+	memset(&loc, 0, sizeof(loc));
+	loc.type = HMAT_LOCALITY;
+	loc.length = sizeof(loc) + 2 * n * sizeof(uint32_t) + n * n * sizeof(uint16_t);
+	loc.data_type = type;
+	loc.initiators = n;
+	loc.targets = n;
+	loc.base_unit = (largest + ENTRY_MAX - 1) / ENTRY_MAX;
+	out = put(out, &loc, sizeof(loc), total);
+
+	for (unsigned list = 0; list < 2; list++)
+		for (uint32_t d = 0; d < n; d++)
+			out = put(out, &d, sizeof(d), total);
+
+	for (unsigned i = 0; i < n * n; i++) {
+		const uint16_t entry = min(max((values[i] * scale + loc.base_unit / 2) / loc.base_unit, 1ULL), (uint64_t)ENTRY_MAX);
+		out = put(out, &entry, sizeof(entry), total);
+	}
+
+	return out;
+}
+
+unsigned hmat_payload(char *out, const struct hmat_info *info)
+{
+	unsigned total = 0;
+	const uint32_t reserved = 0;
+	out = put(out, &reserved, sizeof(reserved), &total);
+
+	// each domain's cores are its memory's local initiator
+	for (uint32_t d = 0; d < info->ndomains; d++) {
+		struct acpi_hmat_proximity prox;
+		memset(&prox, 0, sizeof(prox));
+		prox.type = HMAT_PROXIMITY;
+		prox.length = sizeof(prox);
+		prox.flags = 1;
+		prox.initiator = d;
+		prox.memory = d;
+		out = put(out, &prox, sizeof(prox), &total);
+	}
+
+	out = locality(out, info, HMAT_ACCESS_LATENCY, info->latency, 1000, &total);
+	out = locality(out, info, HMAT_READ_BANDWIDTH, info->read, 1, &total);
+	out = locality(out, info, HMAT_WRITE_BANDWIDTH, info->write, 1, &total);
+
+	// the nCache fronts remote memory as one write-back level of 64-byte lines; its indexing isn't described
+	for (uint32_t d = 0; d < info->ndomains; d++) {
+		if (!info->ncache[d])
+			continue;
+
+		struct acpi_hmat_cache cache;
+		memset(&cache, 0, sizeof(cache));
+		cache.type = HMAT_CACHE;
+		cache.length = sizeof(cache);
+		cache.memory = d;
+		cache.size = info->ncache[d];
+		cache.attributes = 1 | (1 << 4) | (0 << 8) | (1 << 12) | (64 << 16);
+		out = put(out, &cache, sizeof(cache), &total);
+	}
+
+	return total;
+}
+
+unsigned hmat_size(const unsigned ndomains)
+{
+	const unsigned locality = sizeof(struct acpi_hmat_locality) + 2 * ndomains * sizeof(uint32_t) + ndomains * ndomains * sizeof(uint16_t);
+	return sizeof(uint32_t) + ndomains * (sizeof(struct acpi_hmat_proximity) + sizeof(struct acpi_hmat_cache)) + 3 * locality;
+}
+
+void hmat_model(uint32_t *latency, uint32_t *read, uint32_t *write, const uint8_t *dist, const unsigned ndomains)
+{
+	for (unsigned i = 0; i < ndomains * ndomains; i++) {
+		xassert(dist[i] >= 10);
+		latency[i] = HMAT_LOCAL_NS * dist[i] / 10;
+		read[i] = HMAT_LOCAL_MBPS * 10 / dist[i];
+		write[i] = read[i];
+	}
+}
+
+void hmat_measured(uint32_t *latency, uint32_t *read, uint32_t *write, const uint8_t *dist, const unsigned *server,
+  const unsigned ndomains, const struct bench_matrix *bench)
+{
+	for (unsigned i = 0; i < ndomains; i++) {
+		for (unsigned j = 0; j < ndomains; j++) {
+			const unsigned k = i * ndomains + j;
+			const unsigned s = server[i], d = server[j];
+			const struct bench_entry *entry = &bench->entries[s * bench->nnodes + d];
+			xassert(s < bench->nnodes && d < bench->nnodes && dist[k] >= 10);
+
+			if (s == d) {
+				latency[k] = entry->latency * dist[k] / 10;
+				read[k] = entry->read * 10 / dist[k];
+				write[k] = entry->write * 10 / dist[k];
+			} else {
+				latency[k] = entry->latency;
+				read[k] = entry->read;
+				write[k] = entry->write;
+			}
+		}
+	}
+}
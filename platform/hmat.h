@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// hop model for when the fabric isn't measured, scaling local figures typical of 6300-series Opterons by SLIT distance
+#define HMAT_LOCAL_NS   90   // local DRAM dependent load, at SLIT distance 10
+#define HMAT_LOCAL_MBPS 8000 // local DRAM streaming from one northbridge's cores
+
+struct bench_matrix;
+
+// HMAT revision 2 (ACPI 6.3) structures
+#define HMAT_PROXIMITY 0
+#define HMAT_LOCALITY  1
+#define HMAT_CACHE     2
+
+#define HMAT_ACCESS_LATENCY 0
+#define HMAT_READ_BANDWIDTH 4
+#define HMAT_WRITE_BANDWIDTH 5
+
+struct acpi_hmat_proximity {
+	uint16_t type, reserved1;
+	uint32_t length;
+	uint16_t flags, reserved2; // bit 0: initiator valid
+	uint32_t initiator, memory;
+	uint32_t reserved3;
+	uint64_t reserved4, reserved5;
+} __attribute__((packed));
+
+// followed by initiator and target domain lists, then 16-bit entries in units of base_unit, rows by initiator
+struct acpi_hmat_locality {
+	uint16_t type, reserved1;
+	uint32_t length;
+	uint8_t flags, data_type, min_transfer, reserved2;
+	uint32_t initiators, targets;
+	uint32_t reserved3;
+	uint64_t base_unit; // picoseconds for latency, MB/s for bandwidth
+} __attribute__((packed));
+
+struct acpi_hmat_cache {
+	uint16_t type, reserved1;
+	uint32_t length;
+	uint32_t memory, reserved2;
+	uint64_t size;
+	uint32_t attributes; // levels, level, associativity, write policy, line size
+	uint16_t reserved3, smbios_handles;
+} __attribute__((packed));
+
+// per proximity domain, in SRAT order; every domain has cores and memory
+struct hmat_info {
+	unsigned ndomains;
+	const uint32_t *latency;      // ns, rows by initiator, columns by target
+	const uint32_t *read, *write; // MB/s
+	const uint64_t *ncache;       // bytes of nCache holding each domain's memory for other servers, 0 for none
+};
+
+// payload following the SDT header; writes it unless out is NULL, returning its length
+unsigned hmat_payload(char *out, const struct hmat_info *info);
+// the longest payload for the domains, with every domain's memory cached
+unsigned hmat_size(const unsigned ndomains);
+
+// from SLIT distances, local being 10
+void hmat_model(uint32_t *latency, uint32_t *read, uint32_t *write, const uint8_t *dist, const unsigned ndomains);
+
+// from the per-server fabric matrix; within a server, SLIT distances between northbridges split the diagonal
+void hmat_measured(uint32_t *latency, uint32_t *read, uint32_t *write, const uint8_t *dist, const unsigned *server,
+  const unsigned ndomains, const struct bench_matrix *bench);
@@ -19,6 +19,7 @@
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <stddef.h>
 
 class IPMI
 {
@@ -24,6 +24,7 @@
 #include "../bootloader.h"
 #include "../version.h"
 #include "options.h"
+#include "../library/trace.h"
 
 struct optargs {
 	const char label[20];
@@ -146,7 +147,7 @@ void Options::parse_flags(const char *val, void *data)
 
 Options::Options(const int argc, char *const argv[]): config_filename("fabric.txt"), flash(),
 	ht_slowmode(0), init_only(0), boot_wait(0), handover_acpi(0),
-	fastboot(0), remote_io(1), test_manufacture(0), test_boardinfo(0), dimmtest(2), memlimit(~0), tracing(0)
+	fastboot(0), overlap(1), remote_io(1), route_cache(1), test_manufacture(0), test_boardinfo(0), dimmtest(2), memlimit(~0), tracing(0), access_trace(0), console_level(LOG_INFO), workers(-1), bench(0), bench_cores(4), stress(NULL), stress_ms(100), stress_size(64 << 10), memtest(0), memtest_stride(4 << 10), memtest_latency(0), ncache(0), slit_measure(0), slit_timeout(100)
 {
 	memset(&debug, 0, sizeof(debug));
 
@@ -158,11 +159,27 @@ Options::Options(const int argc, char *const argv[]): config_filename("fabric.tx
 		{"config",          &Options::parse_string, &config_filename}, // path to fabric configuration JSON
 		{"debug",           &Options::parse_flags,  &debug},           // enable subsystem debug checking/output
 		{"fastboot",        &Options::parse_bool,   &fastboot},        // skip/reduce slower testing during unification
+		{"overlap",         &Options::parse_bool,   &overlap},         // overlap independent hardware waits, such as nCache DIMM zeroing with fabric synchronisation
 		{"remote-io",       &Options::parse_bool,   &remote_io},       // enable experimental remote IO
 		{"tracing",         &Options::parse_int64,  &tracing},         // memory per NUMA node reserved for HT tracing
+		{"access-trace",    &Options::parse_int64,  &access_trace},    // memory reserved for a binary trace of config-space accesses
+		{"console-level",   &Options::parse_int,    &console_level},   // 0 errors, 1 warnings, 2 info, 3 debug; the log ring keeps all levels
+		{"workers",         &Options::parse_int,    &workers},         // application cores taking parallel work items; 0 leaves them to the BSP
+		{"bench",           &Options::parse_int64,  &bench},           // memory per server for measuring fabric latency and bandwidth; exceed the nCache to bypass it
+		{"bench.cores",     &Options::parse_int,    &bench_cores},     // cores per server measuring bandwidth
+		{"stress",          &Options::parse_string, &stress},          // coherency stress patterns on every core: local,neighbour,all-to-all,hotspot,false-sharing,atomic or all
+		{"stress.ms",       &Options::parse_int,    &stress_ms},       // duration of each stress pattern
+		{"stress.size",     &Options::parse_int64,  &stress_size},     // memory per server the stress patterns spread over
+		{"memtest",         &Options::parse_bool,   &memtest},         // sweep usable memory on each server's cores after clearing it
+		{"memtest.stride",  &Options::parse_int64,  &memtest_stride},  // bytes between the sweep's 64-bit accesses; 64 tests every line
+		{"memtest.latency", &Options::parse_bool,   &memtest_latency}, // time each read, reporting latency per 16GB chunk
 		{"memlimit",        &Options::parse_int64,  &memlimit},        // per-server memory limit
+		{"ncache",          &Options::parse_int64,  &ncache},          // nCache size from 1G to 8G, trading remote caching for MTag coverage; 0 takes the most leaving memory covered
+		{"slit.measure",    &Options::parse_bool,   &slit_measure},    // SLIT distances between servers from uncached read latency probed at boot, rather than hop counts
+		{"slit.timeout",    &Options::parse_int,    &slit_timeout},    // milliseconds the probe may take before the SLIT keeps hop counts
 		{"flash",           &Options::parse_string, &flash},           // path to image file to flash
 		{"dimmtest",        &Options::parse_int,    &dimmtest},        // run memory controller BIST for DIMM
+		{"route-cache",     &Options::parse_bool,   &route_cache},     // reuse routing tables cached in SPI EEPROM while topology is unchanged
 		{"test.manufacture",&Options::parse_bool,   &test_manufacture},// perform manufacture testing; requires a cable between each port pair
 		{"test.boardinfo",  &Options::parse_bool,   &test_boardinfo},  // update board info
 	};
@@ -209,4 +226,9 @@ Options::Options(const int argc, char *const argv[]): config_filename("fabric.tx
 		warning("%" PRIu64 "MB trace buffers are too small; disabling", tracing >> 20);
 		tracing = 0;
 	}
+
+	if (access_trace > TRACE_MAX) {
+		warning("Limiting access trace to %uMB", TRACE_MAX >> 20);
+		access_trace = TRACE_MAX;
+	}
 }
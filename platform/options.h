@@ -31,12 +31,28 @@ public:
 	bool boot_wait;
 	bool handover_acpi;
 	bool fastboot;
+	bool overlap;
 	bool remote_io;
+	bool route_cache;
 	bool test_manufacture;
 	bool test_boardinfo;
 	int dimmtest;
 	uint64_t memlimit;
 	uint64_t tracing;
+	uint64_t access_trace;
+	int console_level;
+	int workers;
+	uint64_t bench;
+	int bench_cores;
+	const char *stress;
+	int stress_ms;
+	uint64_t stress_size;
+	bool memtest;
+	uint64_t memtest_stride;
+	bool memtest_latency;
+	uint64_t ncache;
+	bool slit_measure;
+	int slit_timeout;
 	struct debug_flags {
 		uint8_t config, access, acpi, ht, fabric, maps, remote_io, e820, northbridge, wdt, cores, mctr, wdtinfo, monitor;
 	} debug;
@@ -114,8 +114,7 @@ void Device::classify()
 
 	// if there are both 64-bit and 32-bit prefetchable BARs, demote the 32-bit BARs to non-prefetchable, so the 64-bit BARs can be in high memory
 	if (bars_pref64.size() && bars_pref32.size()) {
-		if (options->debug.remote_io)
-			printf("demoting 32-bit pref BARs to non-pref @ %03x %02x:%02x.%x\n", node->config->id, bus, dev, fn);
+		debugf(remote_io, "demoting 32-bit pref BARs to non-pref @ %03x %02x:%02x.%x\n", node->config->id, bus, dev, fn);
 		while (bars_pref32.size()) {
 			BAR *bar = bars_pref32.pop();
 			bars_nonpref32.push_back(bar);
@@ -298,7 +297,7 @@ unsigned probe_bar(const sci_t sci, const uint8_t bus, const uint8_t dev, const
 		}
 
 		len &= ~(len - 1);
-		BAR *bar = new BAR(sci, bus, dev, fn, offset, io, s64, pref, len, assigned, vfs);
+		BAR *bar = new (pdev->arena) BAR(sci, bus, dev, fn, offset, io, s64, pref, len, assigned, vfs);
 		pdev->add(bar);
 	}
 
@@ -347,11 +346,11 @@ static void populate(Bridge *br, const uint8_t bus)
 					probe_bar(br->node->config->id, bus, dev, fn, 0x14, br);
 				probe_bar(br->node->config->id, bus, dev, fn, 0x38, br);
 
-				Bridge *sub = new Bridge(br->node, br, bus, dev, fn);
+				Bridge *sub = new (br->arena) Bridge(br->arena, br->node, br, bus, dev, fn);
 				uint8_t sec = (lib::mcfg_read32(br->node->config->id, bus, dev, fn, 0x18) >> 8) & 0xff;
 				populate(sub, sec);
 			} else {
-				Endpoint *ep = new Endpoint(br->node, br, bus, dev, fn);
+				Endpoint *ep = new (br->arena) Endpoint(br->arena, br->node, br, bus, dev, fn);
 				scan_device(br->node->config->id, bus, dev, fn, ep);
 			}
 
@@ -411,18 +410,31 @@ static void pci_prepare(const Node *const node)
 	}
 }
 
+// on any core
+static int pci_prepare_work(void *arg)
+{
+	pci_prepare((const Node *)arg);
+	return 0;
+}
+
 void pci_realloc()
 {
-	Vector<Bridge*> roots;
+	lib::Arena arena;
+	Vector<Bridge*> roots(&arena);
 	// start MMIO64 after the HyperTransport decode range to avoid interference
 
 	lib::critical_enter();
 
-	// phase 1
-	foreach_node(node) {
-		pci_prepare(*node);
+	// phase 1, preparing servers' southbridges in parallel
+	lib::work_pool *pool = lib::work_new();
+	foreach_node(node)
+		lib::work_add(pool, (*node)->config->id, "PCI prepare", pci_prepare_work, *node);
+	if (work_run(pool))
+		fatal("PCI preparation failed");
+	lib::work_free(pool);
 
-		Bridge *b0 = new Bridge(*node, NULL, 0, 0, 0, Device::TypeHost); // host bridge
+	foreach_node(node) {
+		Bridge *b0 = new (arena) Bridge(arena, *node, NULL, 0, 0, 0, Device::TypeHost); // host bridge
 		populate(b0, 0);
 		roots.push_back(b0);
 
@@ -447,14 +459,11 @@ void pci_realloc()
 			(*br)->scope();
 			(*br)->node->mmio32_base = Device::alloc->end32;
 			(*br)->node->mmio32_limit = 0xe0000000;
-			if (options->debug.remote_io)
-				printf("usable 0x%08llx-0x%08llx; master MMIO32 0x%llx-0x%llx\n", Device::alloc->start32, Device::alloc->end32, (*br)->node->mmio32_base, (*br)->node->mmio32_limit);
+			debugf(remote_io, "usable 0x%08llx-0x%08llx; master MMIO32 0x%llx-0x%llx\n", Device::alloc->start32, Device::alloc->end32, (*br)->node->mmio32_base, (*br)->node->mmio32_limit);
 		} else {
-			if (options->debug.remote_io)
-				printf("%03x prefetchable:\n", (*br)->node->config->id);
+			debugf(remote_io, "%03x prefetchable:\n", (*br)->node->config->id);
 			(*br)->assign_pref();
-			if (options->debug.remote_io)
-				printf("%03x nonprefetchable:\n", (*br)->node->config->id);
+			debugf(remote_io, "%03x nonprefetchable:\n", (*br)->node->config->id);
 			(*br)->assign_nonpref();
 		}
 
@@ -464,8 +473,7 @@ void pci_realloc()
 			(*br)->node->mmio32_limit = Device::alloc->pos32;
 		(*br)->node->mmio64_limit = Device::alloc->pos64;
 
-		if (options->debug.remote_io)
-			printf("%03x: 0x%llx-0x%llx 0x%llx-0x%llx\n", (*br)->node->config->id, (*br)->node->mmio32_base, (*br)->node->mmio32_limit, (*br)->node->mmio64_base, (*br)->node->mmio64_limit);
+		debugf(remote_io, "%03x: 0x%llx-0x%llx 0x%llx-0x%llx\n", (*br)->node->config->id, (*br)->node->mmio32_base, (*br)->node->mmio32_limit, (*br)->node->mmio64_base, (*br)->node->mmio64_limit);
 	}
 
 	// prevent hole in MMIO32 area
@@ -88,6 +88,7 @@ public:
 	}
 };
 
+// the tree, its BARs and their lists are on the arena given, and freed together once assigned
 class Device
 {
 	Vector<Device *> children;
@@ -103,8 +104,11 @@ public:
 	uint8_t bus, dev, fn;
 	static Allocator *alloc;
 
-	Device(Node *const _node, Device *_parent, const uint8_t _bus, const uint8_t _dev, const uint8_t _fn, const Type _type):
-		type(_type), node(_node), parent(_parent), bus(_bus), dev(_dev), fn(_fn)
+	lib::Arena &arena;
+
+	Device(lib::Arena &_arena, Node *const _node, Device *_parent, const uint8_t _bus, const uint8_t _dev, const uint8_t _fn, const Type _type):
+		children(&_arena), bars_nonpref32(&_arena), bars_pref32(&_arena), bars_pref64(&_arena), bars_io(&_arena),
+		type(_type), node(_node), parent(_parent), bus(_bus), dev(_dev), fn(_fn), arena(_arena)
 	{
 		// add as parent's child
 		if (parent)
@@ -127,7 +131,7 @@ public:
 class Endpoint: public Device
 {
 public:
-	Endpoint(Node *const _node, Device *_parent, const uint8_t _bus, const uint8_t _dev, const uint8_t _fn): Device(_node, _parent, _bus, _dev, _fn, TypeEndpoint)
+	Endpoint(lib::Arena &_arena, Node *const _node, Device *_parent, const uint8_t _bus, const uint8_t _dev, const uint8_t _fn): Device(_arena, _node, _parent, _bus, _dev, _fn, TypeEndpoint)
 	{
 #ifdef DEBUG
 		printf("device @ %02x:%02x.%x\n", _bus, _dev, _fn);
@@ -139,7 +143,7 @@ public:
 class Bridge: public Device
 {
 public:
-	Bridge(Node *const _node, Device *_parent, const uint8_t _bus, const uint8_t _dev, const uint8_t _fn, const Type _type=TypeBridge): Device(_node, _parent, _bus, _dev, _fn, _type)
+	Bridge(lib::Arena &_arena, Node *const _node, Device *_parent, const uint8_t _bus, const uint8_t _dev, const uint8_t _fn, const Type _type=TypeBridge): Device(_arena, _node, _parent, _bus, _dev, _fn, _type)
 	{
 #ifdef DEBUG
 		printf("bridge @ %02x:%02x.%x\n", _bus, _dev, _fn);
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "pptt.h"
+#include "../library/base.h"
+
+static char *put(char *out, const void *data, const unsigned len, unsigned *total)
+{
+	if (out) {
+		memcpy(out, data, len);
+		out += len;
+	}
+	*total += len;
+	return out;
+}
+
+// without compute units, each core has the caches of one
+static unsigned scope(const struct pptt_info *info, const unsigned c)
+{
+	const enum pptt_scope scope = info->caches[c].scope;
+	return scope == PPTT_UNIT && info->cores_per_unit == 1 ? PPTT_CORE : scope;
+}
+
+// levels private to the same node are chained; the node lists the chains' heads
+static int chained(const struct pptt_info *info, const unsigned c, const int step)
+{
+	for (unsigned d = 0; d < info->ncaches; d++)
+		if (scope(info, d) == scope(info, c) && (int)info->caches[d].level == (int)info->caches[c].level + step)
+			return d;
+	return -1;
+}
+
+// one structure describes every instance
+static char *cache(char *out, const struct pptt_info *info, const unsigned c, const unsigned base, unsigned *total)
+{
+	const struct pptt_cache *desc = &info->caches[c];
+	xassert(desc->ways && desc->line);
+
+	struct acpi_pptt_cache cache;
+	memset(&cache, 0, sizeof(cache));
+	cache.type = PPTT_CACHE;
+	cache.length = sizeof(cache);
+	cache.flags = PPTT_SIZE_VALID | PPTT_SETS_VALID | PPTT_WAYS_VALID | PPTT_ALLOC_VALID | PPTT_TYPE_VALID | PPTT_POLICY_VALID | PPTT_LINE_VALID;
+	const int next = chained(info, c, 1);
+	if (next >= 0)
+		cache.next_level = base + next * sizeof(cache);
+	cache.size = desc->size;
+	cache.sets = desc->size / (desc->ways * desc->line);
+	cache.ways = min(desc->ways, 255U);
+	cache.attributes = desc->attributes;
+	cache.line = desc->line;
+	return put(out, &cache, sizeof(cache), total);
+}
+
+// hierarchy node listing the chains of the caches private at its scope, or -1 for none, and the extra cache unless 0
+static char *processor(char *out, const struct pptt_info *info, const uint32_t flags, const uint32_t parent, const uint32_t id,
+  const int owns, const uint32_t extra, const unsigned base, unsigned *total)
+{
+	uint32_t resources = extra ? 1 : 0;
+	for (unsigned c = 0; c < info->ncaches; c++)
+		resources += (int)scope(info, c) == owns && chained(info, c, -1) < 0;
+
+	struct acpi_pptt_processor node;
+	memset(&node, 0, sizeof(node));
+	node.type = PPTT_PROCESSOR;
+	node.length = sizeof(node) + resources * sizeof(uint32_t);
+	node.flags = flags;
+	node.parent = parent;
+	node.acpi_id = id;
+	node.resources = resources;
+	out = put(out, &node, sizeof(node), total);
+
+	// CPU caches lead the payload
+	for (unsigned c = 0; c < info->ncaches; c++) {
+		if ((int)scope(info, c) != owns || chained(info, c, -1) >= 0)
+			continue;
+		const uint32_t offset = base + c * sizeof(struct acpi_pptt_cache);
+		out = put(out, &offset, sizeof(offset), total);
+	}
+
+	if (extra)
+		out = put(out, &extra, sizeof(extra), total);
+	return out;
+}
+
+unsigned pptt_payload(char *out, const struct pptt_info *info, const unsigned base)
+{
+	unsigned total = 0;
+	xassert(info->dies_per_package && info->cores_per_unit);
+
+	for (unsigned c = 0; c < info->ncaches; c++)
+		out = cache(out, info, c, base, &total);
+
+	const uint32_t system = base + total;
+	out = processor(out, info, 0, 0, 0, -1, 0, base, &total);
+
+	unsigned die = 0, core = 0;
+	for (unsigned s = 0; s < info->nservers; s++) {
+		// the nCache holds remote memory for all the server's cores, the level beyond the die's
+		uint32_t ncache = 0;
+		if (info->ncache[s]) {
+			struct acpi_pptt_cache cache;
+			memset(&cache, 0, sizeof(cache));
+			cache.type = PPTT_CACHE;
+			cache.length = sizeof(cache);
+			cache.flags = PPTT_ALLOC_VALID | PPTT_TYPE_VALID | PPTT_POLICY_VALID | PPTT_LINE_VALID;
+			cache.attributes = PPTT_READ_WRITE | PPTT_UNIFIED | PPTT_WRITE_BACK;
+			cache.line = 64;
+
+			// 4GB and larger don't fit
+			if (info->ncache[s] <= 0xffffffffULL) {
+				cache.flags |= PPTT_SIZE_VALID;
+				cache.size = info->ncache[s];
+			}
+
+			ncache = base + total;
+			out = put(out, &cache, sizeof(cache), &total);
+		}
+
+		const uint32_t server = base + total;
+		out = processor(out, info, 0, system, 0, -1, ncache, base, &total);
+
+		uint32_t package = 0, unit = 0;
+		for (unsigned d = 0; d < info->dies[s]; d++, die++) {
+			if (d % info->dies_per_package == 0) {
+				package = base + total;
+				out = processor(out, info, PPTT_PACKAGE, server, 0, -1, 0, base, &total);
+			}
+
+			const uint32_t node = base + total;
+			out = processor(out, info, 0, package, 0, PPTT_DIE, 0, base, &total);
+
+			for (unsigned c = 0; c < info->cores[die]; c++, core++) {
+				uint32_t parent = node;
+				if (info->cores_per_unit > 1) {
+					if (c % info->cores_per_unit == 0) {
+						unit = base + total;
+						out = processor(out, info, 0, node, 0, PPTT_UNIT, 0, base, &total);
+					}
+					parent = unit;
+				}
+
+				out = processor(out, info, PPTT_ID_VALID | PPTT_LEAF, parent, info->uids[core], PPTT_CORE, 0, base, &total);
+			}
+		}
+	}
+
+	return total;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// PPTT revision 2 (ACPI 6.3) structures
+#define PPTT_PROCESSOR 0
+#define PPTT_CACHE     1
+
+// processor hierarchy node flags
+#define PPTT_PACKAGE  (1 << 0)
+#define PPTT_ID_VALID (1 << 1)
+#define PPTT_LEAF     (1 << 3)
+
+// cache flags, marking which fields are valid
+#define PPTT_SIZE_VALID   (1 << 0)
+#define PPTT_SETS_VALID   (1 << 1)
+#define PPTT_WAYS_VALID   (1 << 2)
+#define PPTT_ALLOC_VALID  (1 << 3)
+#define PPTT_TYPE_VALID   (1 << 4)
+#define PPTT_POLICY_VALID (1 << 5)
+#define PPTT_LINE_VALID   (1 << 6)
+
+// cache attributes
+#define PPTT_READ_WRITE  (3 << 0)
+#define PPTT_DATA        (0 << 2)
+#define PPTT_INSTRUCTION (1 << 2)
+#define PPTT_UNIFIED     (2 << 2)
+#define PPTT_WRITE_BACK  (0 << 4)
+
+// followed by the table offsets of the caches private to the node
+struct acpi_pptt_processor {
+	uint8_t type, length;
+	uint16_t reserved;
+	uint32_t flags;
+	uint32_t parent; // table offset, 0 at the root
+	uint32_t acpi_id;
+	uint32_t resources;
+} __attribute__((packed));
+
+struct acpi_pptt_cache {
+	uint8_t type, length;
+	uint16_t reserved;
+	uint32_t flags;
+	uint32_t next_level; // table offset, 0 for none
+	uint32_t size, sets;
+	uint8_t ways, attributes;
+	uint16_t line;
+} __attribute__((packed));
+
+// the hierarchy level sharing each instance of a cache; OSes count a cache's level along next-level chains and
+// up the hierarchy from the core, so a level 1 cache shared by a compute unit must still be listed by its cores
+enum pptt_scope {PPTT_CORE, PPTT_UNIT, PPTT_DIE};
+
+struct pptt_cache {
+	enum pptt_scope scope;
+	unsigned level, attributes;
+	uint32_t size;       // bytes
+	unsigned ways, line; // ways as many as lines when fully associative
+};
+
+// servers' dies in SRAT order, their cores in MADT order
+struct pptt_info {
+	unsigned nservers;
+	const unsigned *dies;      // northbridges in each server
+	const unsigned *cores;     // cores on each die
+	const uint32_t *uids;      // each core's ACPI processor UID
+	unsigned dies_per_package, cores_per_unit;
+	unsigned ncaches;
+	const struct pptt_cache *caches;
+	const uint64_t *ncache;    // bytes of each server's nCache, 0 for none
+};
+
+// payload following the SDT header at table offset base; writes it unless out is NULL, returning its length
+unsigned pptt_payload(char *out, const struct pptt_info *info, const unsigned base);
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "slit.h"
+#include "../library/base.h"
+
+bool slit_measured(uint8_t *dist, const unsigned ndomains, const unsigned *server, const uint32_t *latency, const unsigned nservers)
+{
+	for (unsigned s = 0; s < nservers; s++)
+		for (unsigned t = 0; t < nservers; t++)
+			if (!latency[s * nservers + t])
+				return 0;
+
+	for (unsigned i = 0; i < ndomains; i++) {
+		const unsigned s = server[i];
+		xassert(s < nservers);
+
+		// remote memory is never nearer than the farthest northbridge in the server
+		unsigned floor = SLIT_LOCAL;
+		for (unsigned j = 0; j < ndomains; j++)
+			if (server[j] == s)
+				floor = max(floor, (unsigned)dist[i * ndomains + j]);
+
+		const uint32_t local = latency[s * nservers + s];
+
+		for (unsigned j = 0; j < ndomains; j++) {
+			const unsigned t = server[j];
+			if (t == s)
+				continue;
+
+			// single slow or fast probes are clamped to the hop model's neighbourhood
+			const unsigned hop = dist[i * ndomains + j];
+			const unsigned lo = min(max(hop / 2, floor + 1), SLIT_MAX), hi = max(min(hop * 2, SLIT_MAX), lo);
+			const uint64_t measured = ((uint64_t)latency[s * nservers + t] * SLIT_LOCAL + local / 2) / local;
+			dist[i * ndomains + j] = min(max(measured, (uint64_t)lo), (uint64_t)hi);
+		}
+	}
+
+	return 1;
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define SLIT_LOCAL 10U
+#define SLIT_MAX   254U // 255 marks a locality unreachable
+
+// replaces distances between servers' domains in the hop-model dist with measured latency (ns, by server pair,
+// rows by source) relative to the source server's own, clamped to between half and twice the hop model's and
+// above the source's distances within its server; leaves dist alone, returning false, if a pair is unmeasured
+bool slit_measured(uint8_t *dist, const unsigned ndomains, const unsigned *server, const uint32_t *latency, const unsigned nservers);
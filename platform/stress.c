@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "stress.h"
+#include "bench.h"
+#include "../bootloader.h"
+#include "../library/access.h"
+#include "../library/utils.h"
+#include "../library/work.h"
+
+#define LINE  64
+#define BATCH 64  // operations between deadline checks
+#define SLICE 100 // ms per dispatch, inside the work watchdog
+
+enum stress_pattern {Local, Neighbour, AllToAll, HotSpot, FalseSharing, Atomic, Patterns};
+static const char *const pattern_names[] = {"local", "neighbour", "all-to-all", "hotspot", "false-sharing", "atomic"};
+
+// read by the items while they run
+static uint64_t *buffers; // per server, in nodes[] order
+static uint32_t words;    // initialised words in each buffer
+static uint32_t shared;   // offset of the master's false-sharing lines, a word per core so sixteen share each
+static uint32_t counter;  // offset of the master's atomic counter, on its own line
+
+// one core's traffic
+struct stress_work {
+	enum stress_pattern pattern;
+	unsigned source; // index in nodes[]
+	unsigned slot;   // among all cores; the core's word in the false-sharing lines
+	uint64_t deadline;
+	uint32_t seed;
+	uint32_t ops, errors;
+};
+
+static uint32_t stress_next(struct stress_work *work)
+{
+	work->seed = work->seed * 1664525 + 1013904223;
+	return work->seed >> 8;
+}
+
+// words hold their hash or its inverse, whichever core last inverted them
+static bool stress_check(const uint32_t i, const uint32_t val)
+{
+	return val == lib::hash32(i) || val == ~lib::hash32(i);
+}
+
+static int stress_work(void *arg)
+{
+	struct stress_work *work = (struct stress_work *)arg;
+	unsigned target = work->source;
+
+	switch (work->pattern) {
+	case Neighbour:
+		target = (work->source + 1) % nnodes;
+		break;
+	case HotSpot:
+	case FalseSharing:
+	case Atomic:
+		target = 0;
+		break;
+	default:
+		break;
+	}
+
+	lib::mem_window(buffers[target]);
+
+	while (lib::rdtscll() < work->deadline) {
+		for (unsigned n = 0; n < BATCH; n++) {
+			switch (work->pattern) {
+			case FalseSharing: {
+				// only this core writes its word, so it must read back what it last wrote
+				const uint32_t off = shared + work->slot * 4;
+				if (lib::window_read32(off) != work->ops)
+					work->errors++;
+				lib::window_write32(off, work->ops + 1);
+				break;
+			}
+			case Atomic:
+				lib::window_xadd32(counter, 1);
+				break;
+			default: {
+				if (work->pattern == AllToAll)
+					lib::mem_window(buffers[stress_next(work) % nnodes]);
+
+				const uint32_t i = stress_next(work) % words;
+				if (!stress_check(i, lib::window_read32(i * 4)))
+					work->errors++;
+				lib::window_xor32(i * 4, ~0U);
+			}
+			}
+			work->ops++;
+		}
+	}
+
+	return 0;
+}
+
+static unsigned stress_patterns(void)
+{
+	char *list = strdup(options->stress);
+	unsigned mask = 0;
+	xassert(list);
+
+	for (char *pos = strtok(list, ","); pos; pos = strtok(NULL, ",")) {
+		unsigned p = 0;
+		if (!strcmp(pos, "all"))
+			mask = (1 << Patterns) - 1;
+		else {
+			while (p < Patterns && strcmp(pos, pattern_names[p]))
+				p++;
+			if (p == Patterns)
+				fatal("Unknown stress pattern '%s'", pos);
+			mask |= 1 << p;
+		}
+	}
+
+	free(list);
+	return mask;
+}
+
+// words not holding their hash or its inverse after the pattern
+static uint32_t stress_verify(const unsigned node)
+{
+	uint32_t errors = 0;
+
+	for (uint32_t i = 0; i < words; i++) {
+		const uint32_t val = lib::mem_read32(buffers[node] + i * 4);
+		if (!stress_check(i, val)) {
+			if (!errors)
+				error("%s word %u should have 0x%08x or 0x%08x, but has 0x%08x",
+				  pr_node(nodes[node]->config->id), i, lib::hash32(i), ~lib::hash32(i), val);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+void stress_coherency(void)
+{
+	const unsigned mask = stress_patterns();
+	const unsigned ms = max(options->stress_ms, 1);
+	unsigned ncores = 0;
+
+	foreach_node(node)
+		ncores += (*node)->napics;
+
+	words = options->stress_size / 4;
+	shared = roundup(words * 4, LINE);
+	counter = shared + roundup(ncores * 4, LINE);
+	assertf(words, "stress.size too small");
+
+	buffers = (uint64_t *)zalloc(nnodes * sizeof(*buffers));
+	for (unsigned n = 0; n < nnodes; n++) {
+		buffers[n] = bench_buffer(nodes[n], counter + LINE);
+		for (uint32_t i = 0; i < words; i++)
+			lib::mem_write32(buffers[n] + i * 4, lib::hash32(i));
+	}
+
+	struct stress_work *works = (struct stress_work *)zalloc(ncores * sizeof(*works));
+	uint32_t *errors = (uint32_t *)zalloc(nnodes * sizeof(*errors));
+	uint64_t *ops = (uint64_t *)zalloc(nnodes * sizeof(*ops));
+	unsigned total = 0;
+
+	printf("Coherency stress on %u cores for %ums per pattern; Mops/s and errors by server:\n%16s", ncores, ms, "");
+	for (unsigned n = 0; n < nnodes; n++)
+		printf(" %7.3x    ", nodes[n]->config->id);
+	printf("\n");
+	lib::critical_enter();
+
+	for (enum stress_pattern pattern = Local; pattern < Patterns; pattern = stress_pattern(pattern + 1)) {
+		if (!(mask & (1 << pattern)))
+			continue;
+
+		memset(errors, 0, nnodes * sizeof(*errors));
+		memset(ops, 0, nnodes * sizeof(*ops));
+
+		// each core's word and the counter start from zero
+		for (uint32_t off = shared; off <= counter; off += 4)
+			lib::mem_write32(buffers[0] + off, 0);
+
+		unsigned slot = 0;
+		for (unsigned n = 0; n < nnodes; n++) {
+			for (unsigned k = 0; k < nodes[n]->napics; k++, slot++) {
+				struct stress_work *work = &works[slot];
+				memset(work, 0, sizeof(*work));
+				work->pattern = pattern;
+				work->source = n;
+				work->slot = slot;
+				work->seed = lib::hash32(slot + 1);
+			}
+		}
+
+		// in slices, so cores don't appear stalled to the work watchdog
+		for (unsigned elapsed = 0; elapsed < ms; elapsed += SLICE) {
+			lib::work_pool *pool = lib::work_new();
+			pool->strict = 1;
+			const uint64_t deadline = lib::rdtscll() + (uint64_t)min(ms - elapsed, SLICE) * 1000 * Opteron::tsc_mhz;
+
+			for (unsigned i = 0; i < ncores; i++) {
+				works[i].deadline = deadline;
+				lib::work_add(pool, nodes[works[i].source]->config->id, pattern_names[pattern], stress_work, &works[i]);
+			}
+
+			if (work_run(pool))
+				fatal("Coherency stress failed to run");
+			lib::work_free(pool);
+		}
+
+		for (unsigned i = 0; i < ncores; i++) {
+			const struct stress_work *work = &works[i];
+			ops[work->source] += work->ops;
+			errors[work->source] += work->errors;
+
+			if (pattern == FalseSharing && lib::mem_read32(buffers[0] + shared + work->slot * 4) != work->ops) {
+				error("%s core %u false-sharing word lost updates", pr_node(nodes[work->source]->config->id), work->slot);
+				errors[work->source]++;
+			}
+		}
+
+		if (pattern == Atomic) {
+			uint64_t sum = 0;
+			for (unsigned n = 0; n < nnodes; n++)
+				sum += ops[n];
+
+			const uint32_t count = lib::mem_read32(buffers[0] + counter);
+			if (count != (uint32_t)sum) {
+				error("Atomic counter has %u after %" PRIu64 " increments", count, sum);
+				errors[0]++;
+			}
+		} else if (pattern != FalseSharing) {
+			for (unsigned n = 0; n < nnodes; n++)
+				errors[n] += stress_verify(n);
+		}
+
+		printf("  %-14s", pattern_names[pattern]);
+		for (unsigned n = 0; n < nnodes; n++) {
+			// hundredths of Mops/s, as the COM32 printf has no floating point
+			const uint32_t rate = ops[n] / (ms * 10ULL);
+			printf(" %4u.%02u/%-3u", rate / 100, rate % 100, errors[n]);
+			total += errors[n];
+		}
+		printf("\n");
+	}
+
+	lib::critical_leave();
+
+	// leave the memory as the OS expects it, cleared
+	for (unsigned n = 0; n < nnodes; n++)
+		for (uint32_t off = 0; off <= counter; off += 4)
+			lib::mem_write32(buffers[n] + off, 0);
+
+	free(ops);
+	free(errors);
+	free(works);
+	free(buffers);
+
+	if (total)
+		fatal("%u coherency errors under stress", total);
+}
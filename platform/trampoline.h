@@ -28,6 +28,7 @@
 #define VECTOR_SETUP_OBSERVER 4
 #define VECTOR_TEST           5
 #define VECTOR_TEST_FINISH    6
+#define VECTOR_WORK           7
 
 #define E820_MAP_MAX 4096
 #define MSR_MAX 32
@@ -35,6 +36,7 @@
 #define TEST_BASE_HIGH 0x1 // 4GB base
 #define TEST_BASE_LOW  0x88000
 #define TEST_SIZE      (1 << 12)
+#define WORK_STACK     (8 << 10) // per core taking work items
 
 #ifndef __ASSEMBLER__
 #define IMPORT_RELOCATED(sym) extern volatile uint8_t sym ## _relocate
@@ -56,6 +58,15 @@ IMPORT_RELOCATED(old_int15_vec);
 IMPORT_RELOCATED(new_e820_len);
 IMPORT_RELOCATED(new_e820_map);
 IMPORT_RELOCATED(new_e820_handler);
+IMPORT_RELOCATED(work32);
+IMPORT_RELOCATED(work_gdt);
+IMPORT_RELOCATED(work_gdt_base);
+IMPORT_RELOCATED(work_jump);
+IMPORT_RELOCATED(work_fn);
+IMPORT_RELOCATED(work_arg);
+IMPORT_RELOCATED(work_stacks);
+IMPORT_RELOCATED(work_slot);
+IMPORT_RELOCATED(work_msrs);
 
 struct msr_ent {
 	uint32_t num;
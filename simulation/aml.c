@@ -8,6 +8,7 @@
 #include <assert.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include "../platform/aml.h"
 #include "../platform/acpi.h"
@@ -16,7 +17,7 @@
 
 #include <assert.h>
 
-#define MMIO32 (64 << 20)
+#define MMIO32 (4 << 20) // 512 nodes fit below 4GB
 #define MMIO64 (1 << 30)
 
 uint16_t dnc_node_count = 0;
@@ -26,6 +27,7 @@ bool test_manufacture = 0;
 Node **nodes;
 Node *local_node;
 unsigned nnodes;
+static uint32_t pxm[AML_MAXNODES];
 
 /* Insert SSDT dumped from booting with verbose=2 into array */
 static uint32_t table[] = {
@@ -64,7 +66,7 @@ static void gen(void)
 	} else {
 		uint32_t extra_len;
 		dnc_node_count = nnodes;
-		char *extra = remote_aml(&extra_len);
+		char *extra = remote_aml(&extra_len, pxm);
 
 		acpi_sdt *ssdt = (acpi_sdt *)malloc(sizeof(struct acpi_sdt) + extra_len);
 		memcpy(ssdt->sig.s, "SSDT", 4);
@@ -86,7 +88,7 @@ static void gen(void)
 
 	assert(close(fd) == 0);
 
-	char cmdline[64], filename2[32];
+	char cmdline[80], filename2[32]; // room for "diff" and two names
 
 	/* Disassemble generated AML to .dsl file */
 	snprintf(cmdline, sizeof(cmdline), "iasl -vs -w3 -d %s 2>/dev/null", filename);
@@ -104,37 +106,276 @@ static void gen(void)
 	launch(cmdline);
 }
 
-int main(void)
+// FNV-1a, to compare output with the recorded output of the previous emitter
+static uint64_t hash(const uint8_t *data, const uint32_t len)
 {
-	nnodes = 8;
-	nodes = (Node **)malloc(sizeof(Node *) * nnodes);
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for (uint32_t i = 0; i < len; i++)
+		h = (h ^ data[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static void setup(const unsigned n)
+{
+	static struct numachip_s numachips[AML_MAXNODES];
+	static struct config_s configs[AML_MAXNODES];
+
+	nnodes = n;
+	nodes = (Node **)realloc(nodes, sizeof(Node *) * nnodes);
 	assert(nodes);
 
 	uint64_t mmio32_top = 2ULL << 30;
 	uint64_t mmio64_top = 4ULL << 40;
 
-	for (sci_t n = 0; n < nnodes; n++) {
-		struct numachip_s numachip = {.ht = 6};
-		struct config_s config = {.id = n};
+	// six northbridges a server, the IOH on the first
+	for (sci_t i = 0; i < nnodes; i++) {
+		numachips[i].ht = 6;
+		configs[i].id = i;
+		pxm[i] = i * 6;
 
-		nodes[n] = (Node *)malloc(sizeof(Node));
-		assert(nodes[n]);
+		nodes[i] = (Node *)malloc(sizeof(Node));
+		assert(nodes[i]);
 
-		memset(nodes[n], 0, sizeof(Node));
-		nodes[n]->numachip = &numachip;
-		nodes[n]->config = &config;
-		nodes[n]->mmio32_base = mmio32_top;
+		memset(nodes[i], 0, sizeof(Node));
+		nodes[i]->numachip = &numachips[i];
+		nodes[i]->config = &configs[i];
+		nodes[i]->mmio32_base = mmio32_top;
 		mmio32_top += MMIO32;
-		nodes[n]->mmio32_limit = mmio32_top -1;
-		nodes[n]->mmio64_base = mmio64_top;
-		mmio32_top += MMIO64;
-		nodes[n]->mmio64_limit = mmio64_top -1;
+		nodes[i]->mmio32_limit = mmio32_top - 1;
+		nodes[i]->mmio64_base = mmio64_top;
+		mmio64_top += MMIO64;
+		nodes[i]->mmio64_limit = mmio64_top - 1;
 	}
 
 	local_node = nodes[0];
-	gen();
+}
+
+static void teardown(void)
+{
+	for (unsigned i = 0; i < nnodes; i++)
+		free(nodes[i]);
+}
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+// PkgLength at p, giving where the package ends
+static const uint8_t *pkg_length(const uint8_t *p, const uint8_t **end)
+{
+	const unsigned n = 1 + (*p >> 6);
+	uint32_t len = n == 1 ? *p & 0x3f : *p & 0xf;
+
+	for (unsigned i = 1; i < n; i++)
+		len |= (uint32_t)p[i] << (4 + 8 * (i - 1));
+
+	// the shortest encoding is used
+	if (n > 1 && len < (n == 2 ? 64U : 1U << (4 + 8 * (n - 2))))
+		return NULL;
+
+	*end = p + len;
+	return p + n;
+}
+
+static const uint8_t *name_string(const uint8_t *p)
+{
+	return p + (*p == '\\') + 4;
+}
+
+// resource descriptors, then EndTag
+static bool resources(const uint8_t *p, const uint8_t *end)
+{
+	while (p < end && *p & 0x80)
+		p += 3 + (p[1] | (p[2] << 8));
+
+	return p + 2 == end && *p == 0x79;
+}
+
+static const uint8_t *term(const uint8_t *p, const uint8_t *limit);
+
+static const uint8_t *terms(const uint8_t *p, const uint8_t *end)
+{
+	while (p && p < end)
+		p = term(p, end);
+
+	return p == end ? p : NULL;
+}
+
+static const uint8_t *term(const uint8_t *p, const uint8_t *limit)
+{
+	const uint8_t *end;
+
+	switch (*p) {
+	case 0x00: case 0x01:
+		return p + 1;
+	case 0x0a:
+		return p + 2;
+	case 0x0b:
+		return p + 3;
+	case 0x0c:
+		return p + 5;
+	case 0x0e:
+		return p + 9;
+	case 0x08: // Name
+		return term(name_string(p + 1), limit);
+	case 0xa4: // Return
+		return term(p + 1, limit);
+	case 0x10: // Scope
+		p = pkg_length(p + 1, &end);
+		return p && end <= limit ? terms(name_string(p), end) : NULL;
+	case 0x14: // Method
+		p = pkg_length(p + 1, &end);
+		return p && end <= limit ? terms(name_string(p) + 1, end) : NULL;
+	case 0x5b: // Device
+		if (p[1] != 0x82)
+			return NULL;
+		p = pkg_length(p + 2, &end);
+		return p && end <= limit ? terms(name_string(p), end) : NULL;
+	case 0x11: // Buffer of resource descriptors
+		p = pkg_length(p + 1, &end);
+		if (!p || end > limit || p[0] != 0x0a || p[1] != end - p - 2)
+			return NULL;
+		return resources(p + 2, end) ? end : NULL;
+	}
+
+	return NULL;
+}
+
+static bool integer(const uint8_t *p, uint64_t *val)
+{
+	switch (*p) {
+	case 0x00: case 0x01:
+		*val = *p;
+		return 1;
+	case 0x0a:
+		*val = p[1];
+		return 1;
+	case 0x0b:
+		*val = p[1] | (p[2] << 8);
+		return 1;
+	case 0x0c:
+		*val = p[1] | (p[2] << 8) | (p[3] << 16) | ((uint32_t)p[4] << 24);
+		return 1;
+	}
 
-	free(nodes);
 	return 0;
 }
 
+// each root bridge's _PXM, PCI0 then X001 onwards, as an OS reads them under \_SB_
+static bool proximities(const uint8_t *aml, const uint32_t len, uint64_t *found, const unsigned n)
+{
+	const uint8_t *end;
+	const uint8_t *p = aml[0] == 0x10 ? pkg_length(aml + 1, &end) : NULL;
+	if (!p || end != aml + len)
+		return 0;
+
+	unsigned bridge = 0;
+	for (p = name_string(p); p < end; bridge++) {
+		const uint8_t *body, *next;
+		if (p[0] == 0x10)
+			body = pkg_length(p + 1, &next);
+		else if (p[0] == 0x5b && p[1] == 0x82)
+			body = pkg_length(p + 2, &next);
+		else
+			return 0;
+
+		char name[5];
+		snprintf(name, sizeof(name), bridge ? "X%03u" : "PCI0", bridge);
+		if (!body || bridge >= n || memcmp(body, name, 4))
+			return 0;
+
+		bool pxm = 0;
+		for (const uint8_t *q = name_string(body); q && q < next; q = term(q, next))
+			if (q[0] == 0x08 && !memcmp(q + 1, "_PXM", 4))
+				pxm = integer(q + 5, &found[bridge]);
+		if (!pxm)
+			return 0;
+		p = next;
+	}
+
+	return bridge == n;
+}
+
+int main(const int argc, const char *argv[])
+{
+	// with "dump", write an SSDT for 8 nodes and check it round-trips through iasl
+	if (argc > 1 && !strcmp(argv[1], "dump")) {
+		setup(8);
+		gen();
+		teardown();
+		return 0;
+	}
+
+	// lengths and hashes from the emitter copying each container's buffer into its parent's
+	static const struct {unsigned nodes; uint32_t len; uint64_t hash;} recorded[] = {
+		{1, 19, 0x25a991aa81bf2f7dULL},
+		{2, 197, 0x2c1d238270d1566eULL},
+		{3, 375, 0x1bcbdc825b514647ULL},
+		{8, 1265, 0xf09def89cc8f83c0ULL},
+		{16, 2689, 0x7a536c9a6542e5cdULL},
+		{31, 5360, 0xed1d11d9b9dc570aULL},
+		{64, 11255, 0x5ff1eca3b4071499ULL},
+		{100, 17699, 0x400033e3138356a6ULL},
+		{128, 22711, 0xb415901bd524eb36ULL},
+		{256, 45751, 0x3d42047dee5cafffULL},
+		{512, 92087, 0xc0ddffff1a5a79a2ULL},
+	};
+	bool same = 1, walks = 1;
+
+	for (unsigned i = 0; i < sizeof(recorded) / sizeof(recorded[0]); i++) {
+		uint32_t len;
+		setup(recorded[i].nodes);
+		char *aml = remote_aml(&len, pxm);
+
+		same &= len == recorded[i].len && hash((const uint8_t *)aml, len) == recorded[i].hash;
+		walks &= term((const uint8_t *)aml, (const uint8_t *)aml + len) == (const uint8_t *)aml + len;
+
+		free(aml);
+		teardown();
+	}
+
+	check(same, "output matches the previous emitter");
+	check(walks, "package lengths nest and end together");
+
+	// uneven servers, with SRAT domains numbering each server's northbridges in turn; the third's IOH link is
+	// on no northbridge listed, so its root bridge takes the server's first
+	static const unsigned dies[] = {2, 4, 1, 3, 2};
+	static const ht_t hts[][4] = {{0, 1}, {0, 1, 2, 3}, {0}, {0, 1, 2}, {3, 4}}, ioh[] = {1, 2, 5, 2, 4};
+	static const uint64_t domains[] = {1, 4, 6, 9, 11};
+	uint64_t found[5];
+	uint32_t len;
+
+	setup(5);
+	for (unsigned s = 0, domain = 0; s < 5; domain += dies[s++])
+		pxm[s] = domain + ioh_northbridge(hts[s], dies[s], ioh[s]);
+	char *aml = remote_aml(&len, pxm);
+	check(proximities((const uint8_t *)aml, len, found, 5) && !memcmp(found, domains, sizeof(domains)),
+	  "root bridges in their IOH northbridge's domain");
+	free(aml);
+	teardown();
+
+	for (unsigned n = 64; n <= 256; n *= 4) {
+		struct timespec start, end;
+		setup(n);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (unsigned i = 0; i < 100; i++) {
+			uint32_t len;
+			free(remote_aml(&len, pxm));
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		printf("%u nodes: %.3fms per SSDT\n", n, ((end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6) / 100);
+		teardown();
+	}
+
+	free(nodes);
+	printf("%u AML tests failed\n", failed);
+	return failed > 0;
+}
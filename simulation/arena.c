@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../library/base.h"
+
+#define PUSHES 1000000
+#define SORTED 4096
+#define OBJECTS 100000
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+static double seconds(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// as a BAR, ordered by length; seq tells equal lengths apart
+struct item {
+	unsigned len, seq;
+
+	bool less(const struct item &rhs) const
+	{
+		return len < rhs.len;
+	}
+};
+
+// Vector::sort as it was
+static void exchange_sort(struct item **elements, const unsigned used)
+{
+	for (unsigned i = 0; i < used; i++) {
+		for (unsigned j = 0; j < used; j++) {
+			if (elements[j]->less(*elements[i])) {
+				struct item *temp = elements[j];
+				elements[j] = elements[i];
+				elements[i] = temp;
+			}
+		}
+	}
+}
+
+// Vector growth as it was, eight elements per realloc
+static double push_linear(const unsigned n)
+{
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	unsigned *elements = NULL, lim = 0;
+	for (unsigned i = 0; i < n; i++) {
+		if (i == lim) {
+			lim += 8;
+			elements = (unsigned *)realloc(elements, sizeof(*elements) * lim);
+			xassert(elements);
+		}
+		elements[i] = i;
+	}
+
+	const double t = seconds(&start);
+	free(elements);
+	return t;
+}
+
+static void test_vector(void)
+{
+	Vector<unsigned> v;
+	bool ok = 1;
+	unsigned grows = 0, lim = 0;
+
+	for (unsigned i = 0; i < 1000; i++) {
+		v.push_back(i);
+		if (v.capacity() != lim) {
+			grows++;
+			lim = v.capacity();
+		}
+	}
+	for (unsigned i = 0; i < 1000; i++)
+		ok &= v.elements[i] == i;
+	check(ok && v.size() == 1000 && v.limit == &v.elements[1000], "push_back keeps order");
+	check(grows <= 8, "capacity doubles");
+
+	ok = 1;
+	for (unsigned i = 1000; i > 500; i--)
+		ok &= v.pop() == i - 1;
+	check(ok && v.size() == 500 && v.limit == &v.elements[500], "pop takes from the back");
+
+	v.insert(9999, 0);
+	v.del(1);
+	check(v.size() == 500 && v.elements[0] == 9999 && v.elements[1] == 1, "insert and del");
+}
+
+static void test_sort(void)
+{
+	static struct item items[SORTED];
+	struct item *ref[SORTED];
+	Vector<struct item *> v;
+	bool ordered = 1, stable = 1, matches = 1;
+
+	srand(1);
+	for (unsigned round = 0; round < 200; round++) {
+		const unsigned n = rand() % 64;
+		Vector<struct item *> w;
+
+		for (unsigned i = 0; i < n; i++) {
+			items[i].len = 1 << (rand() % 8);
+			items[i].seq = i;
+			ref[i] = &items[i];
+			w.push_back(&items[i]);
+		}
+
+		exchange_sort(ref, n);
+		w.sort();
+
+		for (unsigned i = 0; i < n; i++) {
+			matches &= w.elements[i]->len == ref[i]->len;
+			if (i) {
+				ordered &= w.elements[i - 1]->len >= w.elements[i]->len;
+				if (w.elements[i - 1]->len == w.elements[i]->len)
+					stable &= w.elements[i - 1]->seq < w.elements[i]->seq;
+			}
+		}
+	}
+
+	check(matches, "sort orders as exchange sort did");
+	check(ordered, "sort puts greatest first");
+	check(stable, "sort keeps equal elements' order");
+
+	for (unsigned i = 0; i < SORTED; i++) {
+		items[i].len = rand();
+		items[i].seq = i;
+		ref[i] = &items[i];
+		v.push_back(&items[i]);
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	exchange_sort(ref, SORTED);
+	const double before = seconds(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	v.sort();
+	const double after = seconds(&start);
+
+	matches = 1;
+	for (unsigned i = 0; i < SORTED; i++)
+		matches &= v.elements[i]->len == ref[i]->len;
+	check(matches, "4096 elements sort as before");
+	printf("sorting %u elements: %.2fms exchange, %.3fms merge\n", SORTED, before * 1e3, after * 1e3);
+}
+
+static void test_arena(void)
+{
+	lib::Arena arena(4096);
+
+	char *a = (char *)arena.alloc(10);
+	uint64_t *b = (uint64_t *)arena.alloc(sizeof(*b), sizeof(*b));
+	check(!((uintptr_t)b % sizeof(*b)) && (char *)b >= a + 10, "alloc aligns");
+
+	memset(a, 0xff, 10);
+	const lib::Arena::position pos = arena.mark();
+	const size_t used = arena.used();
+
+	char *big = (char *)arena.alloc(10000);
+	bool zero = 1;
+	for (unsigned i = 0; i < 10000; i++)
+		zero &= !big[i];
+	check(zero, "oversized allocation zeroed");
+
+	char *c = (char *)arena.alloc(100);
+	memset(c, 0xaa, 100);
+	char *d = (char *)arena.resize(c, 100, 200);
+	check(d == c && !d[150] && (unsigned char)d[99] == 0xaa, "latest allocation grows in place");
+
+	arena.alloc(8);
+	char *e = (char *)arena.resize(d, 200, 400);
+	check(e != d && (unsigned char)e[99] == 0xaa && !e[300], "earlier allocation moves");
+
+	arena.release(pos);
+	check(arena.used() == used && a[9] == (char)0xff, "release to mark");
+	check(arena.alloc(16) == (char *)b + sizeof(*b), "reuse after release");
+
+	// a Vector on the arena grows in place while nothing follows it
+	Vector<unsigned> v(&arena);
+	for (unsigned i = 0; i < 100; i++)
+		v.push_back(i);
+	bool ok = v.size() == 100;
+	for (unsigned i = 0; i < 100; i++)
+		ok &= v.elements[i] == i;
+	check(ok && arena.used() <= used + 16 + 128 * sizeof(unsigned) + 2 * sizeof(void *), "vector on arena");
+
+	arena.release();
+	check(arena.used() == 0, "release all");
+}
+
+struct node {
+	struct node *next;
+	uint64_t payload[3];
+};
+
+static void bench_arena(void)
+{
+	struct timespec start;
+	struct node *list = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned i = 0; i < OBJECTS; i++) {
+		struct node *n = (struct node *)zalloc(sizeof(*n));
+		n->next = list;
+		list = n;
+	}
+	while (list) {
+		struct node *n = list->next;
+		free(list);
+		list = n;
+	}
+	const double heap = seconds(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	{
+		lib::Arena arena;
+		for (unsigned i = 0; i < OBJECTS; i++) {
+			struct node *n = new (arena) node;
+			n->next = list;
+			list = n;
+		}
+		list = NULL;
+	}
+	const double arena = seconds(&start);
+
+	printf("%u objects: %.2fms from the heap, %.2fms from an arena\n", OBJECTS, heap * 1e3, arena * 1e3);
+}
+
+int main(void)
+{
+	test_vector();
+	test_sort();
+	test_arena();
+
+	// microbenchmarks
+	Vector<unsigned> v;
+	struct timespec start;
+	const double linear = push_linear(PUSHES);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned i = 0; i < PUSHES; i++)
+		v.push_back(i);
+	printf("%u pushes: %.2fms growing by 8, %.2fms doubling\n", PUSHES, linear * 1e3, seconds(&start) * 1e3);
+	bench_arena();
+
+	printf("%u container tests failed\n", failed);
+	return failed > 0;
+}
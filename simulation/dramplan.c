@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../platform/dramplan.h"
+#include "../library/base.h"
+
+#define GB (1ULL << 30)
+#define MB (1ULL << 20)
+#define ROUNDS 2000
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+static void setup(struct dram_plan *plan)
+{
+	memset(plan, 0, sizeof(*plan));
+	plan->map_granule = 128 * MB;
+	plan->align = 2 * GB;
+	plan->att_granule = 16 * GB;
+	plan->hole_base = 0xfd00000000ULL;
+	plan->hole_limit = 0x10000000000ULL;
+}
+
+// 1 to 4 DIMMs on each northbridge, with some lost to BIOS reservations or a failed rank
+static void populate(struct dram_plan_server *server)
+{
+	static const uint64_t dimms[] = {1 * GB, 2 * GB, 4 * GB, 8 * GB, 16 * GB, 32 * GB};
+
+	memset(server, 0, sizeof(*server));
+	server->nbs = 1 + rand() % PLAN_NBS;
+	server->limit = rand() % 4 ? ~0ULL : (1 + rand() % 256) * GB + (rand() % 1024) * MB;
+
+	for (unsigned i = 0; i < server->nbs; i++) {
+		const unsigned n = 1 + rand() % 4;
+		for (unsigned d = 0; d < n; d++)
+			server->detected[i] += dimms[rand() % (sizeof(dimms) / sizeof(dimms[0]))];
+
+		if (!(rand() % 3))
+			server->detected[i] -= (rand() % 64) * 16 * MB;
+	}
+}
+
+// as Opteron::init and Node::trim_dram_maps did: 2GB per northbridge, then 16MB at a time from the largest
+static uint64_t previous(const struct dram_plan_server *server)
+{
+	uint64_t size[PLAN_NBS], total = 0;
+
+	for (unsigned i = 0; i < server->nbs; i++) {
+		size[i] = server->detected[i] & ~(2 * GB - 1);
+		total += size[i];
+	}
+
+	int64_t over = max(total > server->limit ? total - server->limit : 0, total & (16 * GB - 1));
+	while (over > 0) {
+		unsigned largest = 0;
+		for (unsigned i = 1; i < server->nbs; i++)
+			if (size[i] > size[largest])
+				largest = i;
+
+		size[largest] -= 16 * MB;
+		total -= 16 * MB;
+		over -= 16 * MB;
+	}
+
+	return total;
+}
+
+int main(void)
+{
+	struct dram_plan plan;
+	struct dram_plan_server servers[32];
+	bool granular = 1, limited = 1, aligned = 1, placed = 1, hole = 1, accounted = 1, optimal = 1, better = 1, balanced = 1;
+	uint64_t gained = 0;
+
+	srand(1);
+
+	for (unsigned round = 0; round < ROUNDS; round++) {
+		const unsigned nservers = 1 + rand() % 32;
+		setup(&plan);
+		for (unsigned s = 0; s < nservers; s++)
+			populate(&servers[s]);
+
+		// the master's first northbridge spans 4GB, hoisting DRAM from under the MMIO hole
+		if (servers[0].detected[0] > 6 * GB && rand() % 2)
+			servers[0].hole = (1 + rand() % 32) * 64 * MB;
+
+		plan_dram(&plan, servers, nservers);
+
+		uint64_t usable = 0, lost = 0, detected = 0, last = 0;
+		for (unsigned s = 0; s < nservers; s++) {
+			const struct dram_plan_server *server = &servers[s];
+			uint64_t total = 0, sum = 0;
+
+			for (unsigned i = 0; i < server->nbs; i++) {
+				granular &= !(server->nb_size[i] % plan.map_granule) && server->nb_size[i] <= server->detected[i];
+				placed &= server->nb_base[i] == server->base + sum;
+				sum += server->nb_size[i];
+				total += server->detected[i] & ~(plan.map_granule - 1);
+				detected += server->detected[i];
+			}
+
+			// trimmed northbridges are within a granule of each other and no smaller than the rest
+			for (unsigned i = 0; i < server->nbs; i++)
+				if (server->nb_size[i] < (server->detected[i] & ~(plan.map_granule - 1)))
+					for (unsigned j = 0; j < server->nbs; j++)
+						balanced &= server->nb_size[j] <= server->nb_size[i] + plan.map_granule;
+
+			limited &= sum == server->size && server->size <= server->limit;
+			aligned &= !(server->size % plan.align) && !(server->base % plan.att_granule) && !((server->end + 1) % plan.att_granule);
+			placed &= server->base >= last && server->base + server->size <= server->end + 1;
+			hole &= server->base >= plan.hole_limit || server->base + server->size <= plan.hole_base;
+			optimal &= server->size == (min(total, server->limit & ~(plan.map_granule - 1)) & ~(plan.align - 1));
+			better &= server->size >= (previous(server) & ~(plan.align - 1));
+
+			gained += server->size - (previous(server) & ~(plan.align - 1));
+			usable += server->size;
+			lost += server->lost_map + server->lost_align + server->lost_limit;
+			last = server->end + 1;
+		}
+
+		accounted &= usable - servers[0].hole == plan.usable && usable + lost == detected && plan.top == last &&
+		  plan.lost_map + plan.lost_align + plan.lost_limit == lost;
+	}
+
+	check(granular, "northbridges are granular and within detected");
+	check(limited, "servers are within their limit");
+	check(aligned, "servers are aligned");
+	check(placed, "ranges are disjoint and increasing");
+	check(hole, "no memory in the HT decode range");
+	check(accounted, "losses account for all detected memory");
+	check(optimal, "usable memory is the most the constraints allow");
+	check(better, "no server has less than before, so aligned");
+	check(balanced, "trimming takes from the largest northbridges");
+	printf("%lluGB more usable over %u layouts\n", (unsigned long long)(gained / GB), ROUNDS);
+
+	// 3 northbridges of 20GB, 12GB and 9.5GB limited to 30GB keep 9.5GB, with the others levelled to 10.25GB
+	setup(&plan);
+	memset(&servers[0], 0, sizeof(servers[0]));
+	servers[0].nbs = 3;
+	servers[0].detected[0] = 20 * GB;
+	servers[0].detected[1] = 12 * GB;
+	servers[0].detected[2] = 9 * GB + 512 * MB;
+	servers[0].limit = 30 * GB;
+	plan_dram(&plan, servers, 1);
+	check(servers[0].size == 30 * GB && servers[0].nb_size[0] == 10 * GB + 256 * MB &&
+	  servers[0].nb_size[1] == 10 * GB + 256 * MB && servers[0].nb_size[2] == 9 * GB + 512 * MB, "limited server trims to a level");
+	check(servers[0].end == 32 * GB - 1 && plan.padding == 2 * GB, "end is padded to the ATT granule");
+
+	// hoisting across hole sizes, with the offset field as the BIOS sets it for a base of 0
+	bool hoisted = 1;
+	for (uint64_t hole = 16 * MB; hole <= 2 * GB; hole += 16 * MB) {
+		const uint64_t base = (1ULL << 32) - hole;
+		const uint32_t reg = (uint32_t)base | (uint32_t)(hole >> 23 << 7) | 3;
+
+		hoisted &= dram_hoisted(reg, 0, 32 * GB + hole - 1) == hole;
+		hoisted &= dram_hoisted(reg & ~1U, 0, 32 * GB + hole - 1) == 0;
+		hoisted &= dram_hoisted(reg, 0, base - 1) == 0;
+		hoisted &= dram_hoisted(reg, 4 * GB, 36 * GB - 1) == 0;
+		// a second northbridge starting within the hole only loses its part
+		hoisted &= dram_hoisted(reg, base + hole / 2, 16 * GB - 1) == hole / 2;
+	}
+	check(hoisted, "hoisted DRAM across hole sizes");
+
+	printf("%u DRAM plan tests failed\n", failed);
+	return failed > 0;
+}
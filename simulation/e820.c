@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../platform/e820.h"
+
+#define MAX 16384
+#define ROUNDS 2000
+#define INSERTS 4096
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+// E820::add as it was, inserting each entry with memmove then merging the whole map
+struct reference {
+	struct e820entry map[MAX];
+	unsigned used;
+
+	struct e820entry *position(const uint64_t addr)
+	{
+		unsigned i;
+		for (i = 0; i < used; i++)
+			if (addr < map[i].base + map[i].length)
+				break;
+		return &map[i];
+	}
+
+	void insert(struct e820entry *pos)
+	{
+		const int n = used - (pos - map);
+		if (n > 0)
+			memmove(pos + 1, pos, sizeof(*pos) * n);
+		used++;
+		xassert(used < MAX);
+	}
+
+	void remove(struct e820entry *start, struct e820entry *end)
+	{
+		const struct e820entry *last = map + used;
+		memmove(start, end, (size_t)last - (size_t)end);
+		used -= end - start;
+	}
+
+	static bool overlap(const uint64_t a1, const uint64_t a2, const uint64_t b1, const uint64_t b2)
+	{
+		return (a2 > b1 && a1 < b2) || (a1 <= b1 && a2 >= b2) || (a1 >= b1 && a2 <= b2);
+	}
+
+	// starts in a gap below an entry it overlaps, which add() splits at a negative length
+	bool straddles(const uint64_t base, const uint64_t length)
+	{
+		const struct e820entry *spos = position(base);
+		return spos < map + used && base < spos->base && base + length > spos->base;
+	}
+
+	void add(const uint64_t base, const uint64_t length, const uint32_t type)
+	{
+		struct e820entry *last = map + used;
+		struct e820entry *spos = position(base);
+
+		if (last > map && spos < last) {
+			if (overlap(base, base + length, spos->base, spos->base + spos->length) && base != spos->base) {
+				insert(spos);
+				spos++;
+				last++;
+				spos->base = base;
+				spos->length = (spos-1)->base + (spos-1)->length - base;
+				spos->type = (spos-1)->type;
+				(spos-1)->length = base - (spos-1)->base;
+			}
+		}
+
+		struct e820entry *epos = position(base + length);
+
+		if (last > map && epos < last) {
+			if (overlap(base, base + length, epos->base, epos->base + epos->length) && base + length != epos->base + epos->length) {
+				epos++;
+				insert(epos);
+				last++;
+				epos->type = (epos-1)->type;
+				epos->base = base + length;
+				epos->length = (epos-1)->base + (epos-1)->length - epos->base;
+				(epos-1)->length = base + length - (epos-1)->base;
+			}
+		}
+
+		remove(spos, epos);
+		insert(spos);
+		spos->base = base;
+		spos->length = length;
+		spos->type = type;
+
+		unsigned pos = used - 1;
+		while (pos > 0) {
+			struct e820entry *cur = map + pos;
+			struct e820entry *bef = cur - 1;
+
+			if (bef->base + bef->length == cur->base && bef->type == cur->type) {
+				cur->length += bef->length;
+				cur->base = bef->base;
+				remove(bef, cur);
+				continue;
+			}
+			pos--;
+		}
+	}
+};
+
+static struct reference ref;
+static struct e820entry map[MAX];
+static struct e820batch batch[MAX];
+
+// overlapping ranges on a coarse grid so edges often coincide
+static void random_entry(struct e820batch *entry, const unsigned seq, const uint64_t span)
+{
+	entry->base = (rand() % span) << 12;
+	entry->end = entry->base + ((1 + rand() % (span / 8)) << 12);
+	entry->type = 1 + rand() % 5;
+	entry->seq = seq;
+}
+
+static uint8_t pages[1 << 21];
+
+// each add painting its pages, the latest winning, then runs of a type as entries
+static unsigned paint(struct e820entry *out, const struct e820batch *entries, const unsigned n)
+{
+	uint64_t top = 0;
+	for (unsigned i = 0; i < n; i++)
+		top = max(top, entries[i].end >> 12);
+	xassert(top <= sizeof(pages));
+	memset(pages, 0, top);
+
+	for (unsigned i = 0; i < n; i++)
+		memset(&pages[entries[i].base >> 12], entries[i].type, (entries[i].end - entries[i].base) >> 12);
+
+	unsigned used = 0;
+	for (uint64_t page = 0; page < top; page++) {
+		if (!pages[page])
+			continue;
+		if (used && out[used - 1].base + out[used - 1].length == page << 12 && out[used - 1].type == pages[page]) {
+			out[used - 1].length += 1 << 12;
+			continue;
+		}
+		out[used].base = page << 12;
+		out[used].length = 1 << 12;
+		out[used].type = pages[page];
+		used++;
+	}
+
+	return used;
+}
+
+static bool same(const struct e820entry *a, const unsigned na, const struct e820entry *b, const unsigned nb)
+{
+	return na == nb && !memcmp(a, b, na * sizeof(*a));
+}
+
+static double seconds(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(void)
+{
+	static struct e820entry expected[MAX];
+	bool matches = 1, sorted = 1, merged = 1;
+	unsigned wrong = 0, unexplained = 0;
+	srand(1);
+
+	for (unsigned round = 0; round < ROUNDS; round++) {
+		const unsigned n = 1 + rand() % 64;
+		const uint64_t span = 16 << (rand() % 8);
+		ref.used = 0;
+		bool straddled = 0;
+
+		for (unsigned i = 0; i < n; i++) {
+			random_entry(&batch[i], i, span);
+			straddled |= ref.straddles(batch[i].base, batch[i].end - batch[i].base);
+			ref.add(batch[i].base, batch[i].end - batch[i].base, batch[i].type);
+		}
+
+		const unsigned nexpected = paint(expected, batch, n);
+		const unsigned used = e820_resolve(map, MAX, batch, n);
+		matches &= same(map, used, expected, nexpected);
+		const bool differs = !same(ref.map, ref.used, expected, nexpected);
+		wrong += differs;
+		unexplained += differs && !straddled;
+
+		for (unsigned i = 1; i < used; i++) {
+			sorted &= map[i].base >= map[i - 1].base + map[i - 1].length && map[i].length;
+			merged &= map[i].base != map[i - 1].base + map[i - 1].length || map[i].type != map[i - 1].type;
+		}
+	}
+
+	check(matches, "batch matches adds painted in order");
+	check(sorted, "entries are ordered and disjoint");
+	check(merged, "adjacent entries of a type are merged");
+	// both let the latest add win, so per-insert adds only differ where they mishandle a straddling range
+	check(!unexplained, "per-insert adds match unless a range straddles");
+	printf("per-insert adds differed in %u of %u rounds\n", wrong, ROUNDS);
+
+	// RAM, then reservations in it in random order, as per-northbridge tracing buffers on a large cluster
+	struct timespec start;
+	ref.used = 0;
+	batch[0].base = 0;
+	batch[0].end = (uint64_t)INSERTS << 21;
+	batch[0].type = E820::RAM;
+	batch[0].seq = 0;
+	for (unsigned i = 1; i < INSERTS; i++) {
+		batch[i].base = (uint64_t)i << 21;
+		batch[i].end = batch[i].base + (1 << 20);
+		batch[i].type = E820::RESERVED;
+		batch[i].seq = i;
+	}
+	for (unsigned i = INSERTS - 1; i > 1; i--) {
+		const unsigned j = 1 + rand() % i;
+		const struct e820batch temp = batch[i];
+		batch[i] = batch[j];
+		batch[j] = temp;
+		batch[i].seq = i;
+		batch[j].seq = j;
+	}
+	const unsigned nexpected = paint(expected, batch, INSERTS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned i = 0; i < INSERTS; i++)
+		ref.add(batch[i].base, batch[i].end - batch[i].base, batch[i].type);
+	const double before = seconds(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	const unsigned used = e820_resolve(map, MAX, batch, INSERTS);
+	const double after = seconds(&start);
+
+	check(same(map, used, expected, nexpected), "4096 batched inserts match");
+	printf("%u inserts to %u entries: %.2fus per insert, %.2fus per insert batched\n", INSERTS, used, before * 1e6 / INSERTS, after * 1e6 / INSERTS);
+
+	printf("%u E820 tests failed\n", failed);
+	return failed > 0;
+}
@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// search cabling plans for a given node count and emit the best as a fabric configuration
+
+#include "../numachip2/router.h"
+#include "../numachip2/verify.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define LC_PORTS (XBAR_PORTS - 1)
+#define MAX_CABLES (MAX_NODE * LC_PORTS / 2)
+#define MAX_PLANS 256
+#define ANNEAL_STEPS 4000
+
+struct cable {
+	nodeid_t a, b;
+	xbarid_t ap, bp;
+};
+
+struct plan {
+	char name[32];
+	unsigned seed; // random regular graph if non-zero
+	unsigned ncables;
+	struct cable cables[MAX_CABLES];
+
+	// scores
+	bool routed;
+	unsigned diameter, max_load, cycles;
+	unsigned fail_diameter; // worst diameter after losing any one cable; ~0U if it partitions
+	double avg_hops;
+};
+
+static unsigned servers, nvcs = 1, nplans;
+static struct plan *plans;
+static unsigned next_plan;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int out;
+
+static struct plan *add_plan(const char *name)
+{
+	xassert(nplans < MAX_PLANS);
+	struct plan *plan = &plans[nplans++];
+	snprintf(plan->name, sizeof(plan->name), "%s", name);
+	return plan;
+}
+
+static void add_cable(struct plan *plan, const nodeid_t a, const xbarid_t ap, const nodeid_t b, const xbarid_t bp)
+{
+	xassert(plan->ncables < MAX_CABLES);
+	plan->cables[plan->ncables++] = {a, b, ap, bp};
+}
+
+// x * y * z torus on port pairs A/B, C/D, E/F; dimensions of 2 would double-cable, so use a single cable
+static void torus(const unsigned x, const unsigned y, const unsigned z, const unsigned twist)
+{
+	char name[32];
+
+	if (z > 1)
+		snprintf(name, sizeof(name), "%ux%ux%u torus", x, y, z);
+	else if (twist)
+		snprintf(name, sizeof(name), "%ux%u torus twist %u", x, y, twist);
+	else if (y > 1)
+		snprintf(name, sizeof(name), "%ux%u torus", x, y);
+	else
+		snprintf(name, sizeof(name), "%u ring", x);
+
+	struct plan *plan = add_plan(name);
+	const unsigned dims[] = {x, y, z};
+
+	for (unsigned k = 0; k < z; k++) {
+		for (unsigned j = 0; j < y; j++) {
+			for (unsigned i = 0; i < x; i++) {
+				const unsigned pos[] = {i, j, k};
+				const nodeid_t node = (k * y + j) * x + i;
+
+				for (unsigned d = 0; d < 3; d++) {
+					if (dims[d] < 2 || (dims[d] == 2 && pos[d] == 1))
+						continue;
+
+					unsigned next[] = {i, j, k};
+					next[d] = (pos[d] + 1) % dims[d];
+
+					// twisted torus shifts X when the Y ring wraps
+					if (d == 1 && next[1] == 0)
+						next[0] = (i + twist) % x;
+
+					add_cable(plan, node, d * 2 + 1, (next[2] * y + next[1]) * x + next[0], d * 2 + 2);
+				}
+			}
+		}
+	}
+}
+
+// all-pairs hop counts by breadth-first search, skipping one cable; returns diameter, ~0U if partitioned
+static unsigned distances(const struct plan *plan, const unsigned skip, unsigned *total)
+{
+	nodeid_t *adj = (nodeid_t *)malloc(servers * LC_PORTS * sizeof(*adj));
+	unsigned *degree = (unsigned *)calloc(servers, sizeof(*degree));
+	unsigned *dist = (unsigned *)malloc(servers * sizeof(*dist));
+	nodeid_t *queue = (nodeid_t *)malloc(servers * sizeof(*queue));
+	xassert(adj && degree && dist && queue);
+
+	for (unsigned c = 0; c < plan->ncables; c++) {
+		if (c == skip)
+			continue;
+		const struct cable *cable = &plan->cables[c];
+		adj[cable->a * LC_PORTS + degree[cable->a]++] = cable->b;
+		adj[cable->b * LC_PORTS + degree[cable->b]++] = cable->a;
+	}
+
+	unsigned diameter = 0;
+	*total = 0;
+
+	for (nodeid_t src = 0; src < servers && diameter != ~0U; src++) {
+		memset(dist, 0xff, servers * sizeof(*dist));
+		unsigned head = 0, tail = 0;
+		dist[src] = 0;
+		queue[tail++] = src;
+
+		while (head < tail) {
+			const nodeid_t node = queue[head++];
+			for (unsigned e = 0; e < degree[node]; e++) {
+				const nodeid_t next = adj[node * LC_PORTS + e];
+				if (dist[next] == ~0U) {
+					dist[next] = dist[node] + 1;
+					queue[tail++] = next;
+				}
+			}
+		}
+
+		if (tail < servers)
+			diameter = ~0U;
+		else
+			for (nodeid_t dst = 0; dst < servers; dst++) {
+				diameter = max(diameter, dist[dst]);
+				*total += dist[dst];
+			}
+	}
+
+	free(adj);
+	free(degree);
+	free(dist);
+	free(queue);
+	return diameter;
+}
+
+static uint64_t cost(const struct plan *plan)
+{
+	unsigned total;
+	const unsigned diameter = distances(plan, ~0U, &total);
+	return diameter == ~0U ? ~0ULL : (uint64_t)diameter << 32 | total;
+}
+
+static bool connected(const struct plan *plan, const nodeid_t a, const nodeid_t b)
+{
+	for (unsigned c = 0; c < plan->ncables; c++)
+		if ((plan->cables[c].a == a && plan->cables[c].b == b) || (plan->cables[c].a == b && plan->cables[c].b == a))
+			return 1;
+	return 0;
+}
+
+// random regular graph by pairing port stubs, then annealed by swapping cable ends
+static void random_regular(struct plan *plan)
+{
+	unsigned degree = min(LC_PORTS, servers - 1);
+	if (servers * degree % 2)
+		degree--;
+
+	unsigned seed = plan->seed;
+	const unsigned nstubs = servers * degree;
+	nodeid_t *stubs = (nodeid_t *)malloc(nstubs * sizeof(*stubs));
+	xassert(stubs);
+
+	while (1) {
+		for (unsigned s = 0; s < nstubs; s++)
+			stubs[s] = s / degree;
+
+		for (unsigned s = nstubs - 1; s > 0; s--) {
+			const unsigned r = rand_r(&seed) % (s + 1);
+			const nodeid_t t = stubs[s];
+			stubs[s] = stubs[r];
+			stubs[r] = t;
+		}
+
+		plan->ncables = 0;
+		xbarid_t used[MAX_NODE] = {};
+		bool simple = 1;
+
+		for (unsigned s = 0; s < nstubs && simple; s += 2) {
+			const nodeid_t a = stubs[s], b = stubs[s + 1];
+			if (a == b || connected(plan, a, b))
+				simple = 0;
+			else
+				add_cable(plan, a, ++used[a], b, ++used[b]);
+		}
+
+		if (simple && cost(plan) != ~0ULL)
+			break;
+	}
+
+	free(stubs);
+
+	uint64_t current = cost(plan);
+	for (unsigned step = 0; step < ANNEAL_STEPS && plan->ncables > 1; step++) {
+		struct cable *x = &plan->cables[rand_r(&seed) % plan->ncables];
+		struct cable *y = &plan->cables[rand_r(&seed) % plan->ncables];
+		if (x == y || x->a == y->b || y->a == x->b || connected(plan, x->a, y->b) || connected(plan, y->a, x->b))
+			continue;
+
+		// a-b, c-d becomes a-d, c-b, keeping each end on its port
+		const struct cable ox = *x, oy = *y;
+		x->b = oy.b;
+		x->bp = oy.bp;
+		y->b = ox.b;
+		y->bp = ox.bp;
+
+		// accept worse plans with falling probability
+		const uint64_t next = cost(plan);
+		const unsigned temperature = ANNEAL_STEPS - step;
+		if (next <= current || (next >> 32 == current >> 32 && (unsigned)rand_r(&seed) % ANNEAL_STEPS < temperature / 8))
+			current = next;
+		else {
+			*x = ox;
+			*y = oy;
+		}
+	}
+}
+
+static void score(struct plan *plan)
+{
+	if (plan->seed)
+		random_regular(plan);
+
+	unsigned total;
+	plan->diameter = distances(plan, ~0U, &total);
+	if (plan->diameter == ~0U)
+		return;
+
+	plan->fail_diameter = 0;
+	for (unsigned c = 0; c < plan->ncables && plan->fail_diameter != ~0U; c++) {
+		unsigned t;
+		plan->fail_diameter = max(plan->fail_diameter, distances(plan, c, &t));
+	}
+
+	Router *router = new Router();
+	router->nvcs = nvcs;
+	for (unsigned c = 0; c < plan->ncables; c++)
+		router->connect(plan->cables[c].a, plan->cables[c].ap, plan->cables[c].b, plan->cables[c].bp);
+	router->run(servers);
+
+	RouteVerifier *verifier = new RouteVerifier(*router, servers);
+	verifier->run();
+
+	unsigned hops = 0;
+	for (nodeid_t src = 0; src < servers; src++)
+		for (nodeid_t dst = 0; dst < servers; dst++)
+			hops += router->dist[src][dst];
+
+	plan->diameter = 0;
+	for (nodeid_t src = 0; src < servers; src++)
+		for (nodeid_t dst = 0; dst < servers; dst++)
+			plan->diameter = max(plan->diameter, (unsigned)router->dist[src][dst]);
+
+	plan->avg_hops = servers > 1 ? (double)hops / (servers * (servers - 1)) : 0;
+	plan->max_load = verifier->max_load;
+	plan->cycles = verifier->cycles;
+	plan->routed = !verifier->errors;
+
+	delete verifier;
+	delete router;
+}
+
+static void *worker(void *)
+{
+	while (1) {
+		pthread_mutex_lock(&lock);
+		const unsigned p = next_plan++;
+		pthread_mutex_unlock(&lock);
+
+		if (p >= nplans)
+			return NULL;
+
+		score(&plans[p]);
+	}
+}
+
+// deadlock-free first, then survives a cable failure, then hops, link load and degraded diameter
+static bool better(const struct plan *a, const struct plan *b)
+{
+	if (a->routed != b->routed)
+		return a->routed;
+	if (!a->cycles != !b->cycles)
+		return !a->cycles;
+	if ((a->fail_diameter == ~0U) != (b->fail_diameter == ~0U))
+		return a->fail_diameter != ~0U;
+	if ((unsigned)(a->avg_hops * 100) != (unsigned)(b->avg_hops * 100))
+		return a->avg_hops < b->avg_hops;
+	if (a->max_load != b->max_load)
+		return a->max_load < b->max_load;
+	return a->fail_diameter < b->fail_diameter;
+}
+
+// node lines as parsed by Config::parse_node; each cable is described from both ends
+static void emit(const struct plan *plan, const char *filename, const char *prefix)
+{
+	FILE *f = fopen(filename, "w");
+	assertf(f, "Failed to open %s", filename);
+
+	fprintf(f, "# %s: %u nodes, diameter %u, average %.2f hops, max link load %u routes\n",
+	  plan->name, servers, plan->diameter, plan->avg_hops, plan->max_load);
+	fprintf(f, "# replace MAC addresses with those of the servers cabled in this order\n");
+	fprintf(f, "prefix=%s\n", prefix);
+	fprintf(f, "label=%s unified=true\n", prefix);
+
+	for (nodeid_t node = 0; node < servers; node++) {
+		fprintf(f, "suffix=%02u mac=00:00:00:00:%02x:%02x partition=1 ports=", node + 1, (node + 1) >> 8, (node + 1) & 0xff);
+
+		for (xbarid_t port = 1; port <= LC_PORTS; port++) {
+			const char *sep = port < LC_PORTS ? "," : "";
+			bool found = 0;
+
+			for (unsigned c = 0; c < plan->ncables && !found; c++) {
+				const struct cable *cable = &plan->cables[c];
+				if (cable->a == node && cable->ap == port) {
+					fprintf(f, "%02u%c%s", cable->b + 1, 'A' + cable->bp - 1, sep);
+					found = 1;
+				} else if (cable->b == node && cable->bp == port) {
+					fprintf(f, "%02u%c%s", cable->a + 1, 'A' + cable->ap - 1, sep);
+					found = 1;
+				}
+			}
+
+			if (!found)
+				fprintf(f, " %s", sep);
+		}
+
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-v vcs] [-t threads] [-r random-plans] [-o fabric.txt] [-p prefix] nodes\n", argv0);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned nthreads = sysconf(_SC_NPROCESSORS_ONLN), nrandom = 8;
+	const char *filename = "fabric.txt", *prefix = "node";
+	int opt;
+
+	while ((opt = getopt(argc, argv, "v:t:r:o:p:")) != -1) {
+		switch (opt) {
+		case 'v': nvcs = atoi(optarg); break;
+		case 't': nthreads = atoi(optarg); break;
+		case 'r': nrandom = atoi(optarg); break;
+		case 'o': filename = optarg; break;
+		case 'p': prefix = optarg; break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	servers = atoi(argv[optind]);
+	assertf(servers >= 2 && servers <= MAX_NODE, "Node count must be between 2 and %u\n", MAX_NODE);
+	assertf(nvcs >= 1 && nvcs <= MAX_VCS, "VCs must be between 1 and %u\n", MAX_VCS);
+	nthreads = max(nthreads, 1U);
+
+	plans = (struct plan *)calloc(MAX_PLANS, sizeof(*plans));
+	xassert(plans);
+
+	// rings, then every 2D and 3D factorisation
+	torus(servers, 1, 1, 0);
+	for (unsigned x = 2; x * x <= servers; x++) {
+		if (servers % x)
+			continue;
+
+		const unsigned y = servers / x;
+		torus(y, x, 1, 0);
+		for (unsigned twist = 1; twist < y && x > 2 && nplans < MAX_PLANS / 2; twist++)
+			torus(y, x, 1, twist);
+
+		for (unsigned a = 2; a * a <= y; a++)
+			if (y % a == 0 && a >= x)
+				torus(y / a, a, x, 0);
+	}
+
+	for (unsigned r = 0; r < nrandom && nplans < MAX_PLANS; r++) {
+		char name[32];
+		snprintf(name, sizeof(name), "random regular %u", r + 1);
+		add_plan(name)->seed = r + 1;
+	}
+
+	// router progress output would swamp the results
+	fflush(stdout);
+	out = dup(STDOUT_FILENO);
+	const int null = open("/dev/null", O_WRONLY);
+	xassert(out >= 0 && null >= 0);
+	dup2(null, STDOUT_FILENO);
+
+	dprintf(out, "Scoring %u plans for %u nodes with %u VCs on %u threads\n", nplans, servers, nvcs, nthreads);
+
+	pthread_t *threads = (pthread_t *)malloc(nthreads * sizeof(*threads));
+	xassert(threads);
+	for (unsigned t = 0; t < nthreads; t++)
+		xassert(!pthread_create(&threads[t], NULL, worker, NULL));
+	for (unsigned t = 0; t < nthreads; t++)
+		pthread_join(threads[t], NULL);
+
+	fflush(stdout);
+	dup2(out, STDOUT_FILENO);
+	close(null);
+
+	struct plan *best = NULL;
+	printf("%-24s %8s %9s %8s %7s %15s\n", "plan", "diameter", "avg hops", "max load", "cycles", "after 1 failure");
+	for (unsigned p = 0; p < nplans; p++) {
+		const struct plan *plan = &plans[p];
+		if (plan->diameter == ~0U) {
+			printf("%-24s partitioned\n", plan->name);
+			continue;
+		}
+
+		printf("%-24s %8u %9.2f %8u %7u ", plan->name, plan->diameter, plan->avg_hops, plan->max_load, plan->cycles);
+		if (plan->fail_diameter == ~0U)
+			printf("%15s\n", "partitioned");
+		else
+			printf("%6u diameter\n", plan->fail_diameter);
+
+		if (plan->routed && (!best || better(plan, best)))
+			best = &plans[p];
+	}
+
+	assertf(best, "No plan could be routed");
+	emit(best, filename, prefix);
+	printf("Best plan %s written to %s\n", best->name, filename);
+
+	free(threads);
+	free(plans);
+	return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../platform/hmat.h"
+#include "../platform/bench.h"
+#include "../library/base.h"
+
+#define SERVERS 4
+#define NBS 2
+#define DOMAINS (SERVERS * NBS)
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+// what an OS takes from the table
+struct decoded {
+	unsigned proximity, localities, caches;
+	bool lengths, initiators, lists;
+	uint32_t types[8];
+	uint64_t units[8];
+	uint64_t values[8][DOMAINS * DOMAINS]; // entries times base unit
+	uint16_t entries[8][DOMAINS * DOMAINS];
+	uint64_t cache_size[DOMAINS];
+	uint32_t cache_attributes[DOMAINS];
+};
+
+static void decode(struct decoded *out, const char *payload, const unsigned len)
+{
+	memset(out, 0, sizeof(*out));
+	out->lengths = out->initiators = out->lists = 1;
+	unsigned pos = sizeof(uint32_t);
+
+	while (pos + 8 <= len) {
+		const uint16_t type = *(const uint16_t *)(payload + pos);
+		const uint32_t length = *(const uint32_t *)(payload + pos + 4);
+		if (!length || pos + length > len) {
+			out->lengths = 0;
+			return;
+		}
+
+		switch (type) {
+		case HMAT_PROXIMITY: {
+			const struct acpi_hmat_proximity *prox = (const struct acpi_hmat_proximity *)(payload + pos);
+			out->lengths &= length == sizeof(*prox);
+			out->initiators &= (prox->flags & 1) && prox->initiator == prox->memory && prox->memory == out->proximity;
+			out->proximity++;
+			break;
+		}
+		case HMAT_LOCALITY: {
+			const struct acpi_hmat_locality *loc = (const struct acpi_hmat_locality *)(payload + pos);
+			const uint32_t *lists = (const uint32_t *)(loc + 1);
+			const uint16_t *entries = (const uint16_t *)(lists + loc->initiators + loc->targets);
+			const unsigned n = out->localities++;
+
+			out->lengths &= length == sizeof(*loc) + (loc->initiators + loc->targets) * 4 + loc->initiators * loc->targets * 2;
+			out->lists &= loc->initiators == DOMAINS && loc->targets == DOMAINS && !loc->flags;
+			for (unsigned i = 0; i < loc->initiators + loc->targets; i++)
+				out->lists &= lists[i] == i % DOMAINS;
+
+			out->types[n] = loc->data_type;
+			out->units[n] = loc->base_unit;
+			for (unsigned i = 0; i < loc->initiators * loc->targets; i++) {
+				out->entries[n][i] = entries[i];
+				out->values[n][i] = entries[i] * loc->base_unit;
+			}
+			break;
+		}
+		case HMAT_CACHE: {
+			const struct acpi_hmat_cache *cache = (const struct acpi_hmat_cache *)(payload + pos);
+			out->lengths &= length == sizeof(*cache) + cache->smbios_handles * 2 && cache->memory < DOMAINS;
+			out->cache_size[cache->memory] = cache->size;
+			out->cache_attributes[cache->memory] = cache->attributes;
+			out->caches++;
+			break;
+		}
+		default:
+			out->lengths = 0;
+			return;
+		}
+
+		pos += length;
+	}
+
+	out->lengths &= pos == len;
+}
+
+static bool near(const uint64_t decoded, const uint64_t value, const uint64_t unit)
+{
+	return decoded + unit / 2 + 1 >= value && decoded <= value + unit / 2 + 1;
+}
+
+// SLIT as the firmware builds it: BIOS distances within a server, fabric hops between
+static void distances(uint8_t *dist)
+{
+	for (unsigned s = 0; s < DOMAINS; s++)
+		for (unsigned d = 0; d < DOMAINS; d++)
+			dist[s * DOMAINS + d] = s == d ? 10 : s / NBS == d / NBS ? 16 : 70 + 20 * (1 + (s / NBS + d / NBS) % 2) + 16;
+}
+
+static void test_layout(void)
+{
+	static uint32_t latency[DOMAINS * DOMAINS], read[DOMAINS * DOMAINS], write[DOMAINS * DOMAINS];
+	static uint64_t ncache[DOMAINS];
+	static struct decoded dec;
+	uint8_t dist[DOMAINS * DOMAINS];
+
+	distances(dist);
+	hmat_model(latency, read, write, dist, DOMAINS);
+	for (unsigned d = 0; d < DOMAINS; d++)
+		ncache[d] = d < NBS ? 0 : 2ULL << 30; // as when the first server has no nCache
+
+	struct hmat_info info = {DOMAINS, latency, read, write, ncache};
+	const unsigned len = hmat_payload(NULL, &info);
+	char *payload = (char *)malloc(len + 16);
+	memset(payload, 0xa5, len + 16);
+	const unsigned written = hmat_payload(payload, &info);
+
+	check(written == len && len <= hmat_size(DOMAINS), "sizing pass matches");
+	check((unsigned char)payload[len] == 0xa5 && !*(uint32_t *)payload, "payload bounded");
+
+	decode(&dec, payload, len);
+	check(dec.lengths, "structure lengths walk the payload");
+	check(dec.proximity == DOMAINS && dec.initiators, "every domain its own initiator");
+	check(dec.localities == 3 && dec.lists, "three full locality matrices");
+	check(dec.types[0] == HMAT_ACCESS_LATENCY && dec.types[1] == HMAT_READ_BANDWIDTH && dec.types[2] == HMAT_WRITE_BANDWIDTH,
+	  "latency, read and write bandwidth");
+
+	bool ok = 1;
+	for (unsigned i = 0; i < DOMAINS * DOMAINS; i++) {
+		ok &= near(dec.values[0][i], latency[i] * 1000ULL, dec.units[0]);
+		ok &= near(dec.values[1][i], read[i], dec.units[1]);
+		ok &= near(dec.values[2][i], write[i], dec.units[2]);
+	}
+	check(ok, "entries decode to the matrices");
+
+	ok = dec.caches == DOMAINS - NBS;
+	for (unsigned d = 0; d < DOMAINS; d++) {
+		const uint32_t attr = dec.cache_attributes[d];
+		ok &= dec.cache_size[d] == ncache[d];
+		if (ncache[d])
+			ok &= (attr & 0xf) == 1 && ((attr >> 4) & 0xf) == 1 && ((attr >> 12) & 0xf) == 1 && (attr >> 16) == 64;
+	}
+	check(ok, "nCache as a memory-side cache");
+
+	// bandwidth too large for 16-bit entries in MB/s, and unmeasured pairs
+	for (unsigned i = 0; i < DOMAINS * DOMAINS; i++)
+		read[i] = i ? 40000 * (i % 7) : 250000;
+	hmat_payload(payload, &info);
+	decode(&dec, payload, len);
+	ok = dec.units[1] > 1;
+	for (unsigned i = 0; i < DOMAINS * DOMAINS; i++)
+		ok &= dec.entries[1][i] >= 1 && dec.entries[1][i] <= 0xfffe && (!read[i] || near(dec.values[1][i], read[i], dec.units[1]));
+	check(ok, "base unit scales, entries stay reachable");
+
+	free(payload);
+}
+
+static void test_model(void)
+{
+	static uint32_t latency[DOMAINS * DOMAINS], read[DOMAINS * DOMAINS], write[DOMAINS * DOMAINS];
+	uint8_t dist[DOMAINS * DOMAINS];
+
+	distances(dist);
+	hmat_model(latency, read, write, dist, DOMAINS);
+	check(latency[0] == HMAT_LOCAL_NS && read[0] == HMAT_LOCAL_MBPS, "model local figures");
+
+	bool ok = 1;
+	for (unsigned i = 0; i < DOMAINS * DOMAINS; i++)
+		for (unsigned j = 0; j < DOMAINS * DOMAINS; j++)
+			if (dist[i] < dist[j])
+				ok &= latency[i] < latency[j] && read[i] > read[j];
+	check(ok, "model follows distance");
+}
+
+static void test_measured(void)
+{
+	static uint32_t latency[DOMAINS * DOMAINS], read[DOMAINS * DOMAINS], write[DOMAINS * DOMAINS];
+	uint8_t dist[DOMAINS * DOMAINS];
+	unsigned server[DOMAINS];
+	struct bench_matrix *bench = (struct bench_matrix *)calloc(1, sizeof(*bench) + SERVERS * SERVERS * sizeof(struct bench_entry));
+
+	bench->magic = BENCH_MAGIC;
+	bench->nnodes = SERVERS;
+	for (unsigned s = 0; s < SERVERS; s++) {
+		for (unsigned d = 0; d < SERVERS; d++) {
+			struct bench_entry *e = &bench->entries[s * SERVERS + d];
+			e->latency = s == d ? 100 : 900 + 100 * ((s + d) % 2);
+			e->read = s == d ? 20000 : 3000 - s * 100;
+			e->write = s == d ? 16000 : 2500 - d * 100;
+		}
+	}
+
+	distances(dist);
+	for (unsigned d = 0; d < DOMAINS; d++)
+		server[d] = d / NBS;
+	hmat_measured(latency, read, write, dist, server, DOMAINS, bench);
+
+	bool local = 1, within = 1, across = 1;
+	for (unsigned i = 0; i < DOMAINS; i++) {
+		for (unsigned j = 0; j < DOMAINS; j++) {
+			const unsigned k = i * DOMAINS + j;
+			const struct bench_entry *e = &bench->entries[server[i] * SERVERS + server[j]];
+
+			if (i == j)
+				local &= latency[k] == e->latency && read[k] == e->read && write[k] == e->write;
+			else if (server[i] == server[j])
+				within &= latency[k] == e->latency * 16 / 10 && read[k] == e->read * 10 / 16 && write[k] == e->write * 10 / 16;
+			else
+				across &= latency[k] == e->latency && read[k] == e->read && write[k] == e->write;
+		}
+	}
+
+	check(local, "measured local figures");
+	check(within, "northbridges split by BIOS distance");
+	check(across, "measured server pairs");
+	free(bench);
+}
+
+int main(void)
+{
+	test_layout();
+	test_model();
+	test_measured();
+
+	printf("%u HMAT tests failed\n", failed);
+	return failed > 0;
+}
@@ -15,92 +15,288 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "../../library/base.h"
-#include <stdint.h>
+#include <stdio.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 
+#include "../../library/access.h"
+#include "../../library/utils.h"
+#include "../../library/trace.h"
+#include "../../opteron/msrs.h"
+#include "../../platform/config.h"
+#include "model.h"
+
+#define PCI_MMIO_CONF(bus, device, func, reg) \
+	(((bus) << 20) | ((device) << 15) | ((func) << 12) | (reg))
+
+extern "C" {
+	int lirq_nest = 0;
+}
+
+// SIM access layer; all accesses go to the host register-file model
 namespace lib
 {
-	void critical_enter(void) {};
-	void critical_leave(void) {};
+	void native_apic_icr_write(const uint32_t low, const uint32_t apicid)
+	{
+		sim::ipi(apicid, low);
+	}
+
+	void critical_enter(void)
+	{
+		cli();
+		const uint8_t val = pmio_read8(0x53);
+		pmio_write8(0x53, val | (1 << 3));
+	}
+
+	void critical_leave(void)
+	{
+		const uint8_t val = pmio_read8(0x53);
+		pmio_write8(0x53, val & ~(1 << 3));
+		sti();
+	}
+
+	void disable_xtpic(void)
+	{
+		outb(0xff, 0x21);
+		outb(0xff, 0xa1);
+	}
+
+	void enable_xtpic(void)
+	{
+	}
+
+	uint8_t rtc_read(const int addr)
+	{
+		outb(addr, 0x70);
+		return inb(0x71);
+	}
 
 	uint8_t pmio_read8(const uint16_t offset)
 	{
-		return 0x0;
+		outb(offset, 0xcd6);
+		return inb(0xcd7);
+	}
+
+	uint16_t pmio_read16(const uint16_t offset)
+	{
+		return pmio_read8(offset) | pmio_read8(offset + 1) << 8;
+	}
+
+	uint32_t pmio_read32(const uint16_t offset)
+	{
+		return pmio_read16(offset) | pmio_read16(offset + 2) << 16;
 	}
 
 	void pmio_write8(const uint16_t offset, const uint8_t val)
 	{
+		outw(offset | val << 8, 0xcd6);
+	}
+
+	void pmio_write16(const uint16_t offset, const uint16_t val)
+	{
+		pmio_write8(offset, val);
+		pmio_write8(offset + 1, val >> 8);
+	}
+
+	void pmio_write32(const uint16_t offset, const uint32_t val)
+	{
+		pmio_write16(offset, val);
+		pmio_write16(offset + 2, val >> 16);
 	}
 
 	uint8_t mem_read8(const uint64_t addr)
 	{
-		return 0x0;
+		return sim::mem_read(addr, 1);
 	}
 
 	uint16_t mem_read16(const uint64_t addr)
 	{
-		return 0x0;
+		xassert(!(addr & 1));
+		return sim::mem_read(addr, 2);
 	}
 
 	uint32_t mem_read32(const uint64_t addr)
 	{
-		return 0x0;
+		xassert(!(addr & 3));
+		return sim::mem_read(addr, 4);
 	}
 
 	uint64_t mem_read64(const uint64_t addr)
 	{
-		return 0x0;
+		xassert(!(addr & 7));
+		return sim::mem_read(addr, 8);
 	}
 
 	void mem_write8(const uint64_t addr, const uint8_t val)
 	{
+		sim::mem_write(addr, 1, val);
 	}
 
 	void mem_write16(const uint64_t addr, const uint16_t val)
 	{
+		xassert(!(addr & 1));
+		sim::mem_write(addr, 2, val);
 	}
 
 	void mem_write32(const uint64_t addr, const uint32_t val)
 	{
+		xassert(!(addr & 3));
+		sim::mem_write(addr, 4, val);
 	}
 
 	void mem_write64(const uint64_t addr, const uint64_t val)
 	{
+		xassert(!(addr & 7));
+		sim::mem_write(addr, 8, val);
+	}
+
+	// the window base is per core on hardware, but items don't pause mid-run
+	static uint64_t window;
+
+	void mem_window(const uint64_t base)
+	{
+		xassert(!(base & 7));
+		sim::wrmsr(MSR_FS_BASE, base);
+		window = base;
+	}
+
+	uint64_t window_read64(const uint32_t off)
+	{
+		return sim::mem_read(window + off, 8);
+	}
+
+	void window_write64(const uint32_t off, const uint64_t val)
+	{
+		sim::mem_write(window + off, 8, val);
+	}
+
+	uint32_t window_read32(const uint32_t off)
+	{
+		return sim::mem_read(window + off, 4);
+	}
+
+	void window_write32(const uint32_t off, const uint32_t val)
+	{
+		sim::mem_write(window + off, 4, val);
+	}
+
+	// emulated cores only switch when pausing, so read and write are indivisible
+	void window_xor32(const uint32_t off, const uint32_t val)
+	{
+		sim::mem_write(window + off, 4, sim::mem_read(window + off, 4) ^ val);
+	}
+
+	uint32_t window_xadd32(const uint32_t off, const uint32_t val)
+	{
+		const uint32_t old = sim::mem_read(window + off, 4);
+		sim::mem_write(window + off, 4, old + val);
+		return old;
+	}
+
+	// as on hardware, each access reads the MCFG MSR
+	static uint64_t mcfg_base(const sci_t sci)
+	{
+		uint64_t base = rdmsr(MSR_MCFG) & ~0xfffff;
+		if (base < (1ULL << 32)) {
+			xassert(sci == SCI_LOCAL || sci == config->local_node->id);
+			return base;
+		}
+
+		if (sci == SCI_LOCAL)
+			return base;
+
+		return (base & ~(0xfffULL << 28)) | ((uint64_t)sci << 28);
 	}
 
 	uint8_t mcfg_read8(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg)
 	{
-		return 0x0;
+		const uint8_t ret = mem_read8(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(1 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
+		return ret;
 	}
 
 	uint16_t mcfg_read16(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg)
 	{
-		return 0x0;
+		const uint16_t ret = mem_read16(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(2 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
+		return ret;
 	}
 
 	uint32_t mcfg_read32(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg)
 	{
-		return 0x0;
+		const uint32_t ret = mem_read32(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(4 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
+		return ret;
 	}
 
 	uint64_t mcfg_read64(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg)
 	{
-		return 0x0;
+		const uint64_t ret = mem_read64(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg));
+		trace_access(4 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg), ret);
+		trace_access(4 << 4, sci, PCI_MMIO_CONF(bus, dev, func, reg + 4), ret >> 32);
+		return ret;
 	}
 
 	void mcfg_write8(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg, const uint8_t val)
 	{
+		mem_write8(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((1 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
 	}
 
 	void mcfg_write16(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg, const uint16_t val)
 	{
+		mem_write16(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((2 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
 	}
 
 	void mcfg_write32(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg, const uint32_t val)
 	{
+		mem_write32(mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((4 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
 	}
 
 	void mcfg_write64_split(const sci_t sci, const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg, const uint64_t val)
 	{
+		const uint64_t addr = mcfg_base(sci) | PCI_MMIO_CONF(bus, dev, func, reg);
+		mem_write32(addr, val);
+		mem_write32(addr + 4, val >> 32);
+		trace_access((4 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg), val);
+		trace_access((4 << 4) | TRACE_WRITE, sci, PCI_MMIO_CONF(bus, dev, func, reg + 4), val >> 32);
+	}
+
+	uint32_t cf8_read32(const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg)
+	{
+		return mcfg_read32(SCI_LOCAL, bus, dev, func, reg);
+	}
+
+	void cf8_write32(const uint8_t bus, const uint8_t dev, const uint8_t func, const uint16_t reg, const uint32_t val)
+	{
+		mcfg_write32(SCI_LOCAL, bus, dev, func, reg, val);
+	}
+
+	void memcpy64(uint64_t dest, uint64_t src, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			mem_write8(dest + i, mem_read8(src + i));
+	}
+
+	uint64_t rdmsr(const msr_t msr)
+	{
+		return sim::rdmsr(msr);
+	}
+
+	void wrmsr(const msr_t msr, const uint64_t val)
+	{
+		sim::wrmsr(msr, val);
+	}
+
+	void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t *regs)
+	{
+		sim::cpuid(leaf, subleaf, regs);
+	}
+
+	uint64_t rdtscll(void)
+	{
+		return sim::now() * sim::tsc_mhz / 1000;
 	}
 }
@@ -17,32 +17,139 @@
 
 #include "../../platform/os.h"
 #include "../../platform/e820.h"
+#include "../../platform/trampoline.h"
+#include "../../platform/config.h"
+#include "../../library/profile.h"
+#include <stdio.h>
 #include <stdlib.h>
-#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
 
-OS::OS(void)
+#define UDP_SIG 0xdeafcafa
+#define UDP_QUEUE 64
+
+// same layout as the bootloader's synchronisation packet
+struct state_bcast {
+	uint32_t sig;
+	uint32_t state;
+	uint8_t mac[6];
+	uint8_t rsv[2];
+	uint32_t sci;
+	uint32_t tid;
+} __attribute__ ((packed));
+
+// followed by the sender's phase table
+static struct {
+	struct state_bcast rsp;
+	struct profile_table profile;
+} __attribute__ ((packed)) replies[UDP_QUEUE];
+static unsigned reply_head, reply_tail;
+static unsigned memmap_pos;
+
+// BIOS memory map of a 32GB server
+static const struct {
+	uint64_t base, length, type;
+} memmap[] = {
+	{0x0, 0x9fc00, E820::RAM},
+	{0x9fc00, 0x400, E820::RESERVED},
+	{0xe0000, 0x20000, E820::RESERVED},
+	{0x100000, 0xc0000000 - 0x100000, E820::RAM},
+	{0x100000000, 0x840000000 - 0x100000000, E820::RAM},
+};
+
+OS::OS(void): ent(0), hostname("sim")
+{
+	ip.s_addr = inet_addr("10.0.0.1");
+	const uint8_t sim_mac[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+	memcpy(mac, sim_mac, sizeof(mac));
+}
+
+void OS::udp_open(void)
 {
 }
 
-uint8_t *OS::read_file(const char *filename, size_t *const len)
+// each other server answers a command with the matching response as its emulated firmware would
+void OS::udp_write(const void *buf, const size_t len, uint32_t to_ip)
 {
-	return 0;
+	const struct state_bcast *cmd = (const struct state_bcast *)buf;
+	xassert(len >= sizeof(*cmd) && cmd->sig == UDP_SIG);
+
+	for (unsigned n = 0; n < config->nnodes; n++) {
+		if (&config->nodes[n] == config->local_node || reply_head - reply_tail == UDP_QUEUE)
+			continue;
+
+		struct state_bcast *rsp = &replies[reply_head % UDP_QUEUE].rsp;
+		// emulated servers share this process's phases
+		lib::profile_snapshot(&replies[reply_head++ % UDP_QUEUE].profile, config->nodes[n].id);
+		rsp->sig = UDP_SIG;
+		rsp->state = cmd->state + 1; // each command is followed by its success response
+		memcpy(rsp->mac, config->nodes[n].mac, sizeof(rsp->mac));
+		rsp->sci = config->nodes[n].id;
+		rsp->tid = cmd->tid;
+	}
+}
+
+int OS::udp_read(void *buf, const size_t len, uint32_t *from_ip)
+{
+	if (reply_head == reply_tail)
+		return 0;
+
+	xassert(len >= sizeof(replies[0]));
+	memcpy(buf, &replies[reply_tail++ % UDP_QUEUE], sizeof(replies[0]));
+	*from_ip = ip.s_addr;
+	return sizeof(replies[0]);
+}
+
+char *OS::read_file(const char *filename, size_t *const len)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	*len = ftell(f);
+	rewind(f);
+
+	char *buf = (char *)malloc(*len + 1);
+	xassert(buf);
+	xassert(fread(buf, 1, *len, f) == *len);
+	buf[*len] = '\0';
+	fclose(f);
+	return buf;
 }
 
 void OS::exec(const char *label)
 {
+	printf("Booting label %s\n", label);
 	exit(0);
 }
 
+static const struct e820entry *handler_map; // once E820 has installed its int15h handler
+static unsigned handler_used;
+
 void OS::memmap_start(void)
 {
+	memmap_pos = 0;
+	handler_used = asm_relocated ? *REL16(new_e820_len) : 0;
+	handler_map = (const struct e820entry *)REL32(new_e820_map);
 }
 
 bool OS::memmap_entry(uint64_t *base, uint64_t *length, uint64_t *type)
 {
-	*base = 0x0;
-	*length = 128ULL << 30;
-	*type = E820::RAM;
+	if (handler_used) {
+		*base = handler_map[memmap_pos].base;
+		*length = handler_map[memmap_pos].length;
+		*type = handler_map[memmap_pos].type;
+		return ++memmap_pos < handler_used;
+	}
+
+	*base = memmap[memmap_pos].base;
+	*length = memmap[memmap_pos].length;
+	*type = memmap[memmap_pos].type;
 
-	return 0;
+	return ++memmap_pos < sizeof(memmap) / sizeof(memmap[0]);
+}
+
+void OS::cleanup(void)
+{
 }
@@ -0,0 +1,1349 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include "model.h"
+#include "../../library/base.h"
+#include "../../library/access.h"
+#include "../../library/utils.h"
+#include "../../library/trace.h"
+#include "../../opteron/opteron.h"
+#include "../../opteron/msrs.h"
+#include "../../numachip2/numachip.h"
+#include "../../numachip2/lc.h"
+#include "../../numachip2/spi.h"
+#include "../../platform/config.h"
+#include "../../node.h"
+#include "../../platform/trampoline.h"
+
+#define PCI_MMIO_CONF(bus, device, func, reg) \
+	(((bus) << 20) | ((device) << 15) | ((func) << 12) | (reg))
+
+#define LOW_SIZE    (1 << 20)
+#define ACPI_BASE   0x3f000000
+#define ACPI_SIZE   (1 << 20)
+#define APIC_BASE   0xfee00000
+#define APIC_SIZE   4096
+#define MCFG_LOCAL  0xe0000000ULL
+#define MCFG_SIZE   (1ULL << 28)
+#define REMOTE_DRAM (32ULL << 30)
+
+#define DEV_SR5690  0
+#define DEV_SP5100  0x14
+#define DEV_OPTERON 24
+#define DEV_NC2     25
+
+#define MAX_PHASES  64
+#define MAX_EVENTS  16
+#define MAX_CORES   64
+#define CORE_STACK  (64 << 10)
+
+// from library/sched.c
+extern "C" void sched_switch(uintptr_t *from, const uintptr_t to);
+
+namespace sim
+{
+	// open-addressed hash of 64-bit keys to 64-bit values
+	struct table {
+		uint64_t *keys, *vals;
+		unsigned mask, used;
+	};
+
+	static const uint64_t EMPTY = ~0ULL;
+
+	static void table_init(struct table *t, const unsigned size)
+	{
+		t->keys = (uint64_t *)malloc(size * sizeof(uint64_t));
+		t->vals = (uint64_t *)malloc(size * sizeof(uint64_t));
+		xassert(t->keys && t->vals);
+		memset(t->keys, 0xff, size * sizeof(uint64_t));
+		t->mask = size - 1;
+		t->used = 0;
+	}
+
+	static unsigned table_slot(const struct table *t, const uint64_t key)
+	{
+		unsigned slot = lib::hash64(key) & t->mask;
+
+		while (t->keys[slot] != EMPTY && t->keys[slot] != key)
+			slot = (slot + 1) & t->mask;
+		return slot;
+	}
+
+	static bool table_get(const struct table *t, const uint64_t key, uint64_t *val)
+	{
+		const unsigned slot = table_slot(t, key);
+		if (t->keys[slot] == EMPTY)
+			return 0;
+
+		*val = t->vals[slot];
+		return 1;
+	}
+
+	static void table_put(struct table *t, const uint64_t key, const uint64_t val)
+	{
+		// grow at 50% load
+		if (t->used * 2 >= t->mask) {
+			struct table old = *t;
+			table_init(t, (old.mask + 1) * 2);
+			for (unsigned i = 0; i <= old.mask; i++)
+				if (old.keys[i] != EMPTY)
+					table_put(t, old.keys[i], old.vals[i]);
+			free(old.keys);
+			free(old.vals);
+		}
+
+		const unsigned slot = table_slot(t, key);
+		if (t->keys[slot] == EMPTY) {
+			t->keys[slot] = key;
+			t->used++;
+		}
+		t->vals[slot] = val;
+	}
+
+	// one simulated server: Opteron, IO hub and Numachip2 config space plus the Numachip2 I2C/SPI devices
+	struct server {
+		sci_t sci;
+		struct table regs;
+		uint8_t eeprom[64 << 10];
+		uint8_t spd[256];
+
+		// SPI engine
+		uint8_t spi_ctrl, spi_cmd, spi_rx[8];
+		unsigned spi_count, spi_rx_head, spi_rx_tail;
+		uint16_t spi_addr;
+		bool spi_wel;
+
+		// I2C engine
+		uint8_t i2c_tx, i2c_rx, i2c_status, i2c_dev, i2c_ptr;
+		bool i2c_write_mode, i2c_ptr_set;
+
+		uint32_t pllctl;
+		uint64_t link_ready[LC5::LINKS];
+		uint64_t bist_start, bist_done, clear_done;
+		bool dram_ready; // nCache DIMM zeroing seen to complete
+	};
+
+	// per-phase accounting
+	struct phase {
+		void *fn;
+		unsigned calls;
+		uint64_t ops[OPS];
+		uint64_t ns;
+	};
+
+	struct event {
+		uint64_t due;
+		bool used;
+	};
+
+	static uint64_t clock;
+	static struct server *local, *servers[4096];
+	static sci_t local_sci = SCI_LOCAL;
+	static struct table msrs, ram;
+	static uint8_t pmio[256], cmos[128], cmos_index, pic[2];
+
+	static struct phase phases[MAX_PHASES + 2];
+	static unsigned nphases;
+	static struct phase *current;
+	static void *main_fn;
+	static unsigned depth;
+
+	static struct event events[MAX_EVENTS];
+	static unsigned testing;
+
+	// cores taking work items, each on its own host stack and clock, stepped from the BSP between their pauses
+	struct core {
+		uint64_t clock;
+		uintptr_t sp;
+		uintptr_t *stack;
+		sci_t sci; // from the global APIC ID; local IDs are the master's
+		bool done;
+	};
+
+	static struct core cores[MAX_CORES];
+	static struct core *running; // else the BSP
+	static uintptr_t bsp_sp;
+
+	uint64_t now(void)
+	{
+		return clock;
+	}
+
+	// cores' operations count in the BSP's phase, but not their time
+	static void account(const enum op op)
+	{
+		clock += op_ns[op];
+		current->ops[op]++;
+		if (!running)
+			current->ns += op_ns[op];
+	}
+
+	// AP events: decrement the trampoline semaphore as the emulated core would
+	static void schedule(const uint64_t ns)
+	{
+		for (unsigned i = 0; i < MAX_EVENTS; i++) {
+			if (!events[i].used) {
+				events[i].due = clock + ns;
+				events[i].used = 1;
+				return;
+			}
+		}
+
+		fatal("AP event queue full");
+	}
+
+	static void process(void)
+	{
+		for (unsigned i = 0; i < MAX_EVENTS; i++) {
+			if (events[i].used && events[i].due <= clock) {
+				events[i].used = 0;
+				(*REL16(pending))--;
+			}
+		}
+
+		if (testing && *REL32(vector) == VECTOR_TEST_FINISH) {
+			*REL16(pending) -= testing;
+			testing = 0;
+		}
+	}
+
+	void delay(const uint64_t ns)
+	{
+		clock += ns;
+		if (running)
+			return;
+
+		current->ns += ns;
+		process();
+	}
+
+	// the trampoline's work vector, then the semaphore post
+	static void core_entry(void)
+	{
+		void (*fn)(void *) = (void (*)(void *))(uintptr_t)*REL32(work_fn);
+		fn((void *)(uintptr_t)*REL32(work_arg));
+		(*REL16(pending))--;
+
+		running->done = 1;
+		sched_switch(&running->sp, bsp_sp);
+		fatal("Finished core resumed");
+	}
+
+	static void core_start(const uint32_t apicid)
+	{
+		struct core *core = cores;
+		while (core->stack) {
+			assertf(++core < &cores[MAX_CORES], "Too many emulated cores");
+		}
+
+		// as sched.c, the first switch pops zeroed registers then returns into core_entry
+		core->stack = (uintptr_t *)zalloc(CORE_STACK);
+		uintptr_t *sp = (uintptr_t *)((uintptr_t)core->stack + CORE_STACK);
+		*--sp = 0;
+		*--sp = (uintptr_t)core_entry;
+		sp -= 6;
+		core->sp = (uintptr_t)sp;
+		core->clock = clock + 20000; // INIT-SIPI to the trampoline
+		core->sci = apicid >> 8;
+		core->done = 0;
+	}
+
+	// step cores up to the BSP's clock, earliest first
+	static void cores_run(void)
+	{
+		while (1) {
+			struct core *next = NULL;
+			for (struct core *core = cores; core < &cores[MAX_CORES]; core++)
+				if (core->stack && (!next || core->clock < next->clock))
+					next = core;
+
+			if (!next || next->clock > clock)
+				return;
+
+			const uint64_t bsp_clock = clock;
+			clock = next->clock;
+			running = next;
+			sched_switch(&bsp_sp, next->sp);
+			next->clock = clock;
+			running = NULL;
+			clock = bsp_clock;
+
+			if (next->done) {
+				free(next->stack);
+				next->stack = NULL;
+			}
+		}
+	}
+
+	void ipi(const uint32_t apicid, const uint32_t low)
+	{
+		if ((low & APIC_DM_FIXED_MASK) != APIC_DM_STARTUP)
+			return;
+
+		switch (*REL32(vector)) {
+		case VECTOR_TEST:
+			// cores stay in the test loop until the finish vector
+			(*REL16(pending))--;
+			testing++;
+			break;
+		case VECTOR_SETUP:
+		case VECTOR_SETUP_OBSERVER:
+			schedule(50000);
+			break;
+		case VECTOR_WORK:
+			core_start(apicid);
+			break;
+		default:
+			schedule(20000);
+		}
+	}
+
+	static void spd_crc(uint8_t *spd)
+	{
+		int crc = 0;
+
+		for (unsigned i = 0; i < 117; i++) {
+			crc = crc ^ (int)(signed char)spd[i] << 8;
+			for (unsigned bit = 0; bit < 8; bit++)
+				crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+		}
+
+		spd[126] = crc & 0xff;
+		spd[127] = (crc >> 8) & 0xff;
+	}
+
+	static uint32_t key(const unsigned dev, const unsigned func, const reg_t reg)
+	{
+		return PCI_MMIO_CONF(0, dev, func, reg);
+	}
+
+	static void seed(struct server *s, const unsigned dev, const reg_t reg, const uint32_t val)
+	{
+		table_put(&s->regs, key(dev, reg >> 12, reg & 0xfff), val);
+	}
+
+	static struct server *server_new(const sci_t sci)
+	{
+		struct server *s = (struct server *)calloc(1, sizeof(*s));
+		xassert(s);
+		s->sci = sci;
+		s->dram_ready = 1; // emulated servers' firmware has waited
+		table_init(&s->regs, 4096);
+
+		// Fam15h Opteron, 32GB with the 3-4GB hole hoisted above 4GB
+		for (unsigned func = 0; func < 6; func++)
+			seed(s, DEV_OPTERON, func << 12, ((0x1600 + func) << 16) | 0x1022);
+		seed(s, DEV_OPTERON, Opteron::HT_NODE_ID, 1 << 4);
+		seed(s, DEV_OPTERON, Opteron::LINK_TYPE, 3);
+		seed(s, DEV_OPTERON, Opteron::LINK_FREQ_REV, 0x900);
+		seed(s, DEV_OPTERON, Opteron::LINK_EXT_CTRL, 9);
+		seed(s, DEV_OPTERON, Opteron::LINK_RETRY, 1);
+		seed(s, DEV_OPTERON, Opteron::LINK_INIT_STATUS, (1U << 31) | (1 << 1));
+		seed(s, DEV_OPTERON, Opteron::DRAM_MAP_BASE, 3);
+		seed(s, DEV_OPTERON, Opteron::DRAM_MAP_LIMIT, (uint32_t)(((33ULL << 30) >> 24) - 1) << 16);
+		seed(s, DEV_OPTERON, Opteron::DRAM_HOLE, 0xc0004001);
+		seed(s, DEV_OPTERON, Opteron::DRAM_LIMIT, ((33ULL << 30) >> 27) - 1);
+		for (unsigned cs = 0; cs < 4; cs++)
+			seed(s, DEV_OPTERON, Opteron::DRAM_CS_BASE + cs * 4, 1);
+		seed(s, DEV_OPTERON, Opteron::NB_CPUID, 0x00600f20);
+		seed(s, DEV_OPTERON, Opteron::NB_CAP_2, 7);
+		seed(s, DEV_OPTERON, Opteron::NB_PSTATE_0, 0x0e);
+
+		// MMIO ranges the BIOS routes to the IOH: VGA, TOPMEM to MCFG, and above MCFG
+		const struct {uint32_t base, limit;} mmio[] = {
+			{Opteron::MMIO_VGA_BASE, Opteron::MMIO_VGA_LIMIT}, {0xc0000000, 0xdfffffff}, {0xf1000000, 0xffffffff}};
+		for (unsigned range = 0; range < sizeof(mmio) / sizeof(mmio[0]); range++) {
+			seed(s, DEV_OPTERON, Opteron::MMIO_MAP_BASE + range * 8, ((mmio[range].base >> 16) << 8) | 3);
+			seed(s, DEV_OPTERON, Opteron::MMIO_MAP_LIMIT + range * 8, (mmio[range].limit >> 16) << 8);
+		}
+
+		seed(s, DEV_SR5690, 0, 0x5a101002);
+		seed(s, DEV_SP5100, 0, 0x43851002);
+
+		for (unsigned func = 0; func < 4; func++)
+			seed(s, DEV_NC2, func << 12, Numachip2::VENDEV_NC2);
+		seed(s, DEV_NC2, Numachip2::LINK_CTRL, 0x11110000);
+		seed(s, DEV_NC2, Numachip2::LINK_FREQ_REV, 0x02750900);
+		seed(s, DEV_NC2, Numachip2::FLASH_REG0, 0xa0000000);
+		seed(s, DEV_NC2, Numachip2::SIU_NODEID, sci == SCI_LOCAL ? 0 : sci);
+		// slaves wait to be released by the master
+		if (sci != SCI_LOCAL)
+			seed(s, DEV_NC2, Numachip2::INFO, 1 << 29);
+
+		s->pllctl = 0x3f;
+
+		// image and board information
+		memset(s->eeprom, 0xff, sizeof(s->eeprom));
+		struct spi_image_info *image = (struct spi_image_info *)&s->eeprom[SPI_IMAGE_INFO_BASE];
+		memset(image, 0, sizeof(*image));
+		strcpy(image->name, "sim");
+		struct spi_board_info *board = (struct spi_board_info *)&s->eeprom[SPI_BOARD_INFO_BASE];
+		memcpy(board->part_no, "N3232", 6);
+		memcpy(board->pcb_type, "SIM", 4);
+		board->pcb_rev = 'A';
+		board->eco_level = '0';
+		board->model = 'S';
+		snprintf(board->serial_no, sizeof(board->serial_no), "%03x", sci & 0xfff);
+
+		// 8GB registered DDR3 module
+		s->spd[0] = 0x92;
+		s->spd[1] = 0x10;
+		s->spd[2] = 0x0b;
+		s->spd[3] = 2;
+		s->spd[4] = 0x04;
+		s->spd[7] = 0x09;
+		strcpy((char *)&s->spd[128], "SIMDIMM");
+		spd_crc(s->spd);
+
+		return s;
+	}
+
+	// config space of a server, or none if absent from the fabric
+	static struct server *server(const sci_t sci)
+	{
+		if (sci == local_sci)
+			return local;
+
+		if (servers[sci])
+			return servers[sci];
+
+		for (unsigned n = 0; config && n < config->nnodes; n++)
+			if (config->nodes[n].id == sci)
+				return servers[sci] = server_new(sci);
+
+		return NULL;
+	}
+
+	static uint32_t generic_read(const struct server *s, const uint64_t k)
+	{
+		uint64_t val;
+		return table_get(&s->regs, k, &val) ? (uint32_t)val : 0;
+	}
+
+	static uint8_t spi_xfer(struct server *s, const uint8_t tx)
+	{
+		const unsigned pos = s->spi_count++;
+
+		if (pos == 0) {
+			s->spi_cmd = tx;
+			if (tx == 6) // WREN
+				s->spi_wel = 1;
+			return 0xff;
+		}
+
+		switch (s->spi_cmd) {
+		case 5: // RDSR
+			return s->spi_wel << 1;
+		case 3: // READ
+		case 2: // WRITE
+			if (pos < 3) {
+				s->spi_addr = (s->spi_addr << 8) | tx;
+				return 0xff;
+			}
+
+			if (s->spi_cmd == 3)
+				return s->eeprom[s->spi_addr++];
+
+			if (s->spi_wel)
+				s->eeprom[s->spi_addr++] = tx;
+			return 0xff;
+		}
+
+		return 0xff;
+	}
+
+	static uint8_t *i2c_device(struct server *s, const uint8_t dev)
+	{
+		static uint8_t temp[256];
+		temp[5] = 0x02; // 40C
+		temp[6] = 0x80;
+
+		if (dev == 0x50)
+			return s->spd;
+		if (dev == 0x18)
+			return temp;
+		return NULL;
+	}
+
+	static void i2c_command(struct server *s, const uint8_t cmd)
+	{
+		if (cmd & (1 << 7)) { // START
+			s->i2c_dev = s->i2c_tx >> 1;
+			s->i2c_write_mode = !(s->i2c_tx & 1);
+			s->i2c_ptr_set = 0;
+			s->i2c_status = i2c_device(s, s->i2c_dev) ? 0 : (1 << 7);
+		} else if (cmd & (1 << 4)) { // WRITE
+			if (s->i2c_write_mode && !s->i2c_ptr_set) {
+				s->i2c_ptr = s->i2c_tx;
+				s->i2c_ptr_set = 1;
+			}
+		} else if (cmd & (1 << 5)) { // READ
+			uint8_t *dev = i2c_device(s, s->i2c_dev);
+			s->i2c_rx = dev ? dev[s->i2c_ptr++] : 0xff;
+		}
+
+		if (cmd & 0xfe)
+			s->i2c_status |= 1; // IRQ
+		else
+			s->i2c_status &= ~1;
+	}
+
+	static uint32_t nc2_read(struct server *s, const reg_t reg, const uint64_t k)
+	{
+		uint32_t val;
+
+		switch (reg) {
+		case Numachip2::I2C_REG0:
+			return (generic_read(s, k) & 0xffffff) | (uint32_t)s->i2c_rx << 24;
+		case Numachip2::I2C_REG1:
+			return s->i2c_status;
+		case Numachip2::SPI_REG0:
+			val = s->spi_ctrl | (s->spi_rx_head == s->spi_rx_tail) << 16;
+			return val;
+		case Numachip2::SPI_REG1:
+			if (s->spi_rx_head == s->spi_rx_tail)
+				return 0;
+			return s->spi_rx[s->spi_rx_tail++ % sizeof(s->spi_rx)];
+		case Numachip2::IMG_PROP_DATA: {
+			const uint32_t index = generic_read(s, key(DEV_NC2, Numachip2::IMG_PROP_ADDR >> 12, Numachip2::IMG_PROP_ADDR & 0xfff));
+			const char build[] = "2014-01-01 00:00";
+			if (index < Numachip2::IMG_PROP_STRING || index >= Numachip2::IMG_PROP_STRING + 4)
+				return 0;
+
+			// stored last byte first
+			const unsigned word = Numachip2::IMG_PROP_STRING + 3 - index;
+			uint32_t w;
+			memcpy(&w, build + word * 4, sizeof(w));
+			return lib::bswap32(w);
+		}
+		case Numachip2::IMG_PROP_TEMP:
+			return 128 + 45;
+		case Numachip2::HSS_PLLCTL:
+			return 0x07050000 | s->pllctl;
+		case Numachip2::MCTR_PHY_STATUS:
+			return 1 << 24;
+		case Numachip2::MCTR_BIST_CTRL:
+			val = generic_read(s, k) & ~1;
+			if (clock < s->bist_done)
+				val |= 1;
+			else if (val & (1 << 12))
+				s->dram_ready = 1;
+			return val | (3 << 9);
+		case Numachip2::MCTR_BIST_ADDR: {
+			// 64-bit words covered so far
+			const uint64_t words = 1ULL << ((generic_read(s, key(DEV_NC2, Numachip2::MCTR_BIST_CTRL >> 12, Numachip2::MCTR_BIST_CTRL & 0xfff)) >> 3) & 0x3f);
+			if (clock >= s->bist_done)
+				return words;
+			return words * (clock - s->bist_start) / (s->bist_done - s->bist_start);
+		}
+		case Numachip2::MCTR_ECC_STATUS:
+		case Numachip2::SIU_EVENTSTAT:
+			return 0;
+		}
+
+		if (reg >= Numachip2::PE_CTRL && reg < Numachip2::PE_CTRL + Numachip2::PE_UNITS * Numachip2::PE_OFFSET &&
+		  (reg & (Numachip2::PE_OFFSET - 1)) == (Numachip2::PE_STATUS & (Numachip2::PE_OFFSET - 1)))
+			return 1U << 31;
+
+		if (reg >= LC5::ROUTE_CHUNK && reg < LC5::ROUTE_CHUNK + LC5::LINKS * LC5::SIZE) {
+			const unsigned link = (reg - LC5::ROUTE_CHUNK) / LC5::SIZE;
+			const reg_t off = reg - link * LC5::SIZE;
+
+			if (off == LC5::LINKSTAT)
+				return (!(s->pllctl & (1 << link)) && clock >= s->link_ready[link]) << 31;
+			if (off == LC5::EVENTSTAT)
+				return 0;
+		}
+
+		return generic_read(s, k);
+	}
+
+	// the nCache and tags live in the nCache DIMM, so mustn't be set up, nor remote memory shared, until it's zeroed
+	static bool dram_dependent(const reg_t reg)
+	{
+		return (reg >= Numachip2::MTAG_BASE && reg <= Numachip2::NCACHE_CTRL) ||
+		  reg == Numachip2::DRAM_SHARED_BASE || reg == Numachip2::DRAM_SHARED_LIMIT;
+	}
+
+	static void nc2_write(struct server *s, const reg_t reg, const uint64_t k, const uint32_t val, const uint32_t mask)
+	{
+		assertf(s->dram_ready || !dram_dependent(reg), "%03x register 0x%x written before nCache DIMM zeroing was seen to complete",
+		  s->sci, reg);
+
+		switch (reg) {
+		case Numachip2::I2C_REG0:
+			if (mask & 0xff000000)
+				s->i2c_tx = val >> 24;
+			break;
+		case Numachip2::I2C_REG1:
+			if (mask & 0xff)
+				i2c_command(s, val);
+			return;
+		case Numachip2::SPI_REG0:
+			if (mask & 0xff) {
+				// deasserting chip enable ends the transaction
+				if ((s->spi_ctrl & 0x40) && !(val & 0x40)) {
+					s->spi_count = 0;
+					if (s->spi_cmd != 6)
+						s->spi_wel = 0;
+				}
+				s->spi_ctrl = val;
+			}
+			return;
+		case Numachip2::SPI_REG1:
+			if (mask & 0xff)
+				s->spi_rx[s->spi_rx_head++ % sizeof(s->spi_rx)] = spi_xfer(s, val);
+			return;
+		case Numachip2::HSS_PLLCTL:
+			for (unsigned link = 0; link < LC5::LINKS; link++)
+				if ((s->pllctl & (1 << link)) && !(val & (1 << link)))
+					s->link_ready[link] = clock + 50000000;
+			s->pllctl = val & 0x3f;
+			return;
+		case Numachip2::MCTR_BIST_CTRL:
+			// zeroing or testing the nCache DIMM
+			if (val & 1) {
+				s->bist_start = clock;
+				s->bist_done = clock + 2000000000ULL;
+				if (val & (1 << 12))
+					s->dram_ready = 0;
+			}
+			break;
+		case Numachip2::INFO:
+			// the emulated slave acknowledges the master's release
+			if (s != local && val == 3U << 29) {
+				table_put(&s->regs, k, 7U << 29);
+				return;
+			}
+			break;
+		}
+
+		if (reg >= LC5::ROUTE_CHUNK && reg < LC5::ROUTE_CHUNK + LC5::LINKS * LC5::SIZE) {
+			const reg_t off = (reg - LC5::ROUTE_CHUNK) % LC5::SIZE + LC5::ROUTE_CHUNK;
+			if (off == LC5::LINKSTAT || off == LC5::EVENTSTAT)
+				return; // write 1 to clear
+		}
+
+		table_put(&s->regs, k, (generic_read(s, k) & ~mask) | (val & mask));
+	}
+
+	static uint32_t opteron_read(struct server *s, const reg_t reg, const uint64_t k)
+	{
+		uint32_t val = generic_read(s, k);
+
+		if (reg == Opteron::MCTL_SEL_LOW) {
+			val &= ~(1 << 9);
+			if (clock < s->clear_done)
+				val |= 1 << 9;
+		}
+
+		// link phy accesses complete immediately
+		if (reg >= Opteron::LINK_PHY_OFFSET && reg < Opteron::LINK_PHY_OFFSET + 4 * 8 && !(reg & 4))
+			val |= 1U << 31;
+
+		return val;
+	}
+
+	static void opteron_write(struct server *s, const reg_t reg, const uint64_t k, const uint32_t val, const uint32_t mask)
+	{
+		switch (reg) {
+		case Opteron::MCTL_SEL_LOW:
+			// clearing 32GB at roughly 10GB/s
+			if (val & (1 << 3))
+				s->clear_done = clock + 3200000000ULL;
+			break;
+		case Opteron::EXTMMIO_MAP_DATA: {
+			// banked by the control register's index
+			const uint64_t ctrl = generic_read(s, key(DEV_OPTERON, Opteron::EXTMMIO_MAP_CTRL >> 12, Opteron::EXTMMIO_MAP_CTRL & 0xfff));
+			table_put(&s->regs, (ctrl << 32) | k, (val & mask));
+			return;
+		}
+		}
+
+		table_put(&s->regs, k, (generic_read(s, k) & ~mask) | (val & mask));
+	}
+
+	// indirect register pairs on the IO hub are kept under their index
+	static uint64_t sr5690_key(const struct server *s, const reg_t reg, const uint64_t k)
+	{
+		uint32_t index;
+
+		switch (reg) {
+		case 0x64:
+			index = generic_read(s, k - 4) & 0x7f;
+			return ((uint64_t)(0x100 | index) << 32) | k;
+		case 0x98:
+			index = generic_read(s, k - 4) & 0xff;
+			return ((uint64_t)(0x200 | index) << 32) | k;
+		case 0xfc:
+			index = generic_read(s, k - 4);
+			return ((uint64_t)(0x300 | index) << 32) | k;
+		}
+
+		return k;
+	}
+
+	static bool present(const unsigned bus, const unsigned dev, const unsigned func)
+	{
+		if (bus)
+			return 0;
+
+		switch (dev) {
+		case DEV_SR5690:
+		case DEV_SP5100:
+			return func == 0;
+		case DEV_OPTERON:
+			return func < 6;
+		case DEV_NC2:
+			return func < 4;
+		}
+
+		return 0;
+	}
+
+	static uint32_t csr_read(struct server *s, const uint32_t off)
+	{
+		const unsigned bus = off >> 20, dev = (off >> 15) & 0x1f, func = (off >> 12) & 7;
+		const reg_t reg = off & 0xffc;
+
+		if (!s || !present(bus, dev, func))
+			return 0xffffffff;
+
+		// no BARs are implemented
+		if (reg >= 0x10 && reg < 0x28 && dev != DEV_NC2)
+			return 0;
+
+		switch (dev) {
+		case DEV_NC2:
+			return nc2_read(s, (func << 12) | reg, off & ~3);
+		case DEV_OPTERON:
+			if (func == 0 && reg == Opteron::HT_NODE_ID)
+				return generic_read(s, off & ~3);
+			return opteron_read(s, (func << 12) | reg, off & ~3);
+		case DEV_SR5690:
+			return generic_read(s, sr5690_key(s, reg, off & ~3));
+		}
+
+		return generic_read(s, off & ~3);
+	}
+
+	static void csr_write(struct server *s, const uint32_t off, const uint32_t val, const uint32_t mask)
+	{
+		const unsigned bus = off >> 20, dev = (off >> 15) & 0x1f, func = (off >> 12) & 7;
+		const reg_t reg = off & 0xffc;
+
+		if (!s || !present(bus, dev, func))
+			return;
+
+		switch (dev) {
+		case DEV_NC2:
+			nc2_write(s, (func << 12) | reg, off & ~3, val, mask);
+			return;
+		case DEV_OPTERON:
+			opteron_write(s, (func << 12) | reg, off & ~3, val, mask);
+			return;
+		case DEV_SR5690: {
+			const uint64_t k = sr5690_key(s, reg, off & ~3);
+			table_put(&s->regs, k, (generic_read(s, k) & ~mask) | (val & mask));
+			return;
+		}
+		}
+
+		table_put(&s->regs, off & ~3, (generic_read(s, off & ~3) & ~mask) | (val & mask));
+	}
+
+	// decode config space addresses to the owning server
+	static bool mcfg_decode(const uint64_t addr, struct server **s, uint32_t *off, bool *remote)
+	{
+		if (addr >= MCFG_LOCAL && addr < MCFG_LOCAL + MCFG_SIZE) {
+			*s = local;
+			*off = addr - MCFG_LOCAL;
+			*remote = 0;
+			return 1;
+		}
+
+		if (addr >= Numachip2::MCFG_BASE && addr <= Numachip2::MCFG_LIM) {
+			const sci_t sci = (addr >> 28) & 0xfff;
+			*s = server(sci);
+			*off = addr & (MCFG_SIZE - 1);
+			*remote = *s != local;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	static bool host_mapped(const uint64_t addr)
+	{
+		return addr < LOW_SIZE || (addr >= ACPI_BASE && addr < ACPI_BASE + ACPI_SIZE) ||
+		  (addr >= APIC_BASE && addr < APIC_BASE + APIC_SIZE);
+	}
+
+	static bool remote_memory(const uint64_t addr)
+	{
+		// relative to the server of the core running
+		for (unsigned n = 0; running && nodes && n < nnodes; n++)
+			if (nodes[n]->config->id == running->sci && nodes[n]->dram_end)
+				return addr < nodes[n]->dram_base || addr > nodes[n]->dram_end;
+
+		if (local_node && local_node->dram_end)
+			return addr > local_node->dram_end;
+		return addr >= REMOTE_DRAM;
+	}
+
+	uint64_t mem_read(const uint64_t addr, const unsigned len)
+	{
+		struct server *s;
+		uint32_t off;
+		bool remote;
+
+		if (mcfg_decode(addr, &s, &off, &remote)) {
+			account(remote ? CSR_READ_REMOTE : CSR_READ);
+			if (len == 8)
+				return csr_read(s, off) | (uint64_t)csr_read(s, off + 4) << 32;
+			return (csr_read(s, off) >> ((off & 3) * 8)) & ((1ULL << (len * 8)) - 1);
+		}
+
+		if (addr >= Numachip2::LOC_BASE && addr <= Numachip2::LOC_LIM) {
+			account(CSR_READ);
+			if (addr == Numachip2::PIU_TIMER_NOW)
+				return clock / 5; // 200MHz
+			return 0;
+		}
+
+		account(remote_memory(addr) ? MEM_REMOTE : MEM_LOCAL);
+
+		uint64_t val = 0;
+		if (host_mapped(addr)) {
+			memcpy(&val, (void *)addr, len);
+			return val;
+		}
+
+		table_get(&ram, addr >> 3, &val);
+		return (val >> ((addr & 7) * 8)) & (len == 8 ? ~0ULL : (1ULL << (len * 8)) - 1);
+	}
+
+	void mem_write(const uint64_t addr, const unsigned len, const uint64_t val)
+	{
+		struct server *s;
+		uint32_t off;
+		bool remote;
+
+		if (mcfg_decode(addr, &s, &off, &remote)) {
+			account(remote ? CSR_WRITE_REMOTE : CSR_WRITE);
+			if (len == 8) {
+				csr_write(s, off, val, ~0U);
+				csr_write(s, off + 4, val >> 32, ~0U);
+				return;
+			}
+
+			const unsigned shift = (off & 3) * 8;
+			const uint32_t mask = (len == 4 ? ~0U : (1U << (len * 8)) - 1) << shift;
+			csr_write(s, off, (uint32_t)val << shift, mask);
+			return;
+		}
+
+		if (addr >= Numachip2::LOC_BASE && addr <= Numachip2::LOC_LIM) {
+			account(CSR_WRITE);
+			if (addr == Numachip2::PIU_APIC_ICR)
+				ipi(val >> 12, val & 0xfff);
+			return;
+		}
+
+		account(remote_memory(addr) ? MEM_REMOTE : MEM_LOCAL);
+
+		if (host_mapped(addr)) {
+			memcpy((void *)addr, &val, len);
+			return;
+		}
+
+		const uint64_t mask = (len == 8 ? ~0ULL : (1ULL << (len * 8)) - 1) << ((addr & 7) * 8);
+		uint64_t word = 0;
+		table_get(&ram, addr >> 3, &word);
+		table_put(&ram, addr >> 3, (word & ~mask) | ((val << ((addr & 7) * 8)) & mask));
+	}
+
+	uint64_t rdmsr(const uint32_t msr)
+	{
+		account(MSR_READ);
+		uint64_t val = 0;
+		table_get(&msrs, msr, &val);
+
+		// core setup leaves each server's cores with its own MCFG window
+		if (running && msr == MSR_MCFG && val >= (1ULL << 32))
+			return Numachip2::MCFG_BASE | ((uint64_t)running->sci << 28) | (val & 0xfffff);
+		return val;
+	}
+
+	void wrmsr(const uint32_t msr, const uint64_t val)
+	{
+		account(MSR_WRITE);
+		table_put(&msrs, msr, val);
+
+		// config space moves to the global window once the SCI is known
+		if (msr == MSR_MCFG && (val & ~0xfffffULL) >= (1ULL << 32)) {
+			local_sci = (val >> 28) & 0xfff;
+			servers[local_sci] = local;
+			local->sci = local_sci;
+		}
+	}
+
+	// 6300-series Opteron: 16KB L1D per core, 64KB L1I and 2MB L2 per compute unit of two cores, 6MB L3 per die, two dies
+	void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t *regs)
+	{
+		// type and level, sharing cores less one; line, ways less one; sets less one
+		static const uint32_t caches[][3] = {
+			{0x21 | (0 << 14), 63 | (3 << 22), 63},
+			{0x22 | (1 << 14), 63 | (1 << 22), 511},
+			{0x43 | (1 << 14), 63 | (15 << 22), 2047},
+			{0x63 | (7 << 14), 63 | (47 << 22), 2047},
+		};
+
+		memset(regs, 0, 4 * sizeof(*regs));
+		switch (leaf) {
+		case 1:
+			regs[0] = 0x00600f20;
+			break;
+		case 0x80000000:
+			regs[0] = 0x8000001e;
+			break;
+		case 0x80000001:
+			regs[0] = 0x00600f20;
+			regs[2] = 1 << 22; // topology extensions
+			break;
+		case 0x80000005:
+			regs[2] = (16 << 24) | (4 << 16) | (1 << 8) | 64;
+			regs[3] = (64 << 24) | (2 << 16) | (1 << 8) | 64;
+			break;
+		case 0x80000006:
+			regs[2] = (2048 << 16) | (8 << 12) | (1 << 8) | 64;
+			regs[3] = (12 << 18) | (0xb << 12) | (1 << 8) | 64;
+			break;
+		case 0x8000001d:
+			if (subleaf < sizeof(caches) / sizeof(caches[0]))
+				memcpy(regs, caches[subleaf], sizeof(caches[0]));
+			break;
+		case 0x8000001e:
+			regs[1] = 1 << 8; // two cores per compute unit
+			regs[2] = 1 << 8; // two dies per package
+			break;
+		}
+	}
+
+	uint32_t io_read(const uint16_t port, const unsigned len)
+	{
+		account(PORT_IO);
+
+		switch (port) {
+		case 0x21:
+			return pic[0];
+		case 0xa1:
+			return pic[1];
+		case 0x71:
+			return cmos[cmos_index & 0x7f];
+		case 0xcd7:
+			return pmio[pmio[255]];
+		}
+
+		return len == 1 ? 0xff : len == 2 ? 0xffff : 0xffffffff;
+	}
+
+	void io_write(const uint16_t port, const unsigned len, const uint32_t val)
+	{
+		account(PORT_IO);
+
+		switch (port) {
+		case 0x21:
+			pic[0] = val;
+			break;
+		case 0xa1:
+			pic[1] = val;
+			break;
+		case 0x70:
+			cmos_index = val;
+			break;
+		case 0xcd6:
+			// PMIO index, with the data in the high byte for word writes
+			pmio[255] = val;
+			if (len == 2)
+				pmio[val & 0xff] = val >> 8;
+			break;
+		case 0xcd7:
+			pmio[pmio[255]] = val;
+			break;
+		case 0xcf9:
+			fatal("Warm reset requested");
+		}
+	}
+
+	static uint8_t sum(const uint8_t *data, const unsigned len)
+	{
+		uint8_t total = 0;
+		for (unsigned i = 0; i < len; i++)
+			total += data[i];
+		return total;
+	}
+
+	// append a table with standard header at pos, returning its address
+	static uint32_t acpi_table(uint32_t *pos, const char *sig, const uint8_t rev, const uint8_t *data, const unsigned len)
+	{
+		uint8_t *table = (uint8_t *)(uintptr_t)*pos;
+		const uint32_t total = 36 + len;
+
+		memset(table, 0, 36);
+		memcpy(table, sig, 4);
+		memcpy(table + 4, &total, 4);
+		table[8] = rev;
+		memcpy(table + 10, "SIMBIO", 6);
+		memcpy(table + 16, "SIMTABLE", 8);
+		memcpy(table + 36, data, len);
+		table[9] = -sum(table, total);
+
+		const uint32_t addr = *pos;
+		*pos = (*pos + total + 15) & ~15;
+		return addr;
+	}
+
+	// hides fixed low addresses from the compiler's bounds checks
+	static void *mem_base(const uintptr_t addr)
+	{
+		void *volatile p = (void *)addr;
+		return p;
+	}
+
+	// minimal BIOS data area, ACPI tables and SMBIOS as left by a real BIOS
+	static void bios_tables(void)
+	{
+		uint8_t *bda = (uint8_t *)mem_base(0x400);
+		*(uint16_t *)&bda[0x13] = 639; // base memory in KB
+		*(uint16_t *)&bda[0x0e] = 0;   // no EBDA
+
+		uint8_t data[512];
+		memset(data, 0, sizeof(data));
+		uint32_t pos = 0xe0100;
+
+		const uint32_t dsdt = acpi_table(&pos, "DSDT", 2, data, 0);
+
+		memset(data, 0, sizeof(data));
+		memcpy(&data[4], &dsdt, 4);
+		const uint32_t facp = acpi_table(&pos, "FACP", 4, data, 244 - 36);
+
+		memset(data, 0, sizeof(data));
+		const uint32_t apic_base = APIC_BASE, flags = 1;
+		memcpy(&data[0], &apic_base, 4);
+		memcpy(&data[4], &flags, 4);
+		for (unsigned i = 0; i < 8; i++) {
+			uint8_t *ent = &data[8 + i * 8];
+			ent[0] = 0;
+			ent[1] = 8;
+			ent[2] = i; // processor ID
+			ent[3] = i; // APIC ID
+			ent[4] = 1; // enabled
+		}
+		const uint32_t apic = acpi_table(&pos, "APIC", 3, data, 8 + 8 * 8);
+
+		memset(data, 0, sizeof(data));
+		data[0] = 1;
+		for (unsigned i = 0; i < 8; i++) {
+			uint8_t *ent = &data[12 + i * 16];
+			ent[0] = 0;
+			ent[1] = 16;
+			ent[3] = i; // APIC ID
+			ent[4] = 1; // enabled
+		}
+		uint8_t *mem = &data[12 + 8 * 16];
+		mem[0] = 1;
+		mem[1] = 40;
+		const uint64_t mem_len = 32ULL << 30;
+		memcpy(&mem[16], &mem_len, 8);
+		mem[28] = 1; // enabled
+		const uint32_t srat = acpi_table(&pos, "SRAT", 3, data, 12 + 8 * 16 + 40);
+
+		memset(data, 0, sizeof(data));
+		data[0] = 1;
+		data[8] = 10;
+		const uint32_t slit = acpi_table(&pos, "SLIT", 1, data, 9);
+
+		const uint32_t children[] = {facp, apic, srat, slit};
+		const unsigned nchildren = sizeof(children) / sizeof(children[0]);
+
+		// root tables last, with room to grow
+		memset(data, 0, sizeof(data));
+		memcpy(data, children, sizeof(children));
+		const uint32_t rsdt = acpi_table(&pos, "RSDT", 1, data, nchildren * 4);
+		pos += 512;
+
+		for (unsigned i = 0; i < nchildren; i++) {
+			const uint64_t child = children[i];
+			memcpy(&data[i * 8], &child, 8);
+		}
+		const uint32_t xsdt = acpi_table(&pos, "XSDT", 1, data, nchildren * 8);
+
+		uint8_t *rsdp = (uint8_t *)0xe0000;
+		memcpy(rsdp, "RSD PTR ", 8);
+		memcpy(rsdp + 9, "SIMBIO", 6);
+		rsdp[15] = 2;
+		memcpy(rsdp + 16, &rsdt, 4);
+		const uint32_t rsdp_len = 36;
+		memcpy(rsdp + 20, &rsdp_len, 4);
+		const uint64_t xsdt64 = xsdt;
+		memcpy(rsdp + 24, &xsdt64, 8);
+		rsdp[8] = -sum(rsdp, 20);
+		rsdp[32] = -sum(rsdp, 36);
+
+		// SMBIOS structures: BIOS, system, baseboard, end
+		char *smbios = (char *)0xf1000;
+		char *p = smbios;
+		const struct {
+			uint8_t type, len, a, b;
+			const char *strings;
+			unsigned strings_len;
+		} structs[] = {
+			{0, 0x12, 5, 8, "SimBIOS\0" "1.0\0" "01/01/2014\0", 0},
+			{1, 0x08, 4, 5, "Numascale\0" "SIM\0", 0},
+			{2, 0x08, 4, 5, "Numascale\0" "SIMBOARD\0", 0},
+		};
+
+		for (unsigned i = 0; i < sizeof(structs) / sizeof(structs[0]); i++) {
+			memset(p, 0, structs[i].len);
+			p[0] = structs[i].type;
+			p[1] = structs[i].len;
+			if (structs[i].type == 0) {
+				p[4] = 1; // vendor
+				p[5] = 2; // version
+				p[8] = 3; // date
+			} else {
+				p[4] = 1;
+				p[5] = 2;
+			}
+			p += structs[i].len;
+
+			const char *str = structs[i].strings;
+			while (*str) {
+				strcpy(p, str);
+				p += strlen(str) + 1;
+				str += strlen(str) + 1;
+			}
+			*p++ = 0;
+		}
+
+		p[0] = 127;
+		p[1] = 4;
+		p += 6;
+
+		char *ep = (char *)0xf0000;
+		memcpy(ep, "_SM_", 4);
+		const uint16_t smbios_len = p - smbios, count = 4;
+		const uint32_t smbios_addr = (uint32_t)(uintptr_t)smbios;
+		memcpy(ep + 0x16, &smbios_len, 2);
+		memcpy(ep + 0x18, &smbios_addr, 4);
+		memcpy(ep + 0x1c, &count, 2);
+	}
+
+	static void map(const uint64_t addr, const size_t len)
+	{
+		void *p = mmap((void *)addr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+		if (p == MAP_FAILED) {
+			perror("mmap");
+			fprintf(stderr, "Mapping 0x%" PRIx64 " failed; sim-boot must run as root\n", addr);
+			exit(1);
+		}
+	}
+
+	static const char *symbol(void *fn, char *buf, const size_t len)
+	{
+		char cmd[128];
+		snprintf(cmd, sizeof(cmd), "addr2line -f -C -e /proc/%d/exe %p", getpid(), fn);
+
+		FILE *f = popen(cmd, "r");
+		if (!f || !fgets(buf, len, f))
+			snprintf(buf, len, "%p", fn);
+		buf[strcspn(buf, "(\n")] = '\0';
+		if (f)
+			pclose(f);
+		return buf;
+	}
+
+	static void report_line(const char *name, const unsigned calls, const uint64_t *ops, const uint64_t ns)
+	{
+		printf("%-24s %5u %10" PRIu64 " %9" PRIu64 " %10" PRIu64 " %9" PRIu64 " %7" PRIu64 " %10" PRIu64 " %6" PRIu64 " %8" PRIu64 " %11.3f\n",
+		  name, calls, ops[CSR_READ], ops[CSR_WRITE], ops[CSR_READ_REMOTE], ops[CSR_WRITE_REMOTE],
+		  ops[MSR_READ] + ops[MSR_WRITE], ops[MEM_LOCAL] + ops[MEM_REMOTE], ops[PORT_IO], ops[CONSOLE], ns / 1e6);
+	}
+
+	static void report(void)
+	{
+		uint64_t total[OPS] = {}, ns = 0;
+		char name[128];
+
+		depth = 0; // the report itself isn't console time
+		printf("\n%-24s %5s %10s %9s %10s %9s %7s %10s %6s %8s %11s\n", "phase", "calls", "CSR reads", "writes",
+		  "remote rd", "remote wr", "MSRs", "memory", "IO", "console", "modelled ms");
+
+		for (unsigned i = 0; i < nphases; i++) {
+			const struct phase *p = &phases[i];
+			if (!p->ns && p->fn)
+				continue;
+
+			report_line(p->fn ? symbol(p->fn, name, sizeof(name)) : i ? "main" : "startup", p->calls, p->ops, p->ns);
+			for (unsigned op = 0; op < OPS; op++)
+				total[op] += p->ops[op];
+			ns += p->ns;
+		}
+
+		report_line("total", 1, total, ns);
+	}
+
+	// the OS would read the E820-reserved trace region via /dev/mem
+	static void trace_save(void)
+	{
+		if (!lib::trace)
+			return;
+
+		FILE *f = fopen("access.trace", "w");
+		xassert(f);
+		xassert(fwrite(lib::trace, lib::trace->size, 1, f) == 1);
+		fclose(f);
+		printf("Access trace of %" PRIu64 " accesses saved to access.trace\n", lib::trace->accesses);
+	}
+
+	// unbuffered, as the firmware's serial output is synchronous
+	static ssize_t console_write(void *, const char *buf, const size_t len)
+	{
+		if (depth)
+			for (size_t i = 0; i < len; i++)
+				account(CONSOLE);
+
+		return write(STDOUT_FILENO, buf, len);
+	}
+
+	static void console_init(void)
+	{
+		cookie_io_functions_t io = {NULL, console_write, NULL, NULL};
+		stdout = fopencookie(NULL, "w", io);
+		xassert(stdout);
+		setvbuf(stdout, NULL, _IONBF, 0);
+	}
+
+	static struct phase *phase_find(void *fn)
+	{
+		for (unsigned i = 2; i < nphases; i++)
+			if (phases[i].fn == fn)
+				return &phases[i];
+
+		if (nphases == MAX_PHASES + 2)
+			return &phases[1]; // attribute to main
+
+		phases[nphases].fn = fn;
+		return &phases[nphases++];
+	}
+}
+
+using namespace sim;
+
+extern "C" {
+	// a core pausing yields to the BSP, which lets cores behind it run
+	void sim_relax(void)
+	{
+		if (running) {
+			clock += pause_ns;
+			sched_switch(&running->sp, bsp_sp);
+			return;
+		}
+
+		delay(pause_ns);
+		cores_run();
+	}
+
+	// callees of main are the boot phases
+	__attribute__((no_instrument_function)) void __cyg_profile_func_enter(void *fn, void *site)
+	{
+		if (!main_fn || running)
+			return;
+
+		if (fn == main_fn && !depth) {
+			depth = 1;
+			current = &phases[1];
+			current->calls++;
+			return;
+		}
+
+		if (!depth)
+			return;
+
+		if (++depth == 2) {
+			current = phase_find(fn);
+			current->calls++;
+		}
+	}
+
+	__attribute__((no_instrument_function)) void __cyg_profile_func_exit(void *fn, void *site)
+	{
+		if (!depth || running)
+			return;
+
+		if (--depth == 1)
+			current = &phases[1];
+	}
+}
+
+extern int main(const int argc, char *const argv[]);
+
+// runs before the firmware's static constructors, which scan the BIOS tables
+__attribute__((constructor(101))) static void sim_init(void)
+{
+	// firmware stores heap pointers in 32-bit fields
+	mallopt(M_MMAP_THRESHOLD, 32 << 20);
+
+	map(0, LOW_SIZE);
+	map(ACPI_BASE, ACPI_SIZE);
+	map(APIC_BASE, APIC_SIZE);
+
+	table_init(&msrs, 256);
+	table_init(&ram, 1 << 16);
+
+	table_put(&msrs, MSR_PATCHLEVEL, 0x0600063d);
+	table_put(&msrs, MSR_APIC_BAR, APIC_BASE | 0x900);
+	table_put(&msrs, MSR_TOPMEM, 0xc0000000);
+	table_put(&msrs, MSR_MC_CAP, 7);
+	table_put(&msrs, MSR_MCFG, MCFG_LOCAL | 0x21);
+
+	cmos[RTC_SETTINGS] = 4; // binary mode
+	cmos[RTC_YEAR] = 14;
+	cmos[RTC_MONTH] = 1;
+	cmos[RTC_DAY] = 1;
+
+	local = server_new(SCI_LOCAL);
+	local->dram_ready = 0;
+	bios_tables();
+	console_init();
+
+	nphases = 2;
+	current = &phases[0];
+	main_fn = (void *)main;
+	atexit(report);
+	atexit(trace_save);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// host model of each simulated server's config space, MSRs and memory, behind the SIM access layer
+namespace sim
+{
+	enum op {
+		CSR_READ, CSR_WRITE,               // local config space
+		CSR_READ_REMOTE, CSR_WRITE_REMOTE, // other servers' config space over the fabric
+		MSR_READ, MSR_WRITE,
+		MEM_LOCAL, MEM_REMOTE,
+		PORT_IO,
+		CONSOLE,                           // byte to the serial console
+		OPS
+	};
+
+	// modelled cost of each operation in ns; CSR latencies include the HT round trip, console bytes 10 bits at 115200 baud
+	static const unsigned op_ns[OPS] = {600, 200, 2500, 1000, 100, 300, 100, 1000, 1000, 86806};
+	static const unsigned pause_ns = 10;
+	static const unsigned tsc_mhz = 2200;
+
+	uint64_t now(void);
+	void delay(const uint64_t ns);
+
+	uint64_t mem_read(const uint64_t addr, const unsigned len);
+	void mem_write(const uint64_t addr, const unsigned len, const uint64_t val);
+	uint64_t rdmsr(const uint32_t msr);
+	void wrmsr(const uint32_t msr, const uint64_t val);
+	void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t *regs);
+	uint32_t io_read(const uint16_t port, const unsigned len);
+	void io_write(const uint16_t port, const unsigned len, const uint32_t val);
+
+	// local APIC or Numachip2 interrupt command to an emulated core
+	void ipi(const uint32_t apicid, const uint32_t low);
+}
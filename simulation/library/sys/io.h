@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// port IO routed to the host model instead of the real ports
+#include "../model.h"
+
+static inline uint8_t inb(const uint16_t port)
+{
+	return sim::io_read(port, 1);
+}
+
+static inline uint16_t inw(const uint16_t port)
+{
+	return sim::io_read(port, 2);
+}
+
+static inline uint32_t inl(const uint16_t port)
+{
+	return sim::io_read(port, 4);
+}
+
+static inline void outb(const uint8_t val, const uint16_t port)
+{
+	sim::io_write(port, 1, val);
+}
+
+static inline void outw(const uint16_t val, const uint16_t port)
+{
+	sim::io_write(port, 2, val);
+}
+
+static inline void outl(const uint32_t val, const uint16_t port)
+{
+	sim::io_write(port, 4, val);
+}
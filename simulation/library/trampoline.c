@@ -15,9 +15,47 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-unsigned asm_relocate_start, asm_relocate_end;
-unsigned asm_relocated;
-unsigned new_e820_map_relocate, new_e820_len_relocate;
-unsigned new_e820_handler_relocate;
-unsigned old_int15_vec_relocate;
+#include "../../platform/trampoline.h"
 
+// data-only image of the relocated trampoline with the layout of trampoline.S; APs are emulated by the model
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define EXPORT(sym) ".global " #sym "_relocate\n" #sym "_relocate:\n"
+
+asm(".data\n"
+	".balign 4096\n"
+	".global asm_relocate_start\n"
+	"asm_relocate_start:\n"
+	EXPORT(entry)
+	".skip 64\n"
+	EXPORT(work32)
+	".skip 64\n"
+	".balign 64\n"
+	EXPORT(vector) ".long 0\n"
+	EXPORT(pending) ".long 0\n"
+	EXPORT(errors) ".long 0\n"
+	EXPORT(old_int15_vec) ".long 0\n"
+	EXPORT(new_e820_map) ".skip " XSTR(E820_MAP_MAX) "\n"
+	EXPORT(msrs) ".skip " XSTR(MSR_MAX) " * 12\n"
+	EXPORT(new_e820_len) ".word 0\n"
+	EXPORT(apic_local) ".byte 0\n"
+	".balign 8\n"
+	EXPORT(work_gdt) ".skip 24\n"
+	".word 0\n"
+	EXPORT(work_gdt_base) ".long 0\n"
+	EXPORT(work_jump) ".long 0\n"
+	".word 0\n"
+	EXPORT(work_fn) ".long 0\n"
+	EXPORT(work_arg) ".long 0\n"
+	EXPORT(work_stacks) ".long 0\n"
+	EXPORT(work_slot) ".long 0\n"
+	EXPORT(work_msrs) ".long 0\n"
+	".balign 64\n"
+	".skip 1024\n"
+	".balign 64\n"
+	EXPORT(new_e820_handler)
+	".skip 64\n"
+	".global asm_relocate_end\n"
+	"asm_relocate_end:\n"
+	".balign 1024\n"
+	".previous\n");
@@ -1,8 +1,43 @@
-#include <stdint.h>
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../../library/utils.h"
+#include "../../library/sched.h"
+#include "model.h"
 
 namespace lib
 {
 	void udelay(const uint32_t usecs)
 	{
+		sim::delay((uint64_t)usecs * 1000);
+	}
+
+	// other tasks run while one waits, advancing the clock in slices when none has work
+	void task_udelay(const uint32_t usecs)
+	{
+		const uint64_t limit = sim::now() + (uint64_t)usecs * 1000;
+
+		while (lib::task_running() && sim::now() < limit) {
+			lib::task_yield();
+			if (sim::now() < limit)
+				sim::delay(min(limit - sim::now(), (uint64_t)100000));
+		}
+
+		if (sim::now() < limit)
+			sim::delay(limit - sim::now());
 	}
 }
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "../numachip2/ncache.h"
+
+#define GB (1ULL << 30)
+#define MB (1ULL << 20)
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+// the layout fits the DIMM and the registers' encodings
+static bool valid(const struct ncache_layout *layout, const uint64_t total, const bool byte_mode)
+{
+	const uint64_t mtag = (total - layout->mtag_base) & ~((1ULL << 19) - 1);
+
+	return layout->shift >= NCACHE_MIN_SHIFT && layout->shift <= NCACHE_MAX_SHIFT &&
+	  layout->ctag == 1ULL << (layout->shift - CTAG_SHIFT) &&
+	  layout->mtag_base == (1ULL << layout->shift) + layout->ctag && !(layout->mtag_base & ((1ULL << 19) - 1)) &&
+	  layout->mtag_base < total && !(layout->mtag_mask & (layout->mtag_mask - 1)) && layout->mtag_mask >= (1ULL << 19) &&
+	  layout->memlimit == (total - layout->mtag_base) << (byte_mode ? MTAG8_SHIFT : MTAG16_SHIFT) && mtag;
+}
+
+int main(void)
+{
+	struct ncache_layout layout;
+	bool fits = 1, covered = 1, largest = 1, explicit_size = 1, stepped = 1, smaller = 1;
+
+	check(!ncache_layout(&layout, 1 * GB, 64 * GB, 0, 0), "1GB DIMM is too small");
+
+	for (unsigned dimm = 31; dimm <= 36; dimm++) {
+		const uint64_t total = 1ULL << dimm;
+
+		for (unsigned byte_mode = 0; byte_mode <= 1; byte_mode++) {
+			for (uint64_t host = 8 * GB; host <= 4096 * GB; host *= 2) {
+				struct ncache_layout most;
+				fits &= ncache_layout(&most, total, host, byte_mode, 0) && valid(&most, total, byte_mode);
+
+				// the MTag covers host memory unless even the smallest nCache leaves too little
+				if (most.shift > NCACHE_MIN_SHIFT || most.memlimit > host)
+					covered &= most.memlimit > host;
+
+				// the next size up wouldn't leave the host covered
+				if (most.shift < NCACHE_MAX_SHIFT && most.memlimit > host && ncache_layout(&layout, total, host, byte_mode, 2ULL << most.shift) &&
+				  layout.shift > most.shift) {
+					const unsigned mtag_shift = byte_mode ? MTAG8_SHIFT : MTAG16_SHIFT;
+					largest &= layout.memlimit >> mtag_shift < (((host >> mtag_shift) + 1 + (1 << 19) - 1) & ~((1ULL << 19) - 1));
+				}
+
+				for (unsigned shift = NCACHE_MIN_SHIFT; shift <= NCACHE_MAX_SHIFT; shift++) {
+					if (!ncache_layout(&layout, total, host, byte_mode, 1ULL << shift) || !valid(&layout, total, byte_mode)) {
+						explicit_size = 0;
+						continue;
+					}
+
+					// only sizes not fitting the tags and a granule of MTag step down, to the largest that does
+					const unsigned up = layout.shift + 1;
+					if (layout.shift != shift) {
+						stepped &= layout.shift < shift && (1ULL << up) + (1ULL << (up - CTAG_SHIFT)) + (1ULL << 19) > total;
+						continue;
+					}
+
+					// a smaller nCache gives its space to the MTag
+					if (shift < most.shift)
+						smaller &= layout.memlimit > most.memlimit;
+				}
+			}
+		}
+	}
+
+	check(fits, "most nCache fits every DIMM size and MTag mode");
+	check(covered, "MTag covers host memory where it can");
+	check(largest, "nCache is the largest leaving memory covered");
+	check(explicit_size, "explicit sizes are used where they fit");
+	check(stepped, "explicit sizes too large step down to fit");
+	check(!ncache_layout(&layout, 1 * GB, 64 * GB, 0, 1 * GB), "1GB DIMM is too small for an explicit size");
+	check(smaller, "smaller nCache covers more memory");
+
+	check(ncache_layout(&layout, 16 * GB, 64 * GB, 0, 3 * GB) && layout.shift == 32, "sizes round up to a power of two");
+	check(ncache_layout(&layout, 64 * GB, 64 * GB, 0, 64 * GB) && layout.shift == NCACHE_MAX_SHIFT, "sizes are capped at 8GB");
+	check(ncache_layout(&layout, 64 * GB, 64 * GB, 0, 0) && layout.shift == NCACHE_MAX_SHIFT, "large DIMMs are capped at 8GB");
+
+	printf("%u nCache layout tests failed\n", failed);
+	return failed > 0;
+}
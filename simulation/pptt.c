@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../platform/pptt.h"
+#include "../library/base.h"
+
+#define HEADER 36 // SDT header, which offsets count from
+#define MAX_CORES 64
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+struct table {
+	char *buf;
+	unsigned len;
+	unsigned leaves[MAX_CORES], nleaves;
+	unsigned processors, packages;
+	bool walks, links, flags;
+};
+
+static const struct acpi_pptt_processor *processor(const struct table *t, const uint32_t offset)
+{
+	return (const struct acpi_pptt_processor *)(t->buf + offset);
+}
+
+static const struct acpi_pptt_cache *cache(const struct table *t, const uint32_t offset)
+{
+	return offset ? (const struct acpi_pptt_cache *)(t->buf + offset) : NULL;
+}
+
+static bool is(const struct table *t, const uint32_t offset, const uint8_t type)
+{
+	return offset >= HEADER && offset + 2 <= t->len && (uint8_t)t->buf[offset] == type;
+}
+
+// checks every structure's length and links, collecting the leaves
+static void decode(struct table *t)
+{
+	t->nleaves = t->processors = t->packages = 0;
+	t->walks = t->links = t->flags = 1;
+	unsigned pos = HEADER;
+
+	while (pos + 2 <= t->len) {
+		const uint8_t type = t->buf[pos], length = t->buf[pos + 1];
+		if (!length || pos + length > t->len) {
+			t->walks = 0;
+			return;
+		}
+
+		if (type == PPTT_CACHE) {
+			const struct acpi_pptt_cache *c = cache(t, pos);
+			t->walks &= length == sizeof(*c);
+			t->links &= !c->next_level || is(t, c->next_level, PPTT_CACHE);
+		} else if (type == PPTT_PROCESSOR) {
+			const struct acpi_pptt_processor *p = processor(t, pos);
+			const uint32_t *resources = (const uint32_t *)(p + 1);
+			t->walks &= length == sizeof(*p) + p->resources * sizeof(uint32_t);
+			// parents precede children, so walks up end at the root
+			t->links &= t->processors ? p->parent < pos && is(t, p->parent, PPTT_PROCESSOR) : !p->parent;
+			for (unsigned r = 0; r < p->resources; r++)
+				t->links &= is(t, resources[r], PPTT_CACHE);
+
+			const bool leaf = p->flags & PPTT_LEAF;
+			t->flags &= leaf == !!(p->flags & PPTT_ID_VALID);
+			if (leaf && t->nleaves < MAX_CORES)
+				t->leaves[t->nleaves++] = pos;
+			t->packages += p->flags & PPTT_PACKAGE;
+			t->processors++;
+		} else {
+			t->walks = 0;
+			return;
+		}
+
+		pos += length;
+	}
+
+	t->walks &= pos == t->len;
+}
+
+// as OSes find a core's cache: levels count along next-level chains at each node, continuing at its parent
+static const struct acpi_pptt_cache *find(const struct table *t, const uint32_t leaf, const unsigned level,
+  const unsigned type, uint32_t *owner)
+{
+	unsigned levels = 0;
+	for (uint32_t node = leaf; node; node = processor(t, node)->parent) {
+		const struct acpi_pptt_processor *p = processor(t, node);
+		const uint32_t *resources = (const uint32_t *)(p + 1);
+		const struct acpi_pptt_cache *found = NULL;
+		unsigned deepest = levels;
+
+		for (unsigned r = 0; r < p->resources; r++) {
+			unsigned local = levels;
+			for (const struct acpi_pptt_cache *c = cache(t, resources[r]); c; c = cache(t, c->next_level)) {
+				local++;
+				if (local == level && (c->attributes & (3 << 2)) == type)
+					found = c;
+			}
+			deepest = max(deepest, local);
+		}
+
+		if (found) {
+			*owner = node;
+			return found;
+		}
+		levels = deepest;
+	}
+
+	return NULL;
+}
+
+// cores finding the same instance of the cache as the core
+static unsigned sharing(const struct table *t, const unsigned core, const unsigned level, const unsigned type)
+{
+	uint32_t mine, theirs;
+	if (!find(t, t->leaves[core], level, type, &mine))
+		return 0;
+
+	unsigned n = 0;
+	for (unsigned c = 0; c < t->nleaves; c++)
+		n += find(t, t->leaves[c], level, type, &theirs) && theirs == mine;
+	return n;
+}
+
+static unsigned depth(const struct table *t, const unsigned core)
+{
+	unsigned n = 0;
+	for (uint32_t node = t->leaves[core]; processor(t, node)->parent; node = processor(t, node)->parent)
+		n++;
+	return n;
+}
+
+static void build(struct table *t, const struct pptt_info *info)
+{
+	t->len = HEADER + pptt_payload(NULL, info, HEADER);
+	t->buf = (char *)malloc(t->len + 16);
+	memset(t->buf, 0xa5, t->len + 16);
+	const unsigned written = pptt_payload(t->buf + HEADER, info, HEADER);
+	check(HEADER + written == t->len && (unsigned char)t->buf[t->len] == 0xa5, "sizing pass matches");
+	decode(t);
+}
+
+// two servers of two-die packages and one of a single die, one die downcored to 6 cores
+static void test_fam15h(void)
+{
+	static const unsigned dies[] = {2, 2, 1};
+	static const unsigned cores[] = {8, 8, 8, 6, 8};
+	static const uint64_t ncache[] = {2ULL << 30, 8ULL << 30, 0};
+	static const struct pptt_cache caches[] = {
+		{PPTT_CORE, 1, PPTT_READ_WRITE | PPTT_DATA, 16 << 10, 4, 64},
+		{PPTT_CORE, 1, PPTT_READ_WRITE | PPTT_INSTRUCTION, 64 << 10, 2, 64},
+		{PPTT_UNIT, 2, PPTT_READ_WRITE | PPTT_UNIFIED, 2 << 20, 16, 64},
+		{PPTT_DIE, 3, PPTT_READ_WRITE | PPTT_UNIFIED, 6 << 20, 48, 64},
+	};
+	uint32_t uids[38];
+	for (unsigned c = 0; c < 38; c++)
+		uids[c] = 0x40 + c;
+
+	struct pptt_info info = {3, dies, cores, uids, 2, 2, 4, caches, ncache};
+	struct table t;
+	build(&t, &info);
+
+	check(t.walks, "structure lengths walk the payload");
+	check(t.links && t.flags, "links and flags consistent");
+	check(t.nleaves == 38 && t.packages == 3, "a leaf per core, a package per two dies");
+	check(t.processors == 1 + 3 + 3 + 5 + 19 + 38, "system, servers, packages, dies, units, cores");
+
+	bool ids = 1, levels = 1;
+	for (unsigned c = 0; c < t.nleaves; c++) {
+		ids &= processor(&t, t.leaves[c])->acpi_id == uids[c];
+		levels &= depth(&t, c) == 5;
+	}
+	check(ids, "leaves carry the MADT UIDs in order");
+	check(levels, "cores sit under unit, die, package and server");
+
+	// per core, server 1's second die is downcored to 6
+	uint32_t owner;
+	const struct acpi_pptt_cache *l2 = find(&t, t.leaves[0], 2, PPTT_UNIFIED, &owner);
+	check(sharing(&t, 0, 1, PPTT_DATA) == 1 && sharing(&t, 0, 1, PPTT_INSTRUCTION) == 1, "L1s at level 1 for each core");
+	check(l2 && l2->size == 2 << 20 && l2->sets * l2->ways * l2->line == l2->size && sharing(&t, 0, 2, PPTT_UNIFIED) == 2,
+	  "L2 at level 2 shared by the compute unit");
+	check(sharing(&t, 0, 3, PPTT_UNIFIED) == 8 && sharing(&t, 25, 3, PPTT_UNIFIED) == 6, "L3 at level 3 shared by the die");
+
+	const struct acpi_pptt_cache *nc0 = find(&t, t.leaves[0], 4, PPTT_UNIFIED, &owner);
+	const struct acpi_pptt_cache *nc1 = find(&t, t.leaves[16], 4, PPTT_UNIFIED, &owner);
+	check(nc0 && (nc0->flags & PPTT_SIZE_VALID) && nc0->size == 2U << 30 && sharing(&t, 0, 4, PPTT_UNIFIED) == 16,
+	  "nCache at level 4 shared by the server");
+	check(nc1 && !(nc1->flags & PPTT_SIZE_VALID) && sharing(&t, 16, 4, PPTT_UNIFIED) == 14, "8GB nCache without a size");
+	check(!find(&t, t.leaves[37], 4, PPTT_UNIFIED, &owner), "no nCache level on a server without");
+
+	free(t.buf);
+}
+
+// L2 private to each core is chained after the L1s, so still level 2
+static void test_fam10h(void)
+{
+	static const unsigned dies[] = {2, 2};
+	static const unsigned cores[] = {6, 6, 6, 6};
+	static const uint64_t ncache[] = {1ULL << 30, 1ULL << 30};
+	static const struct pptt_cache caches[] = {
+		{PPTT_CORE, 1, PPTT_READ_WRITE | PPTT_DATA, 64 << 10, 2, 64},
+		{PPTT_CORE, 1, PPTT_READ_WRITE | PPTT_INSTRUCTION, 64 << 10, 2, 64},
+		{PPTT_CORE, 2, PPTT_READ_WRITE | PPTT_UNIFIED, 512 << 10, 16, 64},
+		{PPTT_DIE, 3, PPTT_READ_WRITE | PPTT_UNIFIED, 5 << 20, 48, 64},
+	};
+	uint32_t uids[24];
+	for (unsigned c = 0; c < 24; c++)
+		uids[c] = c;
+
+	struct pptt_info info = {2, dies, cores, uids, 1, 1, 4, caches, ncache};
+	struct table t;
+	build(&t, &info);
+
+	uint32_t owner;
+	check(t.walks && t.links && t.flags && t.packages == 4, "single-die packages walk");
+	check(t.processors == 1 + 2 + 4 + 4 + 24 && depth(&t, 0) == 4, "no compute unit level");
+	check(find(&t, t.leaves[0], 2, PPTT_UNIFIED, &owner) && owner == t.leaves[0] && sharing(&t, 0, 2, PPTT_UNIFIED) == 1,
+	  "core's L2 chained to level 2");
+	check(sharing(&t, 0, 3, PPTT_UNIFIED) == 6 && sharing(&t, 23, 4, PPTT_UNIFIED) == 12, "L3 and nCache above");
+
+	free(t.buf);
+}
+
+int main(void)
+{
+	test_fam15h();
+	test_fam10h();
+
+	printf("%u PPTT tests failed\n", failed);
+	return failed > 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../numachip2/routecache.h"
+#include "../numachip2/spi.h"
+
+#define NNODES 9
+#define VERSION ROUTE_CACHE_VERSION
+
+// file-backed EEPROM model, enforcing the same page rule as Numachip2::spi_write
+class FileStore: public RouteStore {
+	FILE *file;
+public:
+	unsigned writes;
+
+	FileStore(void): writes(0)
+	{
+		file = tmpfile();
+		xassert(file);
+
+		// erased EEPROM reads as all ones
+		uint8_t erased[ROUTE_CACHE_PAGE];
+		memset(erased, 0xff, sizeof(erased));
+		for (unsigned i = 0; i < (SPI_ROUTE_CACHE_BASE + SPI_ROUTE_CACHE_SIZE) / ROUTE_CACHE_PAGE; i++)
+			xassert(fwrite(erased, sizeof(erased), 1, file) == 1);
+	}
+
+	~FileStore(void)
+	{
+		fclose(file);
+	}
+
+	void read(const uint16_t addr, const unsigned len, uint8_t *data)
+	{
+		xassert(!fseek(file, addr, SEEK_SET));
+		xassert(fread(data, len, 1, file) == 1);
+	}
+
+	void write(const uint16_t addr, const unsigned len, uint8_t *data)
+	{
+		xassert(len > 0 && len <= ROUTE_CACHE_PAGE);
+		xassert((addr & ~(ROUTE_CACHE_PAGE - 1)) == ((addr + len - 1) & ~(ROUTE_CACHE_PAGE - 1)));
+		xassert(!fseek(file, addr, SEEK_SET));
+		xassert(fwrite(data, len, 1, file) == 1);
+		writes++;
+	}
+
+	void corrupt(const uint16_t addr)
+	{
+		uint8_t val;
+		read(addr, 1, &val);
+		val ^= 0x10;
+		xassert(!fseek(file, addr, SEEK_SET));
+		xassert(fwrite(&val, 1, 1, file) == 1);
+	}
+};
+
+// 3x3 torus, with Y rings on the given ports
+static void grid(Router *router, const xbarid_t yout, const xbarid_t yin)
+{
+	for (nodeid_t node = 0; node < NNODES; node++) {
+		router->connect(node, 1, (node / 3) * 3 + (node + 1) % 3, 2);
+		router->connect(node, yout, (node + 3) % NNODES, yin);
+	}
+}
+
+static void torus(Router *router)
+{
+	grid(router, 3, 4);
+}
+
+// same shape with Y cables moved to other ports
+static void recabled(Router *router)
+{
+	grid(router, 5, 6);
+}
+
+static Router *route(void (*build)(Router *router))
+{
+	Router *router = new Router();
+	build(router);
+	router->run(NNODES);
+	return router;
+}
+
+static Router *fresh(void (*build)(Router *router))
+{
+	Router *router = new Router();
+	build(router);
+	return router;
+}
+
+static bool same(const Router *a, const Router *b, const nodeid_t node)
+{
+	for (xbarid_t in = 0; in < XBAR_PORTS; in++)
+		if (memcmp(a->routes[node][in], b->routes[node][in], NNODES))
+			return 0;
+
+	for (nodeid_t src = 0; src < NNODES; src++)
+		if (memcmp(a->dist[src], b->dist[src], NNODES))
+			return 0;
+
+	return 1;
+}
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+int main(void)
+{
+	const nodeid_t node = 4;
+	FileStore store;
+	Router *router = route(torus);
+
+	RouteCache cache(*router, node, NNODES, VERSION, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+	check(!cache.load(store), "empty EEPROM misses");
+	check(cache.save(store), "save");
+	check(store.writes > 1, "save writes multiple pages");
+
+	Router *loaded = fresh(torus);
+	RouteCache hit(*loaded, node, NNODES, VERSION, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+	check(hit.topology() == cache.topology(), "topology hash is stable");
+	check(hit.load(store) && same(router, loaded, node), "same topology hits with identical tables");
+	delete loaded;
+
+	loaded = fresh(recabled);
+	RouteCache cabling(*loaded, node, NNODES, VERSION, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+	check(cabling.topology() != cache.topology() && !cabling.load(store), "changed cabling misses");
+	delete loaded;
+
+	loaded = fresh(torus);
+	RouteCache version(*loaded, node, NNODES, VERSION + 1, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+	check(!version.load(store), "changed cache version misses");
+	RouteCache other(*loaded, node + 1, NNODES, VERSION, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+	check(!other.load(store), "other node misses");
+	delete loaded;
+
+	// corrupt last payload byte
+	store.corrupt(SPI_ROUTE_CACHE_BASE + sizeof(struct route_cache_header) + XBAR_PORTS * NNODES + NNODES * NNODES - 1);
+	loaded = fresh(torus);
+	RouteCache corrupt(*loaded, node, NNODES, VERSION, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+	check(!corrupt.load(store), "corrupt payload misses");
+
+	// fall back to recomputing, then rewrite
+	loaded->run(NNODES);
+	check(corrupt.save(store) && same(router, loaded, node), "recompute after corruption matches");
+	delete loaded;
+
+	loaded = fresh(torus);
+	RouteCache rewritten(*loaded, node, NNODES, VERSION, SPI_ROUTE_CACHE_BASE, SPI_ROUTE_CACHE_SIZE);
+	check(rewritten.load(store) && same(router, loaded, node), "rewritten cache hits");
+	delete loaded;
+
+	RouteCache small(*router, node, NNODES, VERSION, SPI_ROUTE_CACHE_BASE, sizeof(struct route_cache_header));
+	check(!small.fits() && !small.save(store), "oversize tables aren't cached");
+
+	delete router;
+
+	printf("%u route cache tests failed\n", failed);
+	return failed > 0;
+}
@@ -16,15 +16,12 @@
  */
 
 #include "../numachip2/router.h"
+#include "../numachip2/verify.h"
 
 enum ports {A=1, B, C, D, E, F};
 
 #define PAIR(sn, sp, dn, dp) \
-	assert(router->neigh[sn][sp].nodeid = 255); \
-	assert(router->neigh[sn][sp].xbarid = 255); \
-	assert(router->neigh[dn][dp].nodeid = 255); \
-	assert(router->neigh[dn][dp].xbarid = 255); \
-	router->neigh[sn][sp] = {dn, dp}; router->neigh[dn][dp] = {sn, sp}
+	router->connect(sn, sp, dn, dp)
 
 #define XPAIR(s, d) \
 	PAIR(s, 1, d, 2)
@@ -38,46 +35,40 @@ enum ports {A=1, B, C, D, E, F};
 	XPAIR(01+n, 00+n)
 
 #define Y(n) \
-	YPAIR(00+n, 02+n); \
-	YPAIR(02+n, 04+n); \
-	YPAIR(04+n, 06+n); \
-	YPAIR(06+n, 05+n); \
-	YPAIR(05+n, 03+n); \
-	YPAIR(03+n, 01+n); \
-	YPAIR(01+n, 00+n)
-
-int main(int argc, char *argv[])
-{
-	printf("unconstrained 21-server topology:\n");
-	Router *router = new Router();
+	YPAIR( 0+n,  6+n); \
+	YPAIR( 6+n, 12+n); \
+	YPAIR(12+n, 18+n); \
+	YPAIR(18+n, 15+n); \
+	YPAIR(15+n,  9+n); \
+	YPAIR( 9+n,  3+n); \
+	YPAIR( 3+n,  0+n)
 
+static void unconstrained(Router *router)
+{
 	PAIR( 0, A,  1, A); PAIR( 0, B,  5, A); PAIR( 0, C,  9, A); PAIR( 0, D, 13, A); PAIR( 0, E, 17, A); PAIR( 0, F, 20, A);
 	PAIR( 1, B,  2, A); PAIR( 1, C,  6, A); PAIR( 1, D, 10, A); PAIR( 1, E, 14, A); PAIR( 1, F, 18, A);
 	PAIR( 2, B,  3, A); PAIR( 2, C,  7, A); PAIR( 2, D, 11, A); PAIR( 2, E, 15, A); PAIR( 2, F, 19, A);
-	PAIR( 3, B,  4, A); PAIR( 3, C,  8, A); PAIR( 3, D, 12, A); PAIR( 3, E, 16, A); PAIR( 2, F, 20, B);
-	PAIR( 4, B,  5, B); PAIR( 5, C,  9, B); PAIR( 4, D, 13, B); PAIR( 4, E, 17, B);
+	PAIR( 3, B,  4, A); PAIR( 3, C,  8, A); PAIR( 3, D, 12, A); PAIR( 3, E, 16, A); PAIR( 3, F, 20, B);
+	PAIR( 4, B,  5, B); PAIR( 4, C,  9, B); PAIR( 4, D, 13, B); PAIR( 4, E, 17, B);
 	PAIR( 5, C,  6, B); PAIR( 5, D, 10, B); PAIR( 5, E, 14, B); PAIR( 5, F, 18, B);
 	PAIR( 6, C,  7, B); PAIR( 6, D, 11, B); PAIR( 6, E, 15, B); PAIR( 6, F, 19, B);
-	PAIR( 7, C,  8, B); PAIR( 7, D, 12, B); PAIR( 7, E, 16, B); PAIR( 7, F, 20, B);
-	PAIR( 8, C,  9, C); PAIR( 8, D, 13, C); PAIR( 9, E, 17, C); PAIR( 8, F,  4, F);
+	PAIR( 7, C,  8, B); PAIR( 7, D, 12, B); PAIR( 7, E, 16, B); PAIR( 7, F, 20, C);
+	PAIR( 8, C,  9, C); PAIR( 8, D, 13, C); PAIR( 8, E, 17, C); PAIR( 8, F,  4, F);
 	PAIR( 9, D, 10, C); PAIR( 9, E, 14, C); PAIR( 9, F, 18, C);
 	PAIR(10, D, 11, C); PAIR(10, E, 15, C); PAIR(10, F, 19, C);
 	PAIR(11, D, 12, C); PAIR(11, E, 16, C); PAIR(11, F, 20, D);
 	PAIR(12, D, 13, D); PAIR(12, E, 17, D);
 	PAIR(13, E, 14, D); PAIR(13, F, 18, D);
 	PAIR(14, E, 15, D); PAIR(14, F, 19, D);
-	PAIR(15, E, 16, D); PAIR(15, F, 20, D);
+	PAIR(15, E, 16, D); PAIR(15, F, 20, E);
 	PAIR(16, E, 17, E); PAIR(16, F, 12, F);
 	PAIR(17, F, 18, E);
 	PAIR(18, F, 19, E);
 	PAIR(19, F, 20, F);
+}
 
-	router->run(21);
-	delete router;
-
-	printf("\n21-server 3x7 torus topology:\n");
-	router = new Router();
-
+static void torus(Router *router)
+{
 	X(0);
 	X(3);
 	X(6);
@@ -87,11 +78,43 @@ int main(int argc, char *argv[])
 	X(18);
 
 	Y(0);
-	Y(7);
-	Y(14);
+	Y(1);
+	Y(2);
+}
+
+static const struct {
+	const char *name;
+	void (*build)(Router *router);
+	unsigned nnodes;
+} topologies[] = {
+	{"unconstrained 21-server", unconstrained, 21},
+	{"21-server 3x7 torus", torus, 21},
+};
+
+int main(void)
+{
+	unsigned failed = 0;
+
+	for (unsigned t = 0; t < sizeof(topologies) / sizeof(topologies[0]); t++) {
+		for (unsigned vcs = 1; vcs <= MAX_VCS; vcs++) {
+			printf("%s topology with %u VCs:\n", topologies[t].name, vcs);
+			Router *router = new Router();
+			router->nvcs = vcs;
+			topologies[t].build(router);
+			router->run(topologies[t].nnodes);
+
+			RouteVerifier *verifier = new RouteVerifier(*router, topologies[t].nnodes);
+			const bool ok = verifier->run();
+			printf("\n");
+
+			if (!ok)
+				failed++;
 
-	router->run(21);
-	delete router;
+			delete verifier;
+			delete router;
+		}
+	}
 
-	return 0;
+	printf("%u topologies failed verification\n", failed);
+	return failed > 0;
 }
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../numachip2/router.h"
+#include "../numachip2/verify.h"
+
+#include <malloc.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// torus of x * y * z servers; ports A/B form X rings, C/D Y rings, E/F Z rings
+static void torus(Router *router, const unsigned x, const unsigned y, const unsigned z)
+{
+	for (unsigned k = 0; k < z; k++) {
+		for (unsigned j = 0; j < y; j++) {
+			for (unsigned i = 0; i < x; i++) {
+				const nodeid_t node = (k * y + j) * x + i;
+
+				if (x > 1)
+					router->connect(node, 1, (k * y + j) * x + (i + 1) % x, 2);
+				if (y > 1)
+					router->connect(node, 3, (k * y + (j + 1) % y) * x + i, 4);
+				if (z > 1)
+					router->connect(node, 5, (((k + 1) % z) * y + j) * x + i, 6);
+			}
+		}
+	}
+}
+
+static const struct {
+	unsigned x, y, z;
+} sizes[] = {
+	{4, 4, 1},
+	{8, 8, 1},
+	{4, 4, 4},
+	{8, 16, 1},
+	{4, 4, 8},
+	{16, 16, 1},
+};
+
+static size_t allocated(void)
+{
+	const struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	unsigned failed = 0;
+
+	// router progress output would swamp the results
+	const int out = dup(STDOUT_FILENO);
+	const int null = open("/dev/null", O_WRONLY);
+	xassert(out >= 0 && null >= 0);
+
+	// previous static layout, sized for MAX_NODE regardless of fabric size
+	const size_t channels = MAX_NODE * XBAR_PORTS * MAX_VCS;
+	const size_t dense = 2 * MAX_NODE * XBAR_PORTS * MAX_NODE + 2 * MAX_NODE * MAX_NODE +
+	  MAX_NODE * XBAR_PORTS * (sizeof(unsigned) + sizeof(dest_t)) + channels * (2 * sizeof(uint16_t) + sizeof(bool));
+	dprintf(out, "dense tables for %u nodes: %zuKB\n\n", MAX_NODE, dense >> 10);
+
+	dprintf(out, "topology  nodes VCs  footprint  routing   max hops  status\n");
+
+	for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		const unsigned nnodes = sizes[s].x * sizes[s].y * sizes[s].z;
+
+		for (unsigned vcs = 1; vcs <= MAX_VCS; vcs++) {
+			fflush(stdout);
+			dup2(null, STDOUT_FILENO);
+
+			const size_t base = allocated();
+			Router *router = new Router();
+			router->nvcs = vcs;
+			torus(router, sizes[s].x, sizes[s].y, sizes[s].z);
+
+			const double start = now();
+			router->run(nnodes);
+			const double elapsed = now() - start;
+			const size_t footprint = allocated() - base;
+
+			unsigned diameter = 0;
+			for (nodeid_t src = 0; src < nnodes; src++)
+				for (nodeid_t dst = 0; dst < nnodes; dst++)
+					diameter = max(diameter, (unsigned)router->dist[src][dst]);
+
+			RouteVerifier *verifier = new RouteVerifier(*router, nnodes);
+			const bool ok = verifier->run();
+
+			fflush(stdout);
+			dup2(out, STDOUT_FILENO);
+
+			failed += !ok;
+
+			dprintf(out, "%2ux%2ux%u  %5u %3u %7zuKB %8.2fs %10u  %s\n", sizes[s].x, sizes[s].y, sizes[s].z,
+			  nnodes, vcs, footprint >> 10, elapsed, diameter, ok ? "ok" : "FAILED");
+
+			delete verifier;
+			delete router;
+		}
+	}
+
+	close(null);
+	close(out);
+
+	printf("%u topologies failed verification\n", failed);
+	return failed > 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../platform/slit.h"
+#include "../library/base.h"
+
+#define SERVERS 3
+#define NBS 2
+#define DOMAINS (SERVERS * NBS)
+
+static unsigned failed;
+
+static void check(const bool cond, const char *name)
+{
+	printf("%-48s %s\n", name, cond ? "ok" : "FAILED");
+	if (!cond)
+		failed++;
+}
+
+// hop model as acpi_tables() builds it: BIOS distance 16 between northbridges, 100 to the next server
+static void hops(uint8_t *dist, const unsigned *server)
+{
+	for (unsigned i = 0; i < DOMAINS; i++)
+		for (unsigned j = 0; j < DOMAINS; j++)
+			dist[i * DOMAINS + j] = i == j ? 10 : server[i] == server[j] ? 16 : 100;
+}
+
+static void servers(unsigned *server)
+{
+	for (unsigned d = 0; d < DOMAINS; d++)
+		server[d] = d / NBS;
+}
+
+int main(void)
+{
+	uint8_t dist[DOMAINS * DOMAINS], before[DOMAINS * DOMAINS];
+	unsigned server[DOMAINS];
+	uint32_t latency[SERVERS * SERVERS];
+
+	servers(server);
+
+	// local 100ns everywhere; remote 800ns, or 1.1us further round the ring
+	for (unsigned s = 0; s < SERVERS; s++)
+		for (unsigned t = 0; t < SERVERS; t++)
+			latency[s * SERVERS + t] = s == t ? 100 : (s + 1) % SERVERS == t ? 800 : 1100;
+	hops(dist, server);
+	memcpy(before, dist, sizeof(dist));
+	check(slit_measured(dist, DOMAINS, server, latency, SERVERS), "complete measurement used");
+
+	bool local = 1, within = 1, across = 1;
+	for (unsigned i = 0; i < DOMAINS; i++) {
+		for (unsigned j = 0; j < DOMAINS; j++) {
+			const unsigned k = i * DOMAINS + j;
+			if (i == j)
+				local &= dist[k] == SLIT_LOCAL;
+			else if (server[i] == server[j])
+				within &= dist[k] == before[k];
+			else
+				across &= dist[k] == ((server[i] + 1) % SERVERS == server[j] ? 80 : 110);
+		}
+	}
+	check(local, "local stays 10");
+	check(within, "within a server keeps BIOS distances");
+	check(across, "normalised to the source's local latency");
+
+	// a server whose own memory is slower scales its row by its own local latency
+	latency[1 * SERVERS + 1] = 150;
+	hops(dist, server);
+	slit_measured(dist, DOMAINS, server, latency, SERVERS);
+	check(dist[NBS * DOMAINS + 2 * NBS] == 53 && dist[0 * DOMAINS + NBS] == 80, "rows normalised by source");
+	latency[1 * SERVERS + 1] = 100;
+
+	// outliers are held to half and twice the hop model, and above the server's own distances
+	latency[0 * SERVERS + 1] = 5000;
+	latency[0 * SERVERS + 2] = 110;
+	latency[1 * SERVERS + 2] = 50;
+	hops(dist, server);
+	slit_measured(dist, DOMAINS, server, latency, SERVERS);
+	check(dist[0 * DOMAINS + NBS] == 200, "slow outlier clamped to twice the hop model");
+	check(dist[0 * DOMAINS + 2 * NBS] == 50, "fast outlier clamped to half the hop model");
+
+	uint8_t tight[DOMAINS * DOMAINS];
+	hops(tight, server);
+	for (unsigned i = 0; i < DOMAINS; i++)
+		for (unsigned j = 0; j < DOMAINS; j++)
+			if (server[i] != server[j])
+				tight[i * DOMAINS + j] = 20; // as on a fabric with little latency
+	slit_measured(tight, DOMAINS, server, latency, SERVERS);
+	check(tight[NBS * DOMAINS + 2 * NBS] == 17, "remote stays beyond the server's own");
+
+	hops(dist, server);
+	dist[0 * DOMAINS + NBS] = 200;
+	latency[0 * SERVERS + 1] = 100000;
+	slit_measured(dist, DOMAINS, server, latency, SERVERS);
+	check(dist[0 * DOMAINS + NBS] == SLIT_MAX, "never unreachable");
+
+	// a probe missing a pair, as on timeout, leaves the hop model
+	latency[2 * SERVERS + 0] = 0;
+	hops(dist, server);
+	memcpy(before, dist, sizeof(dist));
+	check(!slit_measured(dist, DOMAINS, server, latency, SERVERS) && !memcmp(dist, before, sizeof(dist)), "incomplete probe keeps hop model");
+
+	printf("%u SLIT tests failed\n", failed);
+	return failed > 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2008-2014 Numascale AS, support@numascale.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// decodes a config-space access trace saved from the E820-reserved region, eg by sim-boot access-trace=16M
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include "../library/trace.h"
+#include "library/model.h"
+
+#define TOP 10
+
+// last known value of each register, from a read or write
+struct reg_state {
+	uint64_t key;
+	uint32_t val;
+	bool used, written;
+	unsigned redundant;
+};
+
+struct phase_stats {
+	uint64_t reads, writes, remote, polls;
+	uint64_t redundant_writes, unchanged_reads;
+	uint64_t ns, saved_writes, saved_reads, saved_batching;
+};
+
+static struct reg_state *regs;
+static unsigned regs_mask;
+
+static struct reg_state *lookup(const uint16_t sci, const uint32_t reg)
+{
+	const uint64_t key = ((uint64_t)sci << 32) | reg;
+	unsigned slot = (key * 0x9e3779b97f4a7c15ULL) >> 40 & regs_mask;
+
+	while (regs[slot].used && regs[slot].key != key)
+		slot = (slot + 1) & regs_mask;
+
+	regs[slot].key = key;
+	return &regs[slot];
+}
+
+static unsigned cost(const uint8_t type)
+{
+	const bool write = type & TRACE_WRITE;
+
+	if (type & TRACE_REMOTE)
+		return sim::op_ns[write ? sim::CSR_WRITE_REMOTE : sim::CSR_READ_REMOTE];
+	return sim::op_ns[write ? sim::CSR_WRITE : sim::CSR_READ];
+}
+
+static void print_reg(const uint16_t sci, const uint32_t reg)
+{
+	printf("%03x %02x:%02x.%x %03x", sci, reg >> 20, (reg >> 15) & 0x1f, (reg >> 12) & 7, reg & 0xfff);
+}
+
+static int by_redundant(const void *a, const void *b)
+{
+	return (int)((const struct reg_state *)b)->redundant - (int)((const struct reg_state *)a)->redundant;
+}
+
+int main(const int argc, const char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s access.trace\n", argv[0]);
+		return 1;
+	}
+
+	FILE *f = fopen(argv[1], "r");
+	if (!f) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	struct trace_header header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.sig, TRACE_SIG, sizeof(header.sig))) {
+		fprintf(stderr, "%s: not an access trace\n", argv[1]);
+		return 1;
+	}
+
+	struct trace_entry *ring = (struct trace_entry *)malloc(header.entries * sizeof(*ring));
+	xassert(ring);
+	xassert(fread(ring, sizeof(*ring), header.entries, f) == header.entries);
+	fclose(f);
+
+	// oldest entry first; entries overwritten after wrapping are lost
+	const uint64_t held = min(header.total, (uint64_t)header.entries);
+	const unsigned first = header.total > header.entries ? header.head : 0;
+	if (header.total > header.entries)
+		printf("Ring wrapped; %" PRIu64 " oldest entries lost\n", header.total - header.entries);
+
+	regs_mask = 1;
+	while (regs_mask < held * 2)
+		regs_mask <<= 1;
+	regs = (struct reg_state *)calloc(regs_mask, sizeof(*regs));
+	xassert(regs);
+	regs_mask--;
+
+	struct phase_stats stats[TRACE_PHASES + 1];
+	memset(stats, 0, sizeof(stats));
+
+	// posted remote writes to one server pipeline until the next read from it
+	uint16_t batch_sci = SCI_LOCAL;
+	bool batching = 0;
+
+	for (uint64_t i = 0; i < held; i++) {
+		const struct trace_entry *e = &ring[(first + i) % header.entries];
+		struct phase_stats *p = &stats[min((unsigned)e->phase, (unsigned)TRACE_PHASES)];
+		const uint64_t count = 1 + e->repeat;
+		const bool write = e->type & TRACE_WRITE;
+		struct reg_state *r = lookup(e->sci, e->reg);
+
+		p->ns += cost(e->type) * count;
+		if (e->type & TRACE_REMOTE)
+			p->remote += count;
+
+		if (write) {
+			p->writes += count;
+
+			// rewriting the last known value; only status registers with write-one-to-clear bits need it
+			uint64_t redundant = e->repeat;
+			if (r->used && r->val == e->val)
+				redundant++;
+			p->redundant_writes += redundant;
+			p->saved_writes += redundant * cost(e->type);
+			r->redundant += redundant;
+
+			if ((e->type & TRACE_REMOTE) && batching && batch_sci == e->sci)
+				p->saved_batching += cost(e->type) - sim::op_ns[sim::CSR_WRITE];
+			batching = e->type & TRACE_REMOTE;
+			batch_sci = e->sci;
+		} else {
+			p->reads += count;
+
+			// re-reading a value that hasn't changed since it was last seen, other than polling
+			uint64_t unchanged = (e->type & TRACE_SPREAD) ? e->repeat : 0;
+			if (r->used && r->val == e->val)
+				unchanged++;
+			p->polls += (e->type & TRACE_SPREAD) ? 0 : e->repeat;
+			p->unchanged_reads += unchanged;
+			p->saved_reads += unchanged * cost(e->type);
+			r->redundant += unchanged;
+
+			if (batch_sci == e->sci)
+				batching = 0;
+		}
+
+		r->used = 1;
+		r->written |= write;
+		r->val = e->val;
+	}
+
+	printf("%" PRIu64 " accesses in %" PRIu64 " entries, TSC %uMHz\n\n", header.accesses, header.total, header.tsc_mhz);
+	printf("%-14s %9s %9s %9s %9s %9s %9s %9s %10s %10s %10s %10s\n", "phase", "measured", "modelled", "reads",
+	  "writes", "remote", "polls", "rewrites", "re-reads", "-rewrites", "-re-reads", "-batching");
+
+	struct phase_stats total;
+	memset(&total, 0, sizeof(total));
+	const double ms = header.tsc_mhz * 1e3;
+
+	for (unsigned i = 0; i < header.nphases; i++) {
+		const struct phase_stats *p = &stats[i];
+		const uint64_t end = i + 1 < header.nphases ? header.phases[i + 1].tsc : header.last;
+
+		printf("%-14.*s %9.1f %9.1f %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %10" PRIu64 " %10.1f %10.1f %10.1f\n",
+		  (int)sizeof(header.phases[i].name), header.phases[i].name, (end - header.phases[i].tsc) / ms, p->ns / 1e6,
+		  p->reads, p->writes, p->remote, p->polls, p->redundant_writes, p->unchanged_reads,
+		  p->saved_writes / 1e6, p->saved_reads / 1e6, p->saved_batching / 1e6);
+
+		total.reads += p->reads;
+		total.writes += p->writes;
+		total.remote += p->remote;
+		total.polls += p->polls;
+		total.redundant_writes += p->redundant_writes;
+		total.unchanged_reads += p->unchanged_reads;
+		total.ns += p->ns;
+		total.saved_writes += p->saved_writes;
+		total.saved_reads += p->saved_reads;
+		total.saved_batching += p->saved_batching;
+	}
+
+	printf("%-14s %9.1f %9.1f %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %10" PRIu64 " %10.1f %10.1f %10.1f\n",
+	  "total", (header.last - header.phases[0].tsc) / ms, total.ns / 1e6, total.reads, total.writes, total.remote,
+	  total.polls, total.redundant_writes, total.unchanged_reads,
+	  total.saved_writes / 1e6, total.saved_reads / 1e6, total.saved_batching / 1e6);
+
+	// replay estimate: the modelled access time with each proposal applied
+	const uint64_t saved = total.saved_writes + total.saved_reads + total.saved_batching;
+	printf("\nModelled access time %.1fms; eliding rewrites, caching re-reads and batching posted remote writes leaves %.1fms (%.0f%%)\n",
+	  total.ns / 1e6, (total.ns - saved) / 1e6, total.ns ? 100.0 * (total.ns - saved) / total.ns : 0);
+
+	qsort(regs, regs_mask + 1, sizeof(*regs), by_redundant);
+	printf("\nMost redundant registers:\n");
+	for (unsigned i = 0; i < TOP && regs[i].redundant; i++) {
+		printf("  ");
+		print_reg(regs[i].key >> 32, regs[i].key);
+		printf(" %9u%s\n", regs[i].redundant, regs[i].written ? "" : " (read-only)");
+	}
+
+	free(regs);
+	free(ring);
+	return 0;
+}